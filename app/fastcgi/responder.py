@@ -0,0 +1,281 @@
+#!/usr/bin/env python3
+
+# Local FastCGI responder for webserv (fastcgi_pass).
+#
+# It runs the same Python scripts as the CGI locations, but the interpreter is started once :
+# a few worker processes are forked at startup, they accept the connections of webserv on a Unix socket
+# and execute each requested script (SCRIPT_FILENAME) in-process, with the CGI environment, stdin and
+# stdout the script would get from a CGI process. Compiled scripts are cached until they are modified.
+#
+# usage : python3 app/fastcgi/responder.py [--socket /tmp/webserv-fastcgi.sock] [--workers 4]
+
+import argparse
+import io
+import os
+import selectors
+import signal
+import socket
+import struct
+import sys
+import traceback
+import urllib.parse
+
+FCGI_VERSION_1 = 1
+FCGI_BEGIN_REQUEST = 1
+FCGI_ABORT_REQUEST = 2
+FCGI_END_REQUEST = 3
+FCGI_PARAMS = 4
+FCGI_STDIN = 5
+FCGI_STDOUT = 6
+FCGI_STDERR = 7
+FCGI_GET_VALUES = 9
+FCGI_GET_VALUES_RESULT = 10
+FCGI_RESPONDER = 1
+FCGI_KEEP_CONN = 1
+FCGI_REQUEST_COMPLETE = 0
+FCGI_UNKNOWN_ROLE = 3
+FCGI_MAX_CONTENT_LENGTH = 65535
+
+HEADER = struct.Struct("!BBHHBx")
+
+# (path, mtime) -> code object
+compiled_scripts = {}
+
+
+def encode_record(record_type, request_id, content=b""):
+    padding = (8 - len(content) % 8) % 8
+    return HEADER.pack(FCGI_VERSION_1, record_type, request_id, len(content), padding) + content + b"\0" * padding
+
+
+def encode_stream(record_type, request_id, data):
+    records = []
+    for offset in range(0, len(data), FCGI_MAX_CONTENT_LENGTH):
+        records.append(encode_record(record_type, request_id, data[offset:offset + FCGI_MAX_CONTENT_LENGTH]))
+    # An empty record ends the stream
+    records.append(encode_record(record_type, request_id))
+    return b"".join(records)
+
+
+def decode_length(data, pos):
+    if data[pos] < 128:
+        return data[pos], pos + 1
+    return struct.unpack("!I", data[pos:pos + 4])[0] & 0x7FFFFFFF, pos + 4
+
+
+def decode_params(data):
+    params = {}
+    pos = 0
+    while pos < len(data):
+        name_length, pos = decode_length(data, pos)
+        value_length, pos = decode_length(data, pos)
+        name = data[pos:pos + name_length].decode("latin-1")
+        pos += name_length
+        params[name] = data[pos:pos + value_length].decode("latin-1")
+        pos += value_length
+    return params
+
+
+def load_script(path):
+    mtime = os.stat(path).st_mtime
+    code = compiled_scripts.get((path, mtime))
+    if code is None:
+        with open(path, "rb") as script:
+            code = compile(script.read(), path, "exec")
+        compiled_scripts[(path, mtime)] = code
+    return code
+
+
+def run_script(params, body):
+    """Runs a script like a CGI process would : returns (stdout, stderr, exit status)."""
+    path = params.get("SCRIPT_FILENAME", "")
+    if not os.path.isfile(path):
+        return b"Status: 404 Not Found\r\nContent-Type: text/plain\r\n\r\nScript not found\n", b"", 0
+
+    # Same arguments as a CGI process : --key=value for each parameter of the query string (GET)
+    argv = [path]
+    if params.get("REQUEST_METHOD") == "GET":
+        for key, value in urllib.parse.parse_qsl(params.get("QUERY_STRING", ""), keep_blank_values=True):
+            argv.append("--%s=%s" % (key, value))
+
+    stdout = io.BytesIO()
+    stderr = io.StringIO()
+    saved = (sys.argv, sys.stdin, sys.stdout, sys.stderr, dict(os.environ), os.getcwd())
+    sys.argv = argv
+    sys.stdin = io.TextIOWrapper(io.BytesIO(body), encoding="utf-8")
+    sys.stdout = io.TextIOWrapper(stdout, encoding="utf-8", write_through=True)
+    sys.stderr = stderr
+    os.environ.clear()
+    os.environ.update(params)
+    status = 0
+    try:
+        os.chdir(os.path.dirname(path))
+        exec(load_script(path), {"__name__": "__main__", "__file__": path})
+    except SystemExit as exit_request:
+        if exit_request.code is None:
+            status = 0
+        elif isinstance(exit_request.code, int):
+            status = exit_request.code
+        else:
+            stderr.write(str(exit_request.code) + "\n")
+            status = 1
+    except BaseException:
+        traceback.print_exc(file=stderr)
+        status = 1
+    finally:
+        sys.stdout.flush()
+        sys.stdout.detach()
+        sys.argv, sys.stdin, sys.stdout, sys.stderr, environ, cwd = saved
+        os.environ.clear()
+        os.environ.update(environ)
+        os.chdir(cwd)
+    return stdout.getvalue(), stderr.getvalue().encode("utf-8"), status & 0xFFFFFFFF
+
+
+class Connection:
+    def __init__(self, sock):
+        self.sock = sock
+        self.buffer = b""
+        self.requests = {}
+
+    def handle_records(self):
+        """Handles every complete record received. Returns False once the connection has to be closed."""
+        while len(self.buffer) >= HEADER.size:
+            version, record_type, request_id, length, padding = HEADER.unpack_from(self.buffer)
+            if version != FCGI_VERSION_1:
+                return False
+            end = HEADER.size + length + padding
+            if len(self.buffer) < end:
+                break
+            content = self.buffer[HEADER.size:HEADER.size + length]
+            self.buffer = self.buffer[end:]
+            if not self.handle_record(record_type, request_id, content):
+                return False
+        return True
+
+    def handle_record(self, record_type, request_id, content):
+        if record_type == FCGI_GET_VALUES:
+            self.sock.sendall(encode_record(FCGI_GET_VALUES_RESULT, 0))
+        elif record_type == FCGI_BEGIN_REQUEST:
+            role, flags = struct.unpack("!HB", content[:3])
+            if role != FCGI_RESPONDER:
+                self.sock.sendall(encode_record(FCGI_END_REQUEST, request_id, struct.pack("!IB3x", 0, FCGI_UNKNOWN_ROLE)))
+                return True
+            self.requests[request_id] = {"keep_conn": bool(flags & FCGI_KEEP_CONN), "params": b"", "stdin": b""}
+        elif record_type == FCGI_ABORT_REQUEST:
+            self.requests.pop(request_id, None)
+            self.sock.sendall(encode_record(FCGI_END_REQUEST, request_id, struct.pack("!IB3x", 0, FCGI_REQUEST_COMPLETE)))
+        elif record_type == FCGI_PARAMS and request_id in self.requests:
+            self.requests[request_id]["params"] += content
+        elif record_type == FCGI_STDIN and request_id in self.requests:
+            if content:
+                self.requests[request_id]["stdin"] += content
+            else:
+                # Empty STDIN record : the request is complete
+                request = self.requests.pop(request_id)
+                stdout, stderr, status = run_script(decode_params(request["params"]), request["stdin"])
+                response = encode_stream(FCGI_STDOUT, request_id, stdout)
+                if stderr:
+                    response += encode_stream(FCGI_STDERR, request_id, stderr)
+                response += encode_record(FCGI_END_REQUEST, request_id, struct.pack("!IB3x", status, FCGI_REQUEST_COMPLETE))
+                self.sock.setblocking(True)
+                self.sock.sendall(response)
+                self.sock.setblocking(False)
+                return request["keep_conn"]
+        return True
+
+
+def run_worker(listener):
+    """Serves the connections of webserv one request at a time, several connections can be kept open."""
+    signal.signal(signal.SIGTERM, signal.SIG_DFL)
+    signal.signal(signal.SIGINT, signal.SIG_DFL)
+    selector = selectors.DefaultSelector()
+    selector.register(listener, selectors.EVENT_READ, None)
+    while True:
+        for key, _ in selector.select():
+            if key.data is None:
+                try:
+                    sock, _ = listener.accept()
+                except (BlockingIOError, InterruptedError):
+                    # Another worker accepted it first
+                    continue
+                sock.setblocking(False)
+                selector.register(sock, selectors.EVENT_READ, Connection(sock))
+                continue
+            connection = key.data
+            try:
+                data = connection.sock.recv(65536)
+            except (BlockingIOError, InterruptedError):
+                continue
+            except OSError:
+                data = b""
+            keep = False
+            if data:
+                connection.buffer += data
+                try:
+                    keep = connection.handle_records()
+                except OSError:
+                    keep = False
+            if not keep:
+                selector.unregister(connection.sock)
+                connection.sock.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="FastCGI responder running the webserv Python scripts")
+    parser.add_argument("--socket", default="/tmp/webserv-fastcgi.sock")
+    parser.add_argument("--workers", type=int, default=4)
+    args = parser.parse_args()
+
+    if os.path.exists(args.socket):
+        os.unlink(args.socket)
+    listener = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    listener.bind(args.socket)
+    listener.listen(128)
+    listener.setblocking(False)
+
+    workers = set()
+
+    def spawn_worker():
+        pid = os.fork()
+        if pid == 0:
+            try:
+                run_worker(listener)
+            finally:
+                os._exit(0)
+        workers.add(pid)
+
+    running = [True]
+
+    def stop(signum, frame):
+        running[0] = False
+        for pid in workers:
+            os.kill(pid, signal.SIGTERM)
+
+    signal.signal(signal.SIGTERM, stop)
+    signal.signal(signal.SIGINT, stop)
+    for _ in range(max(1, args.workers)):
+        spawn_worker()
+    print("Info : FastCGI responder listening on %s with %d workers" % (args.socket, len(workers)), flush=True)
+
+    # A worker killed by a script (os._exit, crash ...) is replaced
+    while running[0]:
+        try:
+            pid, _ = os.wait()
+        except InterruptedError:
+            continue
+        except ChildProcessError:
+            break
+        workers.discard(pid)
+        if running[0]:
+            spawn_worker()
+
+    for pid in workers:
+        try:
+            os.waitpid(pid, 0)
+        except ChildProcessError:
+            pass
+    os.unlink(args.socket)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,21 @@
+#!/usr/bin/python3
+
+import hashlib
+import os
+import sys
+
+# Lit le corps de la requete sur l'entree standard et affiche sa taille et son empreinte sha256
+# Sans CONTENT_LENGTH (corps chunked), l'entree standard est lue jusqu'a EOF
+length = int(os.environ['CONTENT_LENGTH']) if os.environ.get('CONTENT_LENGTH') else None
+digest = hashlib.sha256()
+received = 0
+while length is None or received < length:
+    chunk = sys.stdin.buffer.read(65536 if length is None else min(65536, length - received))
+    if not chunk:
+        break
+    digest.update(chunk)
+    received += len(chunk)
+
+print("<html><body>")
+print(f"<p>{received} {digest.hexdigest()}</p>")
+print("</body></html>")
@@ -1,9 +1,11 @@
 #!/usr/bin/python3
 
+import os
 import sys
 import html
+import urllib.parse
 
-# Fonction pour analyser les arguments de la ligne de commande
+# Fonction pour analyser les arguments de la ligne de commande (GET)
 def parse_arguments():
     args = sys.argv[1:]
     params = {}
@@ -15,8 +17,18 @@ def parse_arguments():
                 params[key] = value
     return params
 
-# Récupérer les données du formulaire à partir des arguments
-params = parse_arguments()
+# Fonction pour analyser le corps de la requete POST, recu sur l'entree standard
+def parse_body():
+    # Sans CONTENT_LENGTH (corps chunked), l'entree standard est lue jusqu'a EOF
+    length = int(os.environ['CONTENT_LENGTH']) if os.environ.get('CONTENT_LENGTH') else -1
+    body = sys.stdin.buffer.read(length).decode('utf-8', 'replace')
+    return {key: values[-1] for key, values in urllib.parse.parse_qs(body).items()}
+
+# Récupérer les données du formulaire
+if os.environ.get('REQUEST_METHOD') == 'POST':
+    params = parse_body()
+else:
+    params = parse_arguments()
 
 name = params.get('name')
 email = params.get('email')
@@ -0,0 +1,108 @@
+// GzipBench.cpp
+// Cost of the on-the-fly gzip of the `gzip on` locations : compression speed vs bytes saved for each gzip_comp_level.
+// Bodies are compressed in GZIP_CHUNK_SIZE pieces, like the DataSocket does (CGI output : flushed after each piece).
+// Build and run with `make bench`.
+#include "GzipEncoder.hpp"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+#include <cstdlib>
+#include <sys/time.h>
+
+// Bytes compressed for each measure (the corpus is compressed again until this amount is reached)
+const size_t BYTES_PER_MEASURE = 32 * 1024 * 1024;
+
+static double now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+// Pages of the website, or a generated page if the bench is not run from the root of the repository
+static std::string makeStaticPages() {
+    const char* files[] = { "app/website/static/index.html", "app/website/static/about.html",
+                            "app/website/static/upload.html", "app/website/static/contact.html" };
+    std::string corpus;
+    for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); ++i) {
+        std::ifstream file(files[i]);
+        std::ostringstream content;
+        content << file.rdbuf();
+        corpus += content.str();
+    }
+    if (corpus.empty()) {
+        for (int i = 0; i < 200; ++i) {
+            corpus += "<section class=\"card\"><h2>Title</h2><p>Some paragraph of the page, with a <a href=\"/static/about.html\">link</a>.</p></section>\n";
+        }
+    }
+    return corpus;
+}
+
+// Like RequestHandler::generateAutoIndex() for a directory of 2000 files
+static std::string makeAutoIndex() {
+    std::ostringstream ss;
+    ss << "<html><head><title>Index of /uploads/</title></head><body><h1>Index of /uploads/</h1><ul>";
+    for (int i = 0; i < 2000; ++i) {
+        ss << "<li><a href=\"upload_" << i * 7919 % 100000 << ".png\">upload_" << i * 7919 % 100000 << ".png</a></li>";
+    }
+    ss << "</ul></body></html>";
+    return ss.str();
+}
+
+// HTML table of a CGI script (numbers that vary from row to row)
+static std::string makeCgiTable() {
+    std::ostringstream ss;
+    srand(42);
+    ss << "<html><body><table><tr><th>id</th><th>name</th><th>size</th><th>checksum</th></tr>\n";
+    for (int i = 0; i < 3000; ++i) {
+        ss << "<tr><td>" << i << "</td><td>file_" << rand() % 10000 << ".txt</td><td>" << rand() % 1000000
+           << "</td><td>" << std::hex << rand() << rand() << std::dec << "</td></tr>\n";
+    }
+    ss << "</table></body></html>";
+    return ss.str();
+}
+
+/**
+ * Compresses `body` in GZIP_CHUNK_SIZE pieces until BYTES_PER_MEASURE bytes have been compressed.
+ *
+ * @param flush      true to flush after each piece (CGI output).
+ * @param compressed Size of one compressed body.
+ * @return The speed in MB/s of input.
+ */
+static double benchLevel(const std::string& body, int level, bool flush, size_t& compressed) {
+    size_t iterations = BYTES_PER_MEASURE / body.size() + 1;
+    std::string output;
+    double start = now();
+    for (size_t i = 0; i < iterations; ++i) {
+        GzipEncoder encoder(level);
+        output.clear();
+        for (size_t offset = 0; offset < body.size(); offset += GZIP_CHUNK_SIZE) {
+            size_t length = std::min(GZIP_CHUNK_SIZE, body.size() - offset);
+            encoder.compress(body.data() + offset, length, output, flush);
+        }
+        encoder.finish(output);
+    }
+    double elapsed = now() - start;
+    compressed = output.size();
+    return iterations * body.size() / elapsed / (1024 * 1024);
+}
+
+static void benchCorpus(const std::string& name, const std::string& body, bool flush) {
+    std::cout << name << " (" << body.size() << " bytes" << (flush ? ", flushed per piece" : "") << ")" << std::endl;
+    for (int level = 1; level <= 9; ++level) {
+        size_t compressed;
+        double speed = benchLevel(body, level, flush, compressed);
+        std::cout << "  level " << level << " : " << std::setw(7) << std::fixed << std::setprecision(1) << speed << " MB/s, "
+                  << std::setw(7) << compressed << " bytes (" << std::setprecision(1)
+                  << 100.0 * (body.size() - compressed) / body.size() << "% saved)" << std::endl;
+    }
+}
+
+int main() {
+    benchCorpus("static pages", makeStaticPages(), false);
+    benchCorpus("autoindex   ", makeAutoIndex(), false);
+    benchCorpus("CGI table   ", makeCgiTable(), true);
+    return 0;
+}
@@ -0,0 +1,71 @@
+// ParserBench.cpp
+// Microbenchmark of the HttpRequest parser : requests parsed per second for small GETs and large POSTs.
+// Data is fed in 4 KB chunks, like DataSocket::receiveData() does. Build and run with `make bench`.
+#include "HttpRequest.hpp"
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <sstream>
+#include <algorithm>
+#include <sys/time.h>
+
+const size_t RECV_CHUNK_SIZE = 4096;
+
+static double now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/**
+ * Parses the same raw request `iterations` times, calling parseRequest() after each chunk received.
+ *
+ * @return The number of requests parsed per second.
+ */
+static double benchRequest(const std::string& raw, size_t iterations) {
+    HttpRequest request;
+    double start = now();
+    for (size_t i = 0; i < iterations; ++i) {
+        for (size_t offset = 0; offset < raw.size(); offset += RECV_CHUNK_SIZE) {
+            size_t length = std::min(RECV_CHUNK_SIZE, raw.size() - offset);
+            request.appendData(raw.data() + offset, length);
+            request.parseRequest();
+        }
+        if (!request.isComplete() || request.hasParseError()) {
+            std::cerr << "Error : request not parsed" << std::endl;
+            std::exit(1);
+        }
+        request.reset();
+    }
+    return iterations / (now() - start);
+}
+
+static std::string makePost(size_t bodySize) {
+    std::string raw = "POST /uploads/ HTTP/1.1\r\n"
+                      "Host: localhost:8080\r\n"
+                      "User-Agent: ParserBench\r\n"
+                      "Content-Type: plain/text\r\n"
+                      "Content-Length: ";
+    std::ostringstream length;
+    length << bodySize;
+    raw += length.str() + "\r\n\r\n";
+    raw.append(bodySize, 'x');
+    return raw;
+}
+
+int main() {
+    std::string smallGet = "GET /static/about.html?lang=fr HTTP/1.1\r\n"
+                           "Host: localhost:8080\r\n"
+                           "User-Agent: ParserBench\r\n"
+                           "Accept: text/html,application/xhtml+xml\r\n"
+                           "Accept-Encoding: gzip, deflate\r\n"
+                           "Connection: keep-alive\r\n"
+                           "\r\n";
+    std::string post64k = makePost(64 * 1024);
+    std::string post1m = makePost(1024 * 1024);
+
+    std::cout << "small GET   : " << static_cast<long>(benchRequest(smallGet, 200000)) << " requests/s" << std::endl;
+    std::cout << "POST 64 KB  : " << static_cast<long>(benchRequest(post64k, 5000)) << " requests/s" << std::endl;
+    std::cout << "POST 1 MB   : " << static_cast<long>(benchRequest(post1m, 300)) << " requests/s" << std::endl;
+    return 0;
+}
@@ -0,0 +1,106 @@
+// RoutingBench.cpp
+// Cost of the location routing of a request : the former linear scan of Server::getLocations() vs the LocationTrie,
+// for servers of 10, 100 and 10000 locations. Build and run with `make bench`.
+#include "Config.hpp"
+#include "Server.hpp"
+#include "Location.hpp"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+#include <sys/time.h>
+
+// Lookups done for each measure
+const size_t LOOKUPS_PER_MEASURE = 2000000;
+
+static double now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+// RequestHandler::selectLocation() before the LocationTrie
+static const Location* linearSelect(const Server& server, const std::string& requestPath) {
+    const std::vector<Location>& locations = server.getLocations();
+    const Location* matchedLocation = NULL;
+    size_t longestMatch = 0;
+    for (size_t i = 0; i < locations.size(); ++i) {
+        std::string locPath = locations[i].getPath();
+        if (requestPath.find(locPath) == 0 && locPath.length() > longestMatch) {
+            matchedLocation = &locations[i];
+            longestMatch = locPath.length();
+        }
+    }
+    return matchedLocation;
+}
+
+// Locations of a generated configuration : /, then /app<i>/ and /app<i>/api/v<j>/ (a few exact ones)
+static void addLocations(Server& server, size_t count) {
+    server.addLocation(Location(server, "/"));
+    for (size_t i = 0; server.getLocations().size() < count; ++i) {
+        std::ostringstream app;
+        app << "/app" << i << "/";
+        server.addLocation(Location(server, app.str()));
+        for (size_t j = 0; j < 4 && server.getLocations().size() < count; ++j) {
+            std::ostringstream api;
+            api << app.str() << "api/v" << j << "/";
+            Location location(server, api.str());
+            location.setExactMatch(j == 3);
+            server.addLocation(location);
+        }
+    }
+    server.compileLocations();
+}
+
+// Request paths spread over the locations (a few without location but /)
+static std::vector<std::string> makeRequestPaths(size_t locationCount) {
+    std::vector<std::string> paths;
+    srand(42);
+    size_t apps = locationCount / 5 + 1;
+    for (size_t i = 0; i < 1000; ++i) {
+        std::ostringstream path;
+        switch (i % 4) {
+            case 0: path << "/app" << rand() % apps << "/index.html"; break;
+            case 1: path << "/app" << rand() % apps << "/api/v" << rand() % 3 << "/users/" << rand(); break;
+            case 2: path << "/static/css/site" << rand() % 100 << ".css"; break;
+            default: path << "/app" << rand() % apps << "/api/v3/"; break;
+        }
+        paths.push_back(path.str());
+    }
+    return paths;
+}
+
+// Locations found, so that the lookups are not optimized away
+static volatile size_t g_found = 0;
+
+// Nanoseconds per lookup (fewer lookups for the linear scan of the big servers)
+static double benchLookups(const Server& server, const std::vector<std::string>& paths, bool trie) {
+    size_t lookups = trie ? LOOKUPS_PER_MEASURE : LOOKUPS_PER_MEASURE / (server.getLocations().size() / 10 + 1);
+    size_t found = 0;
+    double start = now();
+    for (size_t i = 0; i < lookups; ++i) {
+        const std::string& path = paths[i % paths.size()];
+        const Location* location = trie ? server.findLocation(path) : linearSelect(server, path);
+        found += location != NULL && location->getPath().size() > 1;
+    }
+    g_found = g_found + found;
+    return (now() - start) * 1e9 / lookups;
+}
+
+int main() {
+    const size_t counts[] = { 10, 100, 10000 };
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i) {
+        Config config;
+        Server server(config);
+        addLocations(server, counts[i]);
+        std::vector<std::string> paths = makeRequestPaths(counts[i]);
+
+        double linear = benchLookups(server, paths, false);
+        double trie = benchLookups(server, paths, true);
+        std::cout << std::setw(6) << counts[i] << " locations : linear " << std::fixed << std::setprecision(1)
+                  << std::setw(9) << linear << " ns/lookup, trie " << std::setw(6) << trie << " ns/lookup" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,98 @@
+// SpawnBench.cpp
+// Cost of the launch of a CGI for the worker : fork() + execve() (former CgiProcess::start) vs posix_spawn(), when
+// the worker uses more and more memory (caches). The time the parent is blocked in fork() / posix_spawn() is the
+// time every other connection of the worker waits. Build and run with `make bench`.
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <spawn.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+// Launches measured for each memory size and each method
+const int SPAWNS_PER_MEASURE = 200;
+// Memory of the worker simulated, in MB (touched : the pages are mapped)
+const size_t RSS_SIZES_MB[] = { 0, 64, 256, 1024 };
+
+extern char** environ;
+
+static double now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static char* const g_argv[] = { const_cast<char*>("/bin/true"), NULL };
+
+static pid_t launchFork() {
+    pid_t pid = fork();
+    if (pid == 0) {
+        execve(g_argv[0], g_argv, environ);
+        _exit(1);
+    }
+    return pid;
+}
+
+static pid_t launchSpawn() {
+    pid_t pid;
+    if (posix_spawn(&pid, g_argv[0], NULL, NULL, g_argv, environ) != 0) {
+        return -1;
+    }
+    return pid;
+}
+
+/**
+ * Launches SPAWNS_PER_MEASURE children one after the other.
+ *
+ * @param blockedUs Mean time spent in the launch function by the parent (µs).
+ * @return The mean time from the launch to the end of the child (µs).
+ */
+static double bench(pid_t (*launch)(), double& blockedUs) {
+    double blocked = 0;
+    double start = now();
+    for (int i = 0; i < SPAWNS_PER_MEASURE; ++i) {
+        double before = now();
+        pid_t pid = launch();
+        blocked += now() - before;
+        if (pid <= 0) {
+            std::cerr << "Error : launch failed" << std::endl;
+            std::exit(1);
+        }
+        waitpid(pid, NULL, 0);
+    }
+    blockedUs = blocked / SPAWNS_PER_MEASURE * 1000000;
+    return (now() - start) / SPAWNS_PER_MEASURE * 1000000;
+}
+
+int main() {
+    std::vector<char*> blocks;
+    size_t allocatedMb = 0;
+    std::cout << std::fixed << std::setprecision(0);
+    for (size_t i = 0; i < sizeof(RSS_SIZES_MB) / sizeof(RSS_SIZES_MB[0]); ++i) {
+        // Grows the memory used to the next size, one MB at a time
+        while (allocatedMb < RSS_SIZES_MB[i]) {
+            char* block = static_cast<char*>(std::malloc(1024 * 1024));
+            if (block == NULL) {
+                std::cerr << "Error : not enough memory for " << RSS_SIZES_MB[i] << " MB" << std::endl;
+                return 1;
+            }
+            std::memset(block, 1, 1024 * 1024);
+            blocks.push_back(block);
+            ++allocatedMb;
+        }
+        double forkBlocked;
+        double spawnBlocked;
+        double forkTotal = bench(launchFork, forkBlocked);
+        double spawnTotal = bench(launchSpawn, spawnBlocked);
+        std::cout << "RSS +" << std::setw(5) << RSS_SIZES_MB[i] << " MB : fork+execve " << std::setw(6) << forkBlocked
+                  << " us blocked, " << std::setw(6) << forkTotal << " us to exit | posix_spawn " << std::setw(6)
+                  << spawnBlocked << " us blocked, " << std::setw(6) << spawnTotal << " us to exit" << std::endl;
+    }
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        std::free(blocks[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,29 @@
+// BodySink.hpp
+#ifndef BODYSINK_HPP
+#define BODYSINK_HPP
+
+#include <cstddef>
+
+
+/**
+ * @class BodySink
+ *
+ * The `BodySink` class is the destination of a request body consumed while it is received, instead of 
+ * being buffered in `HttpRequest::body_`. It is attached to the `HttpRequest` once its headers are parsed 
+ * (see `RequestHandler::prepareRequestBody()`, `DataSocket::startCgiInput()`), and is owned by it.
+ *
+ * - **write()**: Called with each piece of decoded body (Content-Length or chunked), in order.
+ * - **finish()**: Called once the whole body has been received.
+ *
+ * Both return false on failure, the HTTP status to answer is then given by `getErrorCode()`.
+ */
+class BodySink {
+public:
+    virtual ~BodySink() {}
+
+    virtual bool write(const char* data, size_t length) = 0;
+    virtual bool finish() = 0;
+    virtual int getErrorCode() const = 0;
+};
+
+#endif // BODYSINK_HPP
@@ -0,0 +1,35 @@
+// CgiInputSink.hpp
+#ifndef CGIINPUTSINK_HPP
+#define CGIINPUTSINK_HPP
+
+#include "BodySink.hpp"
+
+class DataSocket; // Forward declaration
+
+
+/**
+ * @class CgiInputSink
+ *
+ * The `CgiInputSink` class streams the body of a request to the CGI that handles it. The CGI is started as soon 
+ * as the headers are parsed, then each piece of body is queued in the stdin buffer of the `DataSocket`, which 
+ * writes it to the pipe while it is writable. The client socket is not read while this buffer holds more than 
+ * CGI_INPUT_HIGH_WATER_MARK bytes (see `DataSocket::wantsToReceive()`) : a body never lives whole in memory.
+ *
+ * Attached to the `HttpRequest` by `DataSocket::processRequest()`, and owned by it.
+ */
+class CgiInputSink : public BodySink {
+public:
+    CgiInputSink(DataSocket& dataSocket);
+
+    bool write(const char* data, size_t length);
+    bool finish();
+    int getErrorCode() const;
+
+private:
+    DataSocket& dataSocket_;
+
+    CgiInputSink(const CgiInputSink&);
+    CgiInputSink& operator=(const CgiInputSink&);
+};
+
+#endif // CGIINPUTSINK_HPP
@@ -7,19 +7,34 @@
 #include <map>
 #include <sys/types.h>
 #include <sys/time.h>
+#include <sys/resource.h>
+
+// posix_spawn() can change the working directory of the child since glibc 2.29, fork() is used otherwise
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29))
+# define CGI_USE_POSIX_SPAWN 1
+#endif
 
 
 class CgiProcess {
 public:
-    CgiProcess(const std::string& scriptWorkingDir, const std::string& relativeFilePath, const std::map<std::string, std::string>& params, const std::vector<std::string>& envVars);
+    CgiProcess(const std::string& scriptWorkingDir, const std::string& relativeFilePath, const std::map<std::string, std::string>& params,
+               const std::vector<std::string>& baseEnvVars, const std::vector<std::string>& envVars);
     ~CgiProcess();
 
     bool start();
-    bool isRunning();
+    bool isRunning() const;
+    pid_t getPid() const;
     int getPipeFd() const;
-    int getExitStatus();
+    int getInputPipeFd() const;
+    void closeInputPipe();
+    void closeOutputPipe();
+    void setExitStatus(int status, const struct rusage& usage);
+    bool hasExited() const;
+    int getExitStatus() const;
+    const struct rusage& getResourceUsage() const;
 
     bool hasTimedOut() const;
+    time_t getDeadline() const;
     bool isOutputComplete() const;
     bool isOutputError() const;
     void terminate();
@@ -27,6 +42,7 @@ public:
 private:
     pid_t pid_;
     int pipefd_[2];
+    int inputPipefd_[2];
 
     //create the envirronnement wherewe want to execute the file
     std::string scriptWorkingDir_;
@@ -38,12 +54,14 @@ private:
     std::vector<std::string> argStrings_;
     std::vector<std::string> envStrings_;
 
-    // check timeouts
+    // check timeouts (monotonic seconds, TimerWheel::currentTime())
     time_t startTime_;
     int maxExecutionTime_;
 
-    // keep the exit status of the CGI
+    // keep the exit status of the CGI, given by the ChildReaper of the worker once the process is reaped
+    bool exited_;
     int cgiExitStatus_;
+    struct rusage usage_;
 
 
     // Manage arguments to give to the CGI
@@ -53,8 +71,15 @@ private:
     std::map<std::string, std::string> createScriptParams(const std::string& queryString);
     void paramDecode(std::string& arg) const;
 
-    void createEnvp(const std::vector<std::string>& envVars);
+    void createEnvp(const std::vector<std::string>& baseEnvVars, const std::vector<std::string>& envVars);
     void cleanupEnvp();
+
+    // Launch of the script in the child, its stdin / stdout being the pipes
+#ifdef CGI_USE_POSIX_SPAWN
+    bool spawn();
+#else
+    bool forkAndExec();
+#endif
 };
 
 #endif // CGIPROCESS_HPP
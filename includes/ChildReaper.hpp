@@ -0,0 +1,45 @@
+// ChildReaper.hpp
+#ifndef CHILDREAPER_HPP
+#define CHILDREAPER_HPP
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+
+/**
+ * @class ChildReaper
+ *
+ * The `ChildReaper` class turns the end of the child processes of a worker (CGI scripts) into an event of the
+ * event loop, so no code of the loop ever waits for a child.
+ *
+ * - **Self-pipe**: The SIGCHLD handler only writes a byte to a non-blocking pipe. Its read end is watched by the
+ *   event loop like any other fd : when it is readable, `drain()` empties it and `reap()` collects the children
+ *   that ended, one at a time.
+ *
+ * - **wait4**: The children are reaped with `wait4(WNOHANG)`, which gives their resource usage (CPU time,
+ *   memory) with their exit status. A SIGCHLD may stand for several children : every ended child is reaped
+ *   whichever signal woke the loop up.
+ *
+ * Only one ChildReaper can be open in a process (the signal handler writes to its pipe).
+ */
+class ChildReaper {
+public:
+    ChildReaper();
+    ~ChildReaper();
+
+    bool open();
+    void close();
+    int getFd() const;
+
+    void drain();
+    bool reap(pid_t& pid, int& status, struct rusage& usage);
+
+private:
+    int pipefd_[2];
+
+    ChildReaper(const ChildReaper&);
+    ChildReaper& operator=(const ChildReaper&);
+};
+
+#endif // CHILDREAPER_HPP
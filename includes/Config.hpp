@@ -4,7 +4,25 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <ctime>
 #include "Server.hpp"
+#include "ErrorPageCache.hpp"
+
+// Default values of the persistent connections directives
+const time_t DEFAULT_KEEPALIVE_TIMEOUT = 15;
+const size_t DEFAULT_KEEPALIVE_REQUESTS = 100;
+// Default values of the FastCGI pools directives (connections kept to each fastcgi_pass socket)
+const size_t DEFAULT_FASTCGI_POOL_SIZE = 8;
+const time_t DEFAULT_FASTCGI_IDLE_TIMEOUT = 60;
+const size_t DEFAULT_FASTCGI_QUEUE_SIZE = 256;
+// Default values of the open file cache directives (stat / open results kept by each worker)
+const size_t DEFAULT_OPEN_FILE_CACHE_MAX = 1024;
+const time_t DEFAULT_OPEN_FILE_CACHE_VALID = 5;
+// Default memory budget (bytes) of the pre-serialized responses of the 'static_cache on' locations, for each worker
+const size_t DEFAULT_STATIC_CACHE_SIZE = 16 * 1024 * 1024;
+// Default values of the admission control directives (open client connections of each worker, 0 = no limit)
+const size_t DEFAULT_MAX_CONNECTIONS = 1024;
+const size_t DEFAULT_MAX_CONNECTIONS_PER_IP = 0;
 
 class Server; // Forward declaration
 
@@ -34,6 +52,8 @@ public:
     const std::map<int, std::string> &getErrorPages() const;
     const std::string getErrorPage(int errorCode) const;
     const std::string getErrorPageFullPath(int errorCode) const;
+    void loadErrorPages();
+    const ErrorPageCache &getErrorPageCache() const;
 
     void setRoot(const std::string &root);
     const std::string &getRoot() const;
@@ -44,15 +64,65 @@ public:
     void addServer(Server* server);
     const std::vector<Server*>& getServers() const;
 
+    void setEventBackend(const std::string &backend);
+    const std::string &getEventBackend() const;
+
+    void setWorkers(size_t workers);
+    size_t getWorkers() const;
+
+    void setKeepaliveTimeout(time_t timeout);
+    time_t getKeepaliveTimeout() const;
+
+    void setKeepaliveRequests(size_t requests);
+    size_t getKeepaliveRequests() const;
+
+    void setFastCgiPoolSize(size_t size);
+    size_t getFastCgiPoolSize() const;
+
+    void setFastCgiIdleTimeout(time_t timeout);
+    time_t getFastCgiIdleTimeout() const;
+
+    void setFastCgiQueueSize(size_t size);
+    size_t getFastCgiQueueSize() const;
+
+    void setOpenFileCacheMax(size_t entries);
+    size_t getOpenFileCacheMax() const;
+
+    void setOpenFileCacheValid(time_t valid);
+    time_t getOpenFileCacheValid() const;
+
+    void setStaticCacheSize(size_t size);
+    size_t getStaticCacheSize() const;
+
+    void setMaxConnections(size_t connections);
+    size_t getMaxConnections() const;
+
+    void setMaxConnectionsPerIp(size_t connections);
+    size_t getMaxConnectionsPerIp() const;
+
     // DEBUG: Display the content of the config
     void displayConfig() const;
 
 private:
     size_t clientMaxBodySize_;
     std::map<int, std::string> errorPages_;
+    // Responses of the error pages of every context, built once the configuration is parsed
+    ErrorPageCache errorPageCache_;
     std::string root_;
     std::string index_;
     std::vector<Server*> servers_;
+    std::string eventBackend_;
+    size_t workers_;
+    time_t keepaliveTimeout_;
+    size_t keepaliveRequests_;
+    size_t fastCgiPoolSize_;
+    time_t fastCgiIdleTimeout_;
+    size_t fastCgiQueueSize_;
+    size_t openFileCacheMax_;
+    time_t openFileCacheValid_;
+    size_t staticCacheSize_;
+    size_t maxConnections_;
+    size_t maxConnectionsPerIp_;
 
 };
 
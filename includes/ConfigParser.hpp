@@ -9,6 +9,9 @@
 #include "Location.hpp"
 #include "Exceptions.hpp"
 
+// Max number of worker processes allowed by the 'workers' directive
+const size_t MAX_WORKERS = 512;
+
 /**
  * @class ConfigParser
  * 
@@ -55,9 +58,12 @@ private:
     // Auxiliary methods
     void parseSimpleDirective(const std::string &directiveName, std::string &value);
     void parseClientMaxBodySize(size_t &size);
+    void parseSize(const std::string &directiveName, size_t &size);
     void parseErrorPage(Config &config);
     void parseErrorPage(Server &server);
     void parseListen(Server &server);
+    void parseWorkers();
+    size_t parsePositiveNumber(const std::string &directiveName, size_t max);
 
     //check Methods
     void checkConfigValidity() const ; 
@@ -5,10 +5,45 @@
 #include <vector>
 #include <string>
 #include <ctime>
+#include <netinet/in.h>
 #include "Server.hpp"
 #include "Config.hpp"
+#include "VirtualHostTable.hpp"
 #include "HttpRequest.hpp"
 #include "CgiProcess.hpp"
+#include "HttpResponse.hpp"
+#include "OpenFileCache.hpp"
+#include "StaticResponseCache.hpp"
+#include "GzipEncoder.hpp"
+
+// Time to close inactive DataSockets in seconds (keepalive_timeout applies between two requests)
+const time_t SOCKET_INACTIVITY_TIMEOUT = 45; 
+// Max bytes given to one sendfile() call (keeps a big download from monopolizing the event loop)
+const size_t SENDFILE_CHUNK_SIZE = 1024 * 1024;
+// Bytes read from the CGI pipe at once
+const size_t CGI_READ_BUFFER_SIZE = 16384;
+// The CGI pipe is not read while more than this amount of its output waits to be sent (backpressure)
+const size_t CGI_OUTPUT_HIGH_WATER_MARK = 64 * 1024;
+// The client socket is not read while more than this amount of request body waits to be written to the CGI stdin
+const size_t CGI_INPUT_HIGH_WATER_MARK = 64 * 1024;
+// Max size of the header block written by a CGI before its body
+const size_t MAX_CGI_HEADERS_LENGTH = 8192;
+
+class DataSocket;
+
+/**
+ * @class CgiPipeWatcher
+ *
+ * Implemented by the event loop that watches the CGI pipes : a DataSocket tells it right before it closes one
+ * of them, so the fd is unregistered while its number can't have been reused (by the pipe of the next CGI).
+ * A FastCGI request whose streamed body turned out invalid is given up through it too (queue or connection).
+ */
+class CgiPipeWatcher {
+public:
+    virtual ~CgiPipeWatcher() {}
+    virtual void unwatchCgiPipe(DataSocket* dataSocket, int fd) = 0;
+    virtual void cancelFastCgiRequest(DataSocket* dataSocket) = 0;
+};
 
 
 /**
@@ -25,11 +60,29 @@
  * - **Request Processing**: It processes the HTTP request, including handling static file serving and delegating 
  *   to CGI processes for dynamic content.
  * 
- * - **CGI Process Management**: The class manages the CGI process, including reading from the CGI pipe, 
- *   checking the status of the CGI process, and handling its timeout and exit status.
+ * - **CGI Process Management**: The class manages the CGI process, including writing the request body to the 
+ *   CGI stdin pipe (the CGI is started once the headers are parsed, the body is streamed to it as it is received,
+ *   the client is not read while the script is slower than it), reading from the CGI pipe, checking the status of the CGI process, and handling its 
+ *   timeout and exit status. The CGI header block (Status, Content-Type, Location ...) is parsed as soon as 
+ *   it is read, then the body is relayed to the client while the script produces it (chunked for HTTP/1.1). 
+ *   With `fastcgi_pass`, the request is handed to the FastCGI pool of the WebServer instead of a CGI process, 
+ *   and its output comes back through the same path (the body is streamed to it as STDIN records).
  * 
  * - **Data Sending and Timeout**: It manages the sending of the HTTP response to the client and checks for 
- *   inactivity timeouts to close the socket if no activity is detected.
+ *   inactivity timeouts to close the socket if no activity is detected. A response of the static cache (or a 
+ *   preloaded error page) is sent from its shared buffer with writev(), around the Connection header of this socket.
+ * 
+ * - **Compression**: A response marked for gzip (`gzip on` locations) is compressed while it is sent : the next 
+ *   GZIP_CHUNK_SIZE bytes of the file (or in-memory body) are only read and compressed once the previous ones 
+ *   have been sent, the CGI output is compressed as it is relayed. The length of the body is unknown : it is 
+ *   chunked for HTTP/1.1 clients, older clients get it until the connection closes.
+ * 
+ * - **HEAD**: The response of a HEAD request is the header block of the GET response, its body (file, 
+ *   in-memory, compressed or produced by a CGI) is never sent.
+ * 
+ * - **Persistent Connections**: HTTP/1.1 connections are kept open after the response (keepalive_timeout, 
+ *   keepalive_requests). Pipelined requests stay buffered in the HttpRequest and are parsed one at a time, 
+ *   once the previous response has been fully sent.
  * 
  * - **Socket Management**: The class provides methods for closing the socket, checking if the request is complete, 
  *   and retrieving the last activity time to handle client disconnections or timeouts.
@@ -40,50 +93,154 @@
 
 class DataSocket {
 public:
-    DataSocket(int fd, const std::vector<Server*>& servers, const Config* config);
+    DataSocket(int fd, const struct sockaddr_in& peerAddress, const VirtualHostTable& virtualHosts, const Config* config,
+               OpenFileCache* openFileCache, StaticResponseCache* staticResponseCache);
     ~DataSocket();
 
     bool receiveData();
     void handleParseError(int errorCode);
     bool isRequestComplete() const;
+    bool isReadyToProcess() const;
+    bool wantsToReceive() const;
     void processRequest();
+    void queueResponse(HttpResponse& response);
     bool sendData();
     bool hasDataToSend() const;
     void closeSocket();
     int getSocket() const;
+    const std::string& getRemoteAddress() const;
+    uint16_t getRemotePort() const;
     const Server* getAssociatedServer() const;
     time_t getLastActivityTime() const;
+    bool hasTimedOut(time_t currentTime) const;
+    time_t getTimeoutDeadline() const;
+    bool isFinished() const;
 
     // CGI handling methods
+    void setCgiPipeWatcher(CgiPipeWatcher* watcher);
     bool hasCgiProcess() const;
+    pid_t getCgiPid() const;
     int getCgiPipeFd() const;
+    int getCgiInputFd() const;
+    bool writeToCgiInput();
+    bool wantsCgiInput() const;
+    bool hasCgiInput() const;
+    void appendCgiInput(const char* data, size_t length);
+    void finishCgiInput();
+    void closeCgiInput();
     bool isCgiComplete() const;
+    bool isWaitingForBackend() const;
     bool readFromCgiPipe();
+    bool appendCgiOutput(const char* data, size_t length);
+    bool wantsCgiOutput() const;
     void handleCgiProcessExitStatus();
     void closeCgiPipe();
+    bool handleCgiExit(pid_t pid, int status, const struct rusage& usage);
 
     bool cgiProcessIsRunning() const;
     bool cgiProcessHasTimedOut() const;
+    time_t getCgiDeadline() const;
     void terminateCgiProcess(int errorCode);
 
+    // FastCGI handling methods
+    bool hasFastCgiRequest() const;
+    const std::string& getFastCgiPass() const;
+    const std::vector<std::string>& getFastCgiParams() const;
+    bool takeCgiInput(std::string& input);
+    void finishFastCgiRequest(bool failed);
+    void failFastCgiRequest(int errorCode);
+
 
 private:
     int client_fd_;
-    std::vector<Server*> associatedServers_;
+    // Address of the client (accept), for the logs and the CGI (REMOTE_ADDR)
+    std::string remoteAddress_;
+    uint16_t remotePort_;
+    // Servers of the ListeningSocket that accepted the connection
+    const VirtualHostTable& virtualHosts_;
     HttpRequest httpRequest_;
     bool requestComplete_;
     const Config *config_;
+    // Shared by the DataSockets of the worker, owned by the WebServer
+    OpenFileCache* openFileCache_;
+    StaticResponseCache* staticResponseCache_;
     std::string sendBuffer_;
     size_t sendBufferOffset_;
+
+    // File body streamed after sendBuffer_ (sendfile)
+    int sendFileFd_;
+    off_t sendFileOffset_;
+    size_t sendFileRemaining_;
+    // multipart/byteranges : slices of the file sent one after the other, after their part headers
+    std::vector<BodyFilePart> sendFileParts_;
+    size_t sendFilePartIndex_;
+    ssize_t sendFileChunk();
+    bool nextFilePart();
+    void closeSendFile();
+
+    // Pre-serialized response (static cache, error pages) : its header block, the headers added to it (Allow ...), 
+    // connectionHeader_, then its body (none for HEAD)
+    SharedBuffer* sharedResponse_;
+    size_t sharedHeaderLength_;
+    std::string sharedExtraHeaders_;
+    size_t sharedBodyLength_;
+    const char* connectionHeader_;
+    size_t sharedResponseOffset_;
+    ssize_t sendSharedResponse();
+    size_t getSharedResponseLength() const;
+    void releaseSharedResponse();
+
+    // On-the-fly gzip : the body (file of sendFileFd_ or gzipSource_) is compressed before being queued in sendBuffer_
+    GzipEncoder* gzipEncoder_;
+    bool gzipChunked_;
+    bool gzipBodyPending_;
+    std::string gzipSource_;
+    size_t gzipSourceOffset_;
+    bool startGzip(HttpResponse& response, bool chunked);
+    bool produceGzipBody();
+    void appendBodyChunk(const char* data, size_t length, bool chunked);
+    void releaseGzip();
     
-    // Check Inactivity Timeout
+    // Check Inactivity Timeout (monotonic seconds, TimerWheel::currentTime())
     time_t lastActivityTime_; 
 
+    // Persistent connection : requests already answered on this connection
+    size_t requestsCount_;
+    // HEAD : the response is sent without its body (the CGI output is read and dropped)
+    bool headRequest_;
+    void parseReceivedData();
+
     // CGI handling attributes
     CgiProcess* cgiProcess_;
+    CgiPipeWatcher* cgiPipeWatcher_;
     int cgiPipeFd_;
     bool cgiComplete_;
+    // CGI output : header block until the response is started, then relayed straight to sendBuffer_
     std::string cgiOutputBuffer_;
+    bool cgiResponseStarted_;
+    bool cgiChunked_;
+    // Location of the CGI, and Accept-Encoding of its request : the gzip of the output depends on its Content-Type
+    const Location* cgiLocation_;
+    bool cgiAcceptsGzip_;
+    bool parseCgiHeaders(bool atEof);
+    void startCgiResponse(HttpResponse& response, size_t bodyStart);
+    void appendCgiBody(const char* data, size_t length);
+    void finishCgiOutput(bool failed);
+    void failCgiOutput(int errorCode);
+    void parseAfterBackend();
+    void endCgiProcess();
+    void releaseCgiProcess();
+    // Request body written to the CGI stdin : streamed by a CgiInputSink while it is received
+    std::string cgiInputBuffer_;
+    size_t cgiInputOffset_;
+    bool cgiInputComplete_;
+    bool cgiBodyStreaming_;
+    void startCgiInput();
+    void parseStreamedBody();
+    // FastCGI request : queued in (or being handled by) the pool of the fastcgi_pass socket
+    bool fastCgiActive_;
+    std::string fastCgiPass_;
+    std::vector<std::string> fastCgiParams_;
     bool shouldCloseAfterSend_;
 };
 
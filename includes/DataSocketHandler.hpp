@@ -2,6 +2,7 @@
 #define DATASOCKETHANDLER_HPP
 
 #include <vector>
+#include <set>
 #include "DataSocket.hpp"
 
 /**
@@ -15,7 +16,8 @@
  *   sockets are kept in the list of client sockets.
  * 
  * - **Cleanup**: The class ensures that closed or inactive sockets are removed, freeing up resources and preventing 
- *   resource leaks.
+ *   resource leaks. A socket closed by the event loop is queued by `closeClientSocket()` and deleted at the end of 
+ *   the iteration : only the closed sockets are looked at, whatever the number of connections.
  * 
  * This class is an essential component of the web server's infrastructure, ensuring proper management of client 
  * connections, resource cleanup, and overall handling of client-server communication.
@@ -23,16 +25,18 @@
 
 class DataSocketHandler {
 private:
-    std::vector<DataSocket*> clientSockets;
+    std::set<DataSocket*> clientSockets;
+    // Closed during the current iteration of the event loop, deleted by removeClosedSockets()
+    std::vector<DataSocket*> closedSockets;
 
 public:
     DataSocketHandler();
     ~DataSocketHandler();
 
     void addClientSocket(DataSocket* dataSocket);
-    void handleClientSockets();
+    void closeClientSocket(DataSocket* dataSocket);
     void removeClosedSockets();
-    const std::vector<DataSocket*>& getClientSockets() const;
+    const std::set<DataSocket*>& getClientSockets() const;
 
     void cleanUp();
 };
@@ -0,0 +1,39 @@
+// EpollMultiplexer.hpp
+#ifndef EPOLLMULTIPLEXER_HPP
+#define EPOLLMULTIPLEXER_HPP
+
+#include <vector>
+#include "EventMultiplexer.hpp"
+
+#ifdef __linux__
+# include <sys/epoll.h>
+
+/**
+ * @class EpollMultiplexer
+ *
+ * Linux backend based on `epoll`. Registrations live in the kernel, a wakeup only costs the number of
+ * ready fds. The fds are watched level-triggered : a handler that does not consume everything
+ * (one recv() per event) will be notified again on the next iteration.
+ */
+class EpollMultiplexer : public EventMultiplexer {
+public:
+    EpollMultiplexer();
+    virtual ~EpollMultiplexer();
+
+    virtual bool addFd(int fd, unsigned int events);
+    virtual bool modifyFd(int fd, unsigned int events);
+    virtual void removeFd(int fd);
+    virtual int waitEvents(std::vector<IoEvent>& readyEvents, int timeoutMs);
+    virtual const char* getName() const;
+
+private:
+    int epollFd_;
+    size_t registeredCount_;
+    std::vector<struct epoll_event> epollEvents_;
+
+    static uint32_t toEpollEvents(unsigned int events);
+};
+
+#endif // __linux__
+
+#endif // EPOLLMULTIPLEXER_HPP
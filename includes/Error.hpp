@@ -5,7 +5,9 @@
 #include <string>
 #include "Server.hpp"
 #include "HttpResponse.hpp"
+#include "ErrorPageCache.hpp"
 
-HttpResponse handleError(int statusCode, const std::string &errorPagePath); 
+HttpResponse handleError(int statusCode, const std::string &errorPagePath, const ErrorPageCache* errorPageCache = NULL);
+bool readErrorPage(const std::string &errorPagePath, std::string &content);
 
-#endif // ERROR_HPP
\ No newline at end of file
+#endif // ERROR_HPP
@@ -0,0 +1,54 @@
+// ErrorPageCache.hpp
+#ifndef ERRORPAGECACHE_HPP
+#define ERRORPAGECACHE_HPP
+
+#include <string>
+#include <map>
+#include <utility>
+#include "SharedBuffer.hpp"
+
+class Config; // Forward declaration
+
+
+/**
+ * @class ErrorPageCache
+ *
+ * The `ErrorPageCache` class holds the error responses of every `error_page` of the configuration (global, server
+ * and location), built once when the configuration is loaded : serving an error costs no stat / open / read.
+ *
+ * - **Entries**: Keyed by status code and full path of the page (the path depends on the root of the context, 
+ *   empty for the codes without error_page). Each entry is a response serialized once in a `SharedBuffer` 
+ *   (status line, headers, body) : `handleError()` gives it with `setSharedResponse()`, the DataSocket sends it 
+ *   with writev() around its Connection header, nothing is copied.
+ *
+ * - **Refresh**: The pages are read with the configuration, loading a configuration again reads them again.
+ *   A page missing or unreadable at load time is kept as the default "Error <code>" body, like before.
+ */
+class ErrorPageCache {
+public:
+    ErrorPageCache();
+    ~ErrorPageCache();
+
+    void load(const Config& config);
+    SharedBuffer* find(int statusCode, const std::string& path, size_t& headerLength) const;
+    size_t size() const;
+
+private:
+    typedef std::pair<int, std::string> Key;
+
+    struct Entry {
+        SharedBuffer* response;
+        // Status line and headers, without the empty line : the Connection header of each socket goes there
+        size_t headerLength;
+    };
+
+    std::map<Key, Entry> responses_;
+
+    void add(int statusCode, const std::string& path, std::map<std::string, std::pair<bool, std::string> >& contents);
+    void clear();
+
+    ErrorPageCache(const ErrorPageCache&);
+    ErrorPageCache& operator=(const ErrorPageCache&);
+};
+
+#endif // ERRORPAGECACHE_HPP
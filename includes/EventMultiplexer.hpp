@@ -0,0 +1,53 @@
+// EventMultiplexer.hpp
+#ifndef EVENTMULTIPLEXER_HPP
+#define EVENTMULTIPLEXER_HPP
+
+#include <string>
+#include <vector>
+
+// Events a fd can be watched for / can report (backend independent)
+const unsigned int EVENT_READ   = 1 << 0;
+const unsigned int EVENT_WRITE  = 1 << 1;
+const unsigned int EVENT_HANGUP = 1 << 2;
+const unsigned int EVENT_ERROR  = 1 << 3;
+
+struct IoEvent {
+    int fd;
+    unsigned int events;
+};
+
+
+/**
+ * @class EventMultiplexer
+ *
+ * The `EventMultiplexer` class is the abstraction used by the `WebServer` event loop to watch many file
+ * descriptors (listening sockets, data sockets, CGI pipes) at the same time without blocking on any of them.
+ *
+ * - **Persistent Registrations**: A fd is registered once with `addFd()` and stays watched across loop
+ *   iterations until `removeFd()` is called. `modifyFd()` only needs to be called when the interest changes
+ *   (e.g. a `DataSocket` now has data to send and wants `EVENT_WRITE`).
+ *
+ * - **Backends**: `EpollMultiplexer` (level-triggered epoll, Linux) scales with the number of ready fds only.
+ *   `PollMultiplexer` keeps a persistent pollfd array and is kept as a portable fallback.
+ *
+ * The backend is chosen with the global `event_backend epoll|poll;` directive.
+ */
+class EventMultiplexer {
+public:
+    virtual ~EventMultiplexer();
+
+    virtual bool addFd(int fd, unsigned int events) = 0;
+    virtual bool modifyFd(int fd, unsigned int events) = 0;
+    virtual void removeFd(int fd) = 0;
+
+    // Wait at most timeoutMs (-1 = infinite) and fill readyEvents, returns the number of ready fds or -1
+    virtual int waitEvents(std::vector<IoEvent>& readyEvents, int timeoutMs) = 0;
+
+    virtual const char* getName() const = 0;
+
+    static EventMultiplexer* create(const std::string& backend);
+    static bool isBackendAvailable(const std::string& backend);
+    static std::string getDefaultBackend();
+};
+
+#endif // EVENTMULTIPLEXER_HPP
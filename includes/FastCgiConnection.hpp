@@ -0,0 +1,105 @@
+// FastCgiConnection.hpp
+#ifndef FASTCGICONNECTION_HPP
+#define FASTCGICONNECTION_HPP
+
+#include <string>
+#include <vector>
+#include <ctime>
+#include <sys/types.h>
+#include "TimerWheel.hpp"
+
+class DataSocket; // Forward declaration
+
+// FastCGI protocol (version 1) : record types, role and flags used by a web server
+const unsigned char FCGI_VERSION_1 = 1;
+const unsigned char FCGI_BEGIN_REQUEST = 1;
+const unsigned char FCGI_END_REQUEST = 3;
+const unsigned char FCGI_PARAMS = 4;
+const unsigned char FCGI_STDIN = 5;
+const unsigned char FCGI_STDOUT = 6;
+const unsigned char FCGI_STDERR = 7;
+const unsigned short FCGI_RESPONDER = 1;
+const unsigned char FCGI_KEEP_CONN = 1;
+const unsigned char FCGI_REQUEST_COMPLETE = 0;
+const size_t FCGI_HEADER_LENGTH = 8;
+const size_t FCGI_MAX_CONTENT_LENGTH = 65535;
+// Only one request at a time on a connection
+const unsigned short FCGI_REQUEST_ID = 1;
+
+// Bytes read from a FastCGI connection at once
+const size_t FASTCGI_READ_BUFFER_SIZE = 16384;
+
+// Result of FastCgiConnection::open() : RETRY when the backlog of the responder is full (connect() EAGAIN)
+enum FastCgiOpenResult {
+    FASTCGI_OPEN_OK,
+    FASTCGI_OPEN_FAILED,
+    FASTCGI_OPEN_RETRY
+};
+
+
+/**
+ * @class FastCgiConnection
+ *
+ * The `FastCgiConnection` class is one non-blocking connection to a FastCGI responder listening on a Unix socket.
+ * It is owned by a `FastCgiPool` and kept open between requests (FCGI_KEEP_CONN), so the responder and its
+ * interpreter are started once instead of for each request.
+ *
+ * - **Request**: `startRequest()` serializes the request of a DataSocket (BEGIN_REQUEST, PARAMS records) in a send
+ *   buffer that is written while the socket is writable. The body is taken from the DataSocket as it is received and
+ *   sent as STDIN records, the next part once the previous one has been written (backpressure on the client).
+ *
+ * - **Response**: The STDOUT records are given to the DataSocket as they arrive (same path as the output of a CGI
+ *   process), STDERR is logged, END_REQUEST ends the response and makes the connection idle again.
+ *
+ * - **Event loop**: The connection never blocks. `getWantedEvents()` tells what the WebServer has to watch : the output
+ *   is not read while the client is slower than the responder (backpressure). Its timer is scheduled by the
+ *   WebServer at its idle or read deadline (`FastCgiPool::getDeadline()`).
+ */
+class FastCgiConnection {
+public:
+    FastCgiConnection(const std::string& socketPath);
+    ~FastCgiConnection();
+
+    FastCgiOpenResult open();
+    void startRequest(DataSocket* client);
+    bool handleWritable();
+    bool handleReadable();
+
+    int getFd() const;
+    const std::string& getSocketPath() const;
+    DataSocket* getClient() const;
+    DataSocket* detachClient();
+    bool isIdle() const;
+    unsigned int getWantedEvents() const;
+    time_t getLastActivityTime() const;
+    Timer& getTimer();
+
+private:
+    int fd_;
+    std::string socketPath_;
+    bool connected_;
+    DataSocket* client_;
+    // Requests already answered on this connection
+    size_t requestsCount_;
+
+    std::string sendBuffer_;
+    size_t sendBufferOffset_;
+    std::string recvBuffer_;
+    size_t recvOffset_;
+    time_t lastActivityTime_;
+    // The empty STDIN record has been queued : the whole body has been taken from the client
+    bool stdinComplete_;
+    // Idle or read timeout, in the timer wheel of the WebServer
+    Timer timer_;
+
+    void appendRecord(unsigned char type, const char* content, size_t length);
+    void appendStdin();
+    void appendParam(std::string& params, const std::string& name, const std::string& value) const;
+    void appendLength(std::string& params, size_t length) const;
+    bool handleRecord(unsigned char type, const char* content, size_t length);
+
+    FastCgiConnection(const FastCgiConnection&);
+    FastCgiConnection& operator=(const FastCgiConnection&);
+};
+
+#endif // FASTCGICONNECTION_HPP
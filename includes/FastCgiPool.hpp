@@ -0,0 +1,58 @@
+// FastCgiPool.hpp
+#ifndef FASTCGIPOOL_HPP
+#define FASTCGIPOOL_HPP
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <ctime>
+#include "FastCgiConnection.hpp"
+
+// A busy connection that receives nothing from the responder during this delay (seconds) is given up (504)
+const time_t FASTCGI_READ_TIMEOUT = 30;
+
+
+/**
+ * @class FastCgiPool
+ *
+ * The `FastCgiPool` class manages the connections of a WebServer to one `fastcgi_pass` socket.
+ *
+ * - **Pool**: At most `fastcgi_pool_size` connections are opened, each one handles one request at a time and
+ *   stays open after it (the responder keeps its workers and interpreters alive).
+ *
+ * - **Queueing**: A request that finds no idle connection (and no room for a new one) waits in a FIFO queue
+ *   of at most `fastcgi_queue_size` requests, it is dispatched as soon as a connection becomes idle.
+ *
+ * - **Reaping**: `getDeadline()` tells when a connection has been idle for more than `fastcgi_idle_timeout`, or busy
+ *   without anything from the responder for FASTCGI_READ_TIMEOUT : the WebServer closes it from its timer.
+ *
+ * The fds of the connections are registered in the event loop by the WebServer, that also closes them
+ * through `removeConnection()`.
+ */
+class FastCgiPool {
+public:
+    FastCgiPool(const std::string& socketPath, size_t maxConnections, size_t maxQueued, time_t idleTimeout);
+    ~FastCgiPool();
+
+    bool enqueue(DataSocket* client);
+    DataSocket* dispatchNext(FastCgiConnection*& connection);
+    FastCgiConnection* cancel(DataSocket* client);
+    FastCgiConnection* findConnection(const DataSocket* client) const;
+    void removeConnection(FastCgiConnection* connection);
+    time_t getDeadline(const FastCgiConnection* connection) const;
+    bool isWaitingForConnection() const;
+    const std::string& getSocketPath() const;
+
+private:
+    std::string socketPath_;
+    size_t maxConnections_;
+    size_t maxQueued_;
+    time_t idleTimeout_;
+    std::vector<FastCgiConnection*> connections_;
+    std::deque<DataSocket*> queue_;
+
+    FastCgiPool(const FastCgiPool&);
+    FastCgiPool& operator=(const FastCgiPool&);
+};
+
+#endif // FASTCGIPOOL_HPP
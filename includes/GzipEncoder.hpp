@@ -0,0 +1,51 @@
+// GzipEncoder.hpp
+#ifndef GZIPENCODER_HPP
+#define GZIPENCODER_HPP
+
+#include <string>
+#include <cstddef>
+#include <zlib.h>
+
+// Bytes of a body compressed at once, and size of the output buffer of deflate()
+const size_t GZIP_CHUNK_SIZE = 16384;
+
+
+/**
+ * @class GzipEncoder
+ *
+ * The `GzipEncoder` class compresses a response body on the fly (`gzip on` locations) in the gzip format,
+ * one piece at a time : the body is never held entirely in memory, compressed or not.
+ *
+ * - **Streaming**: `compress()` gives the compressed bytes available for the piece of body given, with a
+ *   fixed size output buffer. The DataSocket compresses the next piece of a file (or in-memory body) only once
+ *   the previous one has been sent, so the memory used by a response stays bounded whatever its size.
+ *
+ * - **Flush**: The output of a CGI is flushed (Z_SYNC_FLUSH) after each piece read from the script, so the
+ *   client receives what the script produced without waiting for the next piece.
+ *
+ * - **End**: `finish()` gives the end of the stream (gzip trailer). The encoder can't be used afterwards.
+ */
+class GzipEncoder {
+public:
+    explicit GzipEncoder(int level);
+    ~GzipEncoder();
+
+    bool isValid() const;
+    bool compress(const char* data, size_t length, std::string& output, bool flush);
+    bool finish(std::string& output);
+
+    size_t getTotalIn() const;
+    size_t getTotalOut() const;
+
+private:
+    z_stream stream_;
+    bool valid_;
+    bool finished_;
+
+    bool deflateAll(int flush, std::string& output);
+
+    GzipEncoder(const GzipEncoder&);
+    GzipEncoder& operator=(const GzipEncoder&);
+};
+
+#endif // GZIPENCODER_HPP
@@ -2,11 +2,16 @@
 #define HTTPREQUEST_HPP
 
 #include <string>
-#include <map>
+#include <vector>
+#include "BodySink.hpp"
 
 // these limit can be modified
 const size_t MAX_REQUEST_LINE_LENGTH = 500;
 const size_t MAX_URI_LENGTH = 250;
+// Request line + headers, checked while the header block is still incomplete
+const size_t MAX_HEADERS_LENGTH = 8192;
+// Chunk size line (with its extensions) and trailer lines of a chunked body
+const size_t MAX_CHUNK_LINE_LENGTH = 1024;
 
 
 /**
@@ -17,7 +22,16 @@ const size_t MAX_URI_LENGTH = 250;
  * body, and any associated query strings. 
  * 
  * - **Request Parsing**: It handles the parsing of the request line, headers, and body, ensuring that the 
- *   incoming request conforms to the HTTP protocol and is valid.
+ *   incoming request conforms to the HTTP protocol and is valid. The parser is a resumable state machine : 
+ *   it remembers its offset in rawData_ and only looks at the bytes received since the previous call. 
+ *   Headers are stored as offsets in rawData_ (no copy per line), body bytes are appended directly to body_.
+ * 
+ * - **Chunked Bodies**: `Transfer-Encoding: chunked` bodies are decoded on the fly, chunk by chunk. Once the 
+ *   headers are parsed, the parser waits for setMaxBodySize() (client_max_body_size of the matching location) : 
+ *   an oversized body is rejected (413) as soon as it crosses the limit, without being buffered.
+ * 
+ * - **Body Destination**: The decoded body is stored in body_, unless a BodySink (e.g. MultipartUploadSink) 
+ *   has been attached with setBodySink() : the body is then streamed to it and never kept in memory.
  * 
  * - **Data Handling**: The class can append incoming data, check whether the request is complete, and 
  *   extract specific information such as the HTTP method, path, headers, and body.
@@ -37,13 +51,25 @@ public:
     HttpRequest();
     ~HttpRequest();
 
-    void appendData(const std::string& data);
+    void appendData(const char* data, size_t length);
     bool isComplete() const;
     bool parseRequest();
+
+    // client_max_body_size, known once the headers are parsed (0 stands for 'no limit')
+    bool isWaitingForBodyLimit() const;
+    void setMaxBodySize(size_t maxBodySize);
+    bool isChunked() const;
+    void setBodySink(BodySink* bodySink);
+    const BodySink* getBodySink() const;
     
     bool hasParseError() const;
     int getParseErrorCode() const;
 
+    // Persistent connections
+    bool isKeepAlive() const;
+    void disableKeepAlive();
+    bool hasPendingData() const;
+
     void reset();
 
     const std::string& getMethod() const;
@@ -52,14 +78,26 @@ public:
     const std::string& getHttpVersion() const;
     std::string getHeader(const std::string& headerName) const;
     const std::string& getBody() const;
+    void moveBodyTo(std::string& destination);
     std::string getQueryString() const;
+    bool acceptsEncoding(const std::string& coding) const;
 
     //debug
     void displayContent() const;
 
 private:
+    // Position of a header name and value in rawData_ (whitespaces already trimmed)
+    struct HeaderSpan {
+        size_t nameStart;
+        size_t nameLength;
+        size_t valueStart;
+        size_t valueLength;
+    };
+
     // Membres de données
     std::string rawData_;
+    size_t parsePos_;
+    size_t scanPos_;
     std::string method_;
     std::string rawPath_;
     std::string path_;
@@ -67,24 +105,48 @@ private:
     std::string httpVersion_;
     std::string body_;
     size_t contentLength_;
-    size_t bodyStartPos_;
     bool headersParsed_;
-    enum State { REQUEST_LINE, HEADERS, BODY, COMPLETE } state_;
-    std::map<std::string, std::string> headers_;
+    bool keepAlive_;
+    enum State { REQUEST_LINE, HEADERS, BODY, CHUNK_SIZE, CHUNK_DATA, CHUNK_DATA_END, CHUNK_TRAILER, COMPLETE } state_;
+
+    // Body limits and chunked decoding
+    size_t headersEndPos_;
+    size_t maxBodySize_;
+    bool bodyLimitSet_;
+    bool chunked_;
+    size_t chunkRemaining_;
+    size_t bodyReceived_;
+    BodySink* bodySink_;
+
+    // Owns the BodySink
+    HttpRequest(const HttpRequest&);
+    HttpRequest& operator=(const HttpRequest&);
+    std::vector<HeaderSpan> headers_;
 
     // Manage errors
     bool parseError_;
     int parseErrorCode_;
 
     // Parsing 
-    bool handleRequestLine(const std::string& line);
-    bool handleHeaders(const std::string& line);
+    bool findLineEnd(size_t& lineEnd);
+    bool checkHeadersLength(size_t headersLength);
+    bool handleRequestLine(size_t lineStart, size_t lineEnd);
+    bool handleHeaders(size_t lineStart, size_t lineEnd);
     bool handleBody();
+    bool handleChunks();
+    bool parseChunkSize(size_t lineStart, size_t lineEnd);
+    bool appendBody(const char* data, size_t length);
+    bool completeBody();
+    void discardConsumedBody();
     bool validateHeaders();
     bool validatePOSTContentType();
-    bool validatePOSTContentLength(); 
+    bool validateContentLength();
+    bool validateTransferEncoding();
     bool parseRequestLine(const std::string& line);
-    void parseHeaderLine(const std::string& line);
+    bool parseHeaderLine(size_t lineStart, size_t lineEnd);
+    const HeaderSpan* findHeader(const std::string& headerName) const;
+    bool headerNameIs(const HeaderSpan& header, const std::string& headerName) const;
+    bool hasConnectionToken(const std::string& token) const;
     std::string normalizePath(const std::string& path) const;
     std::string trim(const std::string& str);
 };
@@ -3,7 +3,20 @@
 
 #include <string>
 #include <map>
+#include <vector>
+#include <sys/types.h>
+#include "SharedBuffer.hpp"
 
+// Part of a file body sent in several slices (multipart/byteranges) : `header` is sent, then `length` bytes of the
+// file from `offset`. The last part is the closing delimiter alone (length 0).
+struct BodyFilePart {
+    std::string header;
+    off_t offset;
+    size_t length;
+
+    BodyFilePart(const std::string& partHeader, off_t partOffset, size_t partLength)
+        : header(partHeader), offset(partOffset), length(partLength) {}
+};
 
 /**
  * @class HttpResponse
@@ -22,6 +35,20 @@
  * - **Response Formatting**: The class includes a method to convert the response into a valid HTTP format 
  *   for transmission over the network.
  * 
+ * - **File Bodies**: Instead of an in-memory body, a response can carry an open file descriptor with an offset 
+ *   and a length (`setBodyFile`). Only the header block is serialized, the `DataSocket` streams the file itself 
+ *   with sendfile(). The fd is owned by the one that sends the response (`DataSocket::queueResponse`).
+ *   A multipart/byteranges body is a list of slices of the same file, each one after its part headers 
+ *   (`setBodyFileParts`).
+ * 
+ * - **Pre-serialized Responses**: A response can also be a `SharedBuffer` already serialized by the 
+ *   `StaticResponseCache` or the `ErrorPageCache` (`setSharedResponse`), only its Connection header (and the 
+ *   headers set afterwards, like the Allow of a 405) is added when it is sent. 
+ *   The buffer is referenced by each copy of the response.
+ * 
+ * - **Compression**: A response marked with a gzip level (`setGzipLevel`, `gzip on` locations) has its body 
+ *   compressed on the fly by the `DataSocket` that sends it.
+ * 
  * This class is a key component in the web server’s ability to send properly structured HTTP responses 
  * to clients, ensuring the server communicates effectively with the requesting client.
  */
@@ -32,18 +59,48 @@ private:
     std::string reasonPhrase;                         
     std::string body;                                 
     std::map<std::string, std::string> headers;       
+    int bodyFd;
+    off_t bodyFileOffset;
+    size_t bodyFileLength;
+    std::vector<BodyFilePart> bodyFileParts;
+    SharedBuffer* sharedResponse;
+    size_t sharedHeaderLength;
+    int gzipLevel;
 
 public:
     HttpResponse();
+    HttpResponse(const HttpResponse& other);
+    HttpResponse& operator=(const HttpResponse& other);
+    ~HttpResponse();
 
     // Methods to set response properties
     void setStatusCode(int code);
     std::string getDefaultReasonPhrase(int code) const;
     void setReasonPhrase(const std::string& phrase);
     void setBody(const std::string& bodyContent);
+    void setBodyFile(int fd, off_t offset, size_t length);
+    void setBodyFileParts(int fd, const std::vector<BodyFilePart>& parts);
     void setHeader(const std::string& headerName, const std::string& headerValue);
+    void setSharedResponse(SharedBuffer* response, size_t headerLength);
+    void removeHeader(const std::string& headerName);
+    void setGzipLevel(int level);
+
+    int getStatusCode() const;
+    const std::string& getBody() const;
+    bool hasBodyFile() const;
+    int getBodyFd() const;
+    off_t getBodyFileOffset() const;
+    size_t getBodyFileLength() const;
+    const std::vector<BodyFilePart>& getBodyFileParts() const;
+    bool hasSharedResponse() const;
+    SharedBuffer* getSharedResponse() const;
+    size_t getSharedHeaderLength() const;
+    std::string getHeader(const std::string& headerName) const;
+    int getGzipLevel() const;
 
     // Put the response to HTTP format before sending it
+    std::string generateHeaders() const;
+    std::string generateHeaderFields() const;
     std::string generateResponse() const;
 
 private:
@@ -2,8 +2,11 @@
 #define LISTENINGSOCKET_HPP
 
 #include <netinet/in.h>
+#include <sys/socket.h>
 #include <vector>
+#include <string>
 #include "Server.hpp"
+#include "VirtualHostTable.hpp"
 
 
 /**
@@ -17,29 +20,46 @@
  *   to listen for incoming client connections.
  * 
  * - **Server Association**: It maintains a list of associated servers, allowing multiple servers to share 
- *   the same listening socket if needed.
+ *   the same listening socket if needed. Their names are indexed in a `VirtualHostTable`, which selects the 
+ *   server of each request from its Host header.
  * 
  * - **Connection Handling**: The class provides methods to accept new client connections and retrieve 
- *   the socket for further communication.
+ *   the socket for further communication. The socket is non-blocking : the event loop accepts the pending
+ *   connections until there is none left (or ACCEPT_BATCH_MAX), each one is non-blocking and close-on-exec
+ *   (never inherited by the CGI processes) and comes with the address of the client.
+ * 
+ * - **Workers**: With `reusePort`, the socket is bound with SO_REUSEPORT so every worker process can bind its own 
+ *   socket on the same IP:PORT, the kernel then balances new connections between the workers.
  * 
  * This class is an essential component of the server infrastructure, enabling it to listen for and handle 
  * incoming client requests over the network.
  */
 
+// Connections accepted at most for each readiness of a listening socket : the other fds get their turn
+const int ACCEPT_BATCH_MAX = 64;
+// Returned by acceptConnection() when the process has no fd left (EMFILE / ENFILE) : the connection stays pending
+const int ACCEPT_OUT_OF_FDS = -2;
+
+
 class ListeningSocket {
 private:
     int listeningSocket_fd;
     struct sockaddr_in address;
     std::vector<Server*> associatedServers;
+    VirtualHostTable virtualHosts;
 
 public:
-    ListeningSocket(uint32_t host, uint16_t port);
+    ListeningSocket(uint32_t host, uint16_t port, int backlog, bool reusePort);
     ~ListeningSocket();
 
     void addServer(Server* server);
-    int acceptConnection();
+    int acceptConnection(struct sockaddr_in& peerAddress);
     int getSocket() const;
     const std::vector<Server*>& getAssociatedServers() const;
+    const VirtualHostTable& getVirtualHosts() const;
 };
 
+// "IP:PORT" of a listening address (network order)
+std::string printIp(uint32_t host, uint16_t port);
+
 #endif // LISTENINGSOCKET_HPP
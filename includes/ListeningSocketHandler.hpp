@@ -37,6 +37,8 @@ private:
     std::vector<ListeningSocket*> listeningSockets_; 
     std::map<std::pair<uint32_t, uint16_t>, ListeningSocket*> listeningSocketsMap_; 
 
+    int getListenBacklog(const std::vector<Server*>& servers, const std::pair<uint32_t, uint16_t>& key) const;
+
 public:
     ListeningSocketHandler();
     ~ListeningSocketHandler();
@@ -46,7 +48,7 @@ public:
 
     void cleanUp();
 
-    void initialize(const std::vector<Server*>& servers);
+    void initialize(const std::vector<Server*>& servers, bool reusePort);
 };
 
 #endif // LISTENINGSOCKETHANDLER_HPP
@@ -7,6 +7,13 @@
 
 class Server; // Forward declaration
 
+// Default value of 'static_cache_max_size' : bigger files are streamed from their fd instead of being cached
+const size_t DEFAULT_STATIC_CACHE_MAX_SIZE = 64 * 1024;
+// Default value of 'gzip_min_length' : smaller bodies are sent as they are (the gzip header and trailer cost 18 bytes)
+const size_t DEFAULT_GZIP_MIN_LENGTH = 256;
+// Default value of 'gzip_comp_level' : higher levels cost several times more CPU for a few % of bytes (make bench)
+const int DEFAULT_GZIP_COMP_LEVEL = 1;
+
 
 /**
  * @class Location
@@ -17,6 +24,8 @@ class Server; // Forward declaration
  * CGI configuration, file upload settings, and error pages.
  * 
  * - **Path Management**: The class allows setting and getting the path that the location block corresponds to.
+ *   A location is used for the paths it is a prefix of, or only for its own path with `location = /path`
+ *   (exact match). The locations of a server are routed by its `LocationTrie`.
  * 
  * - **Method Handling**: It enables the configuration of allowed HTTP methods (e.g., GET, POST) for requests 
  *   to that location.
@@ -25,7 +34,19 @@ class Server; // Forward declaration
  *   for the location. It also allows enabling or disabling automatic directory indexing.
  * 
  * - **CGI and Uploads**: The location can be configured to handle CGI requests and file uploads with custom 
- *   settings for the upload directory and maximum body size.
+ *   settings for the upload directory and maximum body size. With `fastcgi_pass`, the scripts are run by a 
+ *   FastCGI responder listening on a Unix socket instead of a process forked for each request.
+ *   The working directory of the scripts and the part of their environment that does not depend on the request
+ *   are computed once, when the configuration is loaded.
+ * 
+ * - **Static Cache**: With `static_cache on`, the complete responses of the files up to `static_cache_max_size` 
+ *   bytes are kept pre-serialized in memory by each worker (see `StaticResponseCache`). With `gzip_static` / 
+ *   `brotli_static`, a precompressed sibling of the file (`file.css.gz`, `file.css.br`) is served to the clients 
+ *   that accept its encoding.
+ * 
+ * - **Gzip**: With `gzip on`, the responses whose type is in `gzip_types` (text/html is always included) are 
+ *   compressed on the fly at `gzip_comp_level` for the clients that accept gzip : static files, auto-indexes and 
+ *   CGI output. Bodies shorter than `gzip_min_length` are sent as they are.
  * 
  * - **Error Pages**: The class allows defining custom error pages for specific HTTP status codes, allowing 
  *   different error messages or pages to be displayed for different types of errors.
@@ -44,6 +65,9 @@ public:
     void setPath(const std::string &path);
     const std::string &getPath() const;
 
+    void setExactMatch(bool exactMatch);
+    bool isExactMatch() const;
+
     void setAllowedMethods(const std::vector<std::string> &methods);
     const std::vector<std::string> &getAllowedMethods() const;
 
@@ -71,9 +95,41 @@ public:
     void setUploadStore(const std::string &uploadStore);
     const std::string &getUploadStore() const;
 
+    void setFastCgiPass(const std::string &socketPath);
+    const std::string &getFastCgiPass() const;
+
     void setClientMaxBodySize(size_t size);
     size_t getClientMaxBodySize() const;
 
+    void setStaticCache(bool enable);
+    bool getStaticCache() const;
+
+    void setStaticCacheMaxSize(size_t size);
+    size_t getStaticCacheMaxSize() const;
+
+    void setGzipStatic(bool enable);
+    bool getGzipStatic() const;
+
+    void setBrotliStatic(bool enable);
+    bool getBrotliStatic() const;
+
+    void setGzip(bool enable);
+    bool getGzip() const;
+
+    void setGzipTypes(const std::vector<std::string> &types);
+    const std::vector<std::string> &getGzipTypes() const;
+    bool isGzipType(const std::string &contentType) const;
+
+    void setGzipMinLength(size_t length);
+    size_t getGzipMinLength() const;
+
+    void setGzipCompLevel(int level);
+    int getGzipCompLevel() const;
+
+    void compileCgiEnvironment(const std::string &currentDir);
+    const std::string &getCgiWorkingDir() const;
+    const std::vector<std::string> &getCgiEnvironment() const;
+
     bool getRootIsSet() const;
     bool getIndexIsSet() const;
     bool getClientMaxBodySizeIsSet() const;
@@ -104,6 +160,7 @@ private:
 
     // Specific directives (=that can be only found in location context)
     std::string path_;
+    bool exactMatch_;
     std::vector<std::string> allowedMethods_;
     std::string redirection_;
     bool autoIndex_;
@@ -111,6 +168,20 @@ private:
     std::string cgiExtension_;
     bool uploadEnable_;
     std::string uploadStore_;
+    std::string fastCgiPass_;
+    bool staticCache_;
+    size_t staticCacheMaxSize_;
+    bool gzipStatic_;
+    bool brotliStatic_;
+    bool gzip_;
+    std::vector<std::string> gzipTypes_;
+    size_t gzipMinLength_;
+    int gzipCompLevel_;
+
+    // Computed at config load by compileCgiEnvironment() : directory the scripts are run in, and the variables of
+    // their environment that do not depend on the request
+    std::string cgiWorkingDir_;
+    std::vector<std::string> cgiEnvironment_;
 };
 
 #endif // LOCATION_HPP
@@ -0,0 +1,56 @@
+// LocationTrie.hpp
+#ifndef LOCATIONTRIE_HPP
+#define LOCATIONTRIE_HPP
+
+#include <string>
+#include <map>
+
+class Location; // Forward declaration
+
+
+/**
+ * @class LocationTrie
+ *
+ * The `LocationTrie` class routes a request path to the `Location` of a server, compiled once when the
+ * configuration is loaded (see `Server::compileLocations()`).
+ *
+ * - **Radix trie**: The location paths are stored in a trie whose edges are labelled with the longest common
+ *   parts of the paths. A lookup walks the request path once, from the root, whatever the number of locations.
+ *
+ * - **Prefix locations**: The longest location path that is a prefix of the request path is selected, on a
+ *   segment boundary : `/images` is used for `/images` and `/images/logo.png`, not for `/imagesfoo`. A path
+ *   ending with '/' (`/images/`) is a boundary by itself. When two locations have the same path, the first one is kept.
+ *
+ * - **Exact locations**: `location = /path` is only used for a request path equal to `/path`, and is selected
+ *   before any prefix location.
+ */
+class LocationTrie {
+public:
+    LocationTrie();
+    ~LocationTrie();
+
+    void insert(const Location* location);
+    const Location* find(const std::string& path) const;
+    void clear();
+
+private:
+    struct Node {
+        // Part of the path between the parent node and this one
+        std::string label;
+        const Location* prefixLocation;
+        const Location* exactLocation;
+        // Keyed by the first character of the label of the child
+        std::map<char, Node*> children;
+
+        explicit Node(const std::string& nodeLabel) : label(nodeLabel), prefixLocation(NULL), exactLocation(NULL) {}
+    };
+
+    Node* root_;
+
+    static void deleteNode(Node* node);
+
+    LocationTrie(const LocationTrie&);
+    LocationTrie& operator=(const LocationTrie&);
+};
+
+#endif // LOCATIONTRIE_HPP
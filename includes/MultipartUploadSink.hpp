@@ -0,0 +1,66 @@
+// MultipartUploadSink.hpp
+#ifndef MULTIPARTUPLOADSINK_HPP
+#define MULTIPARTUPLOADSINK_HPP
+
+#include <string>
+#include <vector>
+#include "BodySink.hpp"
+
+// Headers of one part (Content-Disposition, Content-Type ...)
+const size_t MAX_PART_HEADERS_LENGTH = 8192;
+
+
+/**
+ * @class MultipartUploadSink
+ *
+ * The `MultipartUploadSink` class parses a `multipart/form-data` body while it is received and writes the 
+ * file parts straight to the upload directory (`upload_store`), so an upload never lives in memory.
+ *
+ * - **Boundary Search**: The delimiter ("\r\n--" + boundary) is searched with Boyer-Moore-Horspool. Only the 
+ *   bytes that could still be the beginning of a delimiter are kept between two calls : the memory used per 
+ *   upload is bounded by one received chunk plus the delimiter length.
+ *
+ * - **Temporary Files**: Each file part is written in a temporary file of the upload directory (mkstemp), 
+ *   renamed to its final name once the part is complete. Temporary files of an interrupted or refused 
+ *   upload are removed.
+ *
+ * - **Form Fields**: Parts without a filename are ignored.
+ */
+class MultipartUploadSink : public BodySink {
+public:
+    MultipartUploadSink(const std::string& uploadDirectory, const std::string& boundary);
+    ~MultipartUploadSink();
+
+    bool write(const char* data, size_t length);
+    bool finish();
+    int getErrorCode() const;
+
+    size_t getSavedFilesCount() const;
+
+private:
+    enum State { PREAMBLE, AFTER_DELIMITER, PART_HEADERS, PART_DATA, EPILOGUE } state_;
+
+    std::string uploadDirectory_;
+    std::string delimiter_;
+    size_t skipTable_[256];
+    std::string buffer_;
+    int errorCode_;
+
+    // Current file part
+    int fileFd_;
+    std::string tempPath_;
+    std::string finalPath_;
+    size_t savedFilesCount_;
+
+    MultipartUploadSink(const MultipartUploadSink&);
+    MultipartUploadSink& operator=(const MultipartUploadSink&);
+
+    size_t findDelimiter(size_t from) const;
+    bool parsePartHeaders(const std::string& headers);
+    bool writePartData(const char* data, size_t length);
+    bool closePart();
+    void discardPart();
+    bool fail(int errorCode);
+};
+
+#endif // MULTIPARTUPLOADSINK_HPP
@@ -0,0 +1,103 @@
+// OpenFileCache.hpp
+#ifndef OPENFILECACHE_HPP
+#define OPENFILECACHE_HPP
+
+#include <string>
+#include <map>
+#include <list>
+#include <ctime>
+#include <sys/types.h>
+
+// Entries not used during this delay (seconds) are closed by expireInactive(), even if the cache is not full
+const time_t OPEN_FILE_CACHE_INACTIVE = 60;
+
+// What is known about a path : the result of its stat() (or its errno), and of its open() for a regular file
+struct OpenFileInfo {
+    int fd;
+    int error;
+    bool isRegular;
+    bool isDirectory;
+    off_t size;
+    time_t mtime;
+    ino_t inode;
+
+    OpenFileInfo() : fd(-1), error(0), isRegular(false), isDirectory(false), size(0), mtime(0), inode(0) {}
+};
+
+
+/**
+ * @class OpenFileCache
+ *
+ * The `OpenFileCache` class keeps the result of the filesystem lookups done for each request (stat, open) so
+ * a hot file or a hot missing path costs no syscall at all. It is owned by the WebServer (one per worker process)
+ * and shared by every RequestHandler and DataSocket of the worker.
+ *
+ * - **Entries**: Keyed by the full path of the file. A regular file keeps its fd (opened O_CLOEXEC), its size,
+ *   mtime and inode. A failed lookup (ENOENT, EACCES ...) is kept too, as a negative entry.
+ *
+ * - **Revalidation**: An entry is trusted for `open_file_cache_valid` seconds, then the path is stat()ed again :
+ *   a file replaced or modified (inode, size or mtime changed) gets a new fd, a missing one a negative entry.
+ *   These delays are measured on the monotonic clock of the TimerWheel, a change of the wall clock does not
+ *   expire every entry at once nor keep them forever.
+ *
+ * - **Eviction**: At most `open_file_cache_max` entries are kept, the least recently used one is dropped first.
+ *   Entries unused for OPEN_FILE_CACHE_INACTIVE seconds are dropped by `expireInactive()`, called by a timer of
+ *   the WebServer at `getNextExpiry()`.
+ *
+ * - **Sharing fds**: The fd given by `open()` is referenced until `release()`, so a DataSocket can stream it while
+ *   the entry is evicted or revalidated : the fd is only closed once its last user is done. Files are only read
+ *   with offsets (sendfile, pread), the shared file position is never used.
+ *
+ * With `open_file_cache_max 0`, nothing is cached : `open()` opens a fd that is the caller's to close.
+ */
+class OpenFileCache {
+public:
+    OpenFileCache(size_t maxEntries, time_t validTime);
+    ~OpenFileCache();
+
+    int lookup(const std::string& path, OpenFileInfo& info);
+    int open(const std::string& path, OpenFileInfo& info);
+    bool release(int fd);
+    void invalidate(const std::string& path);
+    // currentTime : TimerWheel::currentTime()
+    void expireInactive(time_t currentTime);
+    time_t getNextExpiry(time_t currentTime) const;
+
+    size_t getHits() const;
+    size_t getMisses() const;
+
+private:
+    struct Entry {
+        std::string path;
+        OpenFileInfo info;
+        // errno of the open() of a regular file that could be stat()ed, 0 if not tried or successful
+        int openError;
+        time_t validatedTime;
+        time_t lastUsedTime;
+        // Responses still streaming the fd
+        size_t uses;
+        // Dropped from the cache while its fd was in use : deleted by the last release()
+        bool retired;
+        std::list<Entry*>::iterator lruPosition;
+    };
+
+    size_t maxEntries_;
+    time_t validTime_;
+    std::map<std::string, Entry*> entries_;
+    // Most recently used first
+    std::list<Entry*> lru_;
+    // Every fd opened by the cache : entries still cached, and entries dropped while their fd was in use
+    std::map<int, Entry*> fds_;
+    size_t hits_;
+    size_t misses_;
+
+    Entry* getEntry(const std::string& path);
+    bool openEntry(Entry* entry);
+    void removeEntry(Entry* entry);
+    void dropFd(Entry* entry);
+
+    OpenFileCache(const OpenFileCache&);
+    OpenFileCache& operator=(const OpenFileCache&);
+};
+
+#endif // OPENFILECACHE_HPP
@@ -0,0 +1,34 @@
+// PollMultiplexer.hpp
+#ifndef POLLMULTIPLEXER_HPP
+#define POLLMULTIPLEXER_HPP
+
+#include <vector>
+#include <map>
+#include <poll.h>
+#include "EventMultiplexer.hpp"
+
+/**
+ * @class PollMultiplexer
+ *
+ * Fallback backend based on `poll()`. The pollfd array is kept between iterations and only patched on
+ * add / modify / remove (a removed slot is filled with the last entry), so nothing is rebuilt per wakeup.
+ */
+class PollMultiplexer : public EventMultiplexer {
+public:
+    PollMultiplexer();
+    virtual ~PollMultiplexer();
+
+    virtual bool addFd(int fd, unsigned int events);
+    virtual bool modifyFd(int fd, unsigned int events);
+    virtual void removeFd(int fd);
+    virtual int waitEvents(std::vector<IoEvent>& readyEvents, int timeoutMs);
+    virtual const char* getName() const;
+
+private:
+    std::vector<struct pollfd> pollfds_;
+    std::map<int, size_t> indexByFd_;
+
+    static short toPollEvents(unsigned int events);
+};
+
+#endif // POLLMULTIPLEXER_HPP
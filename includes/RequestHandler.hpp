@@ -9,14 +9,29 @@
 #include "HttpRequest.hpp"
 #include "HttpResponse.hpp"
 #include "Server.hpp"
+#include "VirtualHostTable.hpp"
 #include "CgiProcess.hpp"
+#include "OpenFileCache.hpp"
+#include "StaticResponseCache.hpp"
+
+// Max number of ranges of a Range header : a request with more is answered with the whole file
+const size_t MAX_BYTE_RANGES = 16;
+
+// Range of bytes of a file, first and last byte included
+typedef std::pair<off_t, off_t> ByteRange;
 
 struct RequestResult {
     bool responseReady;
     HttpResponse response;
     CgiProcess* cgiProcess;
-
-    RequestResult() : responseReady(false), cgiProcess(NULL) {}
+    // FastCGI : socket of the responder and CGI params ("NAME=value") of the request
+    std::string fastCgiPass;
+    std::vector<std::string> fastCgiParams;
+    // CGI / FastCGI : the gzip of the output is decided once its Content-Type is known
+    const Location* location;
+    bool acceptsGzip;
+
+    RequestResult() : responseReady(false), cgiProcess(NULL), location(NULL), acceptsGzip(false) {}
 };
 
 class HttpException : public std::runtime_error {
@@ -40,9 +55,17 @@ public:
  * 
  * - **Static File Handling**: It manages the serving of static files by generating the full file path, 
  *   verifying the file's security, and ensuring the correct MIME type is set for the response.
+ *   Files are looked up through the `OpenFileCache` of the worker (cached stat and fds), error pages come from 
+ *   the `ErrorPageCache` of the configuration (read once at load time),
+ *   small files of a `static_cache` location are answered from the `StaticResponseCache`. In a `gzip on` 
+ *   location, the responses to compress on the fly are marked for the DataSocket (`prepareGzip`).
+ *   Files are sent with validators (weak ETag, Last-Modified) : a conditional GET of an unchanged file is 
+ *   answered with a 304 before the file is opened. Range requests get slices of the file (206, one range or 
+ *   multipart/byteranges), streamed from its fd like a whole file.
  * 
  * - **CGI Process Management**: The class is capable of handling dynamic content via CGI by setting up 
- *   the necessary environment variables, creating the appropriate parameters, and starting the CGI process.
+ *   the necessary environment variables, creating the appropriate parameters, and starting the CGI process. 
+ *   In a `fastcgi_pass` location, the same variables are given as FastCGI params to the responder instead.
  * 
  * - **File Upload and Deletion**: It handles HTTP POST requests for file uploads and DELETE requests for 
  *   file deletions, managing file locations and ensuring appropriate permissions and size limits.
@@ -55,19 +78,39 @@ public:
  */
 class RequestHandler {
 public:
-    RequestHandler(const Config& config, const std::vector<Server*>& associatedServers);
+    RequestHandler(const Config& config, const VirtualHostTable& virtualHosts, const std::string& remoteAddress,
+                   OpenFileCache* openFileCache, StaticResponseCache* staticResponseCache);
     ~RequestHandler();
 
     RequestResult handleRequest(const HttpRequest& request);
+    bool prepareRequestBody(HttpRequest& request) const;
+    static void prepareGzip(const Location* location, bool acceptsGzip, HttpResponse& response, long bodyLength);
 
 private:
     const Server* selectServer(const HttpRequest& request) const;
     const Location* selectLocation(const Server* server, const HttpRequest& request) const;
+    size_t getClientMaxBodySize(const Server* server, const Location* location) const;
 
     void process(const Server* server, const Location* location, const HttpRequest& request, RequestResult& result) const;
 
     HttpResponse serveStaticFile(const Server* server, const Location* location, const HttpRequest& request) const;
+    bool isStaticCacheable(const Location* location, const OpenFileInfo& fileInfo) const;
+    void cacheStaticResponse(const std::string& fileFullPath, const OpenFileInfo& fileInfo, HttpResponse& response) const;
+    void setContentType(HttpResponse& response, const std::string& fileFullPath) const;
+    std::string makeETag(const OpenFileInfo& fileInfo) const;
+    bool isNotModified(const HttpRequest& request, const OpenFileInfo& fileInfo, const std::string& etag) const;
+    int evaluateRange(const HttpRequest& request, const OpenFileInfo& fileInfo, const std::string& etag,
+                      std::vector<ByteRange>& ranges) const;
+    bool parseByteRange(const std::string& spec, off_t size, std::vector<ByteRange>& ranges) const;
+    void setRangeBody(HttpResponse& response, const OpenFileInfo& fileInfo, std::vector<ByteRange>& ranges) const;
+    std::string selectPrecompressedFile(const Location* location, const HttpRequest& request, const std::string& fileFullPath,
+                                        OpenFileInfo& fileInfo, std::string& contentEncoding) const;
+    bool usePrecompressedFile(const std::string& precompressedPath, OpenFileInfo& fileInfo) const;
     HttpResponse handleFileUpload(const HttpRequest& request, const Location* location, const Server* server) const;
+    bool isUploadRequest(const Location* location, const HttpRequest& request) const;
+    bool isFastCgiRequest(const Location* location, const HttpRequest& request) const;
+    bool isCgiRequest(const Location* location, const HttpRequest& request) const;
+    std::string getUploadBoundary(const HttpRequest& request) const;
     HttpResponse handleDeletion(const HttpRequest& request, const Location* location, const Server* server) const;
     
     std::string getFileFullPath(const Server* server, const Location* location, const HttpRequest& request) const;
@@ -78,11 +121,12 @@ private:
     HttpResponse generateAutoIndex(const std::string& fullPath, const std::string& requestPath) const;
     std::string getMimeType(const std::string& extension) const;
     // HttpResponse handleError(int statusCode, const Server* server) const;
+    HttpResponse handleError(int statusCode, const std::string& errorPagePath) const;
 
-    CgiProcess* startCgiProcess(const Server* server, const Location* location, const HttpRequest& request) const;
+    CgiProcess* startCgiProcess(const Location* location, const HttpRequest& request) const;
     void setupScriptEnvp(const HttpRequest& request, const std::string& relativeFilePath,  std::vector<std::string>& envVars) const;
     std::map<std::string, std::string> createScriptParamsGET(const std::string& queryString) const;
-    std::map<std::string, std::string> createScriptParamsPOST(const std::string& postData) const;
+    void setupFastCgiParams(const HttpRequest& request, const Location* location, const std::string& fileFullPath, std::vector<std::string>& params) const;
 
     //err management
     std::string getErrorPageFullPath(int statusCode, const Location* location, const Server* server) const;
@@ -91,7 +135,11 @@ private:
 
 
     const Config& config_;
-    const std::vector<Server*>& associatedServers_;
+    const VirtualHostTable& virtualHosts_;
+    // Address of the client (REMOTE_ADDR of the CGI)
+    const std::string& remoteAddress_;
+    OpenFileCache* openFileCache_;
+    StaticResponseCache* staticResponseCache_;
 };
 
 #endif // REQUESTHANDLER_HPP
@@ -6,12 +6,17 @@
 #include <vector>
 #include <map>
 #include <netinet/in.h> // Pour les types réseau
+#include <sys/socket.h>
 #include "Location.hpp"
 #include "Config.hpp"
+#include "LocationTrie.hpp"
 
 class Config;   // Forward declaration
 class Location; // Forward declaration
 
+// Length of the accept queue of a listening socket without 'listen ... backlog=N' (capped by net.core.somaxconn)
+const int DEFAULT_LISTEN_BACKLOG = SOMAXCONN;
+
 
 /**
  * @class Server
@@ -23,6 +28,7 @@ class Location; // Forward declaration
  * 
  * The `Server` class is designed to allow easy access to and modification of server-related configuration settings. It can handle 
  * multiple server names, locations, and error pages, providing a complete configuration for a single server instance.
+ * Once the configuration is parsed, its locations are compiled into a `LocationTrie` that routes the requests.
  */
 class Server
 {
@@ -41,6 +47,10 @@ public:
     uint16_t getPort() const; // Nouvelle méthode pour obtenir le port
     void setHost(uint32_t host); // Setter pour host_
     void setPort(uint16_t port); // Setter pour port_
+    void setDefaultServer(bool defaultServer);
+    bool isDefaultServer() const; // 'listen ... default_server' : used for the hosts without server on its IP:PORT
+    void setListenBacklog(int backlog);
+    int getListenBacklog() const; // 'listen ... backlog=N', 0 if not set
     const std::vector<std::string> &getServerNames() const;
     const std::string &getRoot() const;
     const std::string &getIndex() const;
@@ -53,6 +63,8 @@ public:
 
     void addLocation(const Location &location);
     const std::vector<Location> &getLocations() const;
+    void compileLocations();
+    const Location* findLocation(const std::string &path) const;
 
     // DEBUG
     void displayServer() const;
@@ -74,8 +86,12 @@ private:
     // Directives spécifiques au serveur
     uint32_t host_; // Adresse IP en ordre réseau
     uint16_t port_; // Numéro de port en ordre réseau
+    bool defaultServer_;
+    int listenBacklog_;
     std::vector<std::string> serverNames_;
     std::vector<Location> locations_;
+    // Built from locations_ by compileLocations(), which must not change afterwards
+    LocationTrie locationTrie_;
 };
 
 #endif // SERVER_HPP
@@ -0,0 +1,37 @@
+// SharedBuffer.hpp
+#ifndef SHAREDBUFFER_HPP
+#define SHAREDBUFFER_HPP
+
+#include <string>
+#include <cstddef>
+
+
+/**
+ * @class SharedBuffer
+ *
+ * The `SharedBuffer` class is an immutable block of bytes shared by reference : a pre-serialized response of the
+ * `StaticResponseCache` is given to every DataSocket that sends it, nothing is copied.
+ *
+ * It is created with one reference (the creator's). Each holder calls `retain()` when it keeps a pointer
+ * and `release()` when it is done, the buffer deletes itself with its last reference.
+ */
+class SharedBuffer {
+public:
+    explicit SharedBuffer(std::string& data);
+
+    void retain();
+    void release();
+
+    const char* data() const;
+    size_t size() const;
+
+private:
+    std::string data_;
+    size_t references_;
+
+    ~SharedBuffer();
+    SharedBuffer(const SharedBuffer&);
+    SharedBuffer& operator=(const SharedBuffer&);
+};
+
+#endif // SHAREDBUFFER_HPP
@@ -0,0 +1,68 @@
+// StaticResponseCache.hpp
+#ifndef STATICRESPONSECACHE_HPP
+#define STATICRESPONSECACHE_HPP
+
+#include <string>
+#include <map>
+#include <list>
+#include <ctime>
+#include <sys/types.h>
+#include "SharedBuffer.hpp"
+#include "OpenFileCache.hpp"
+
+
+/**
+ * @class StaticResponseCache
+ *
+ * The `StaticResponseCache` class keeps the complete 200 response (status line, headers and body) of the small
+ * static files served from a `static_cache on` location. It is owned by the WebServer (one per worker process).
+ *
+ * - **Entries**: Keyed by the full path of the file. The response is serialized once in a `SharedBuffer`, without
+ *   its Connection header : the DataSocket sends the header block, its own Connection header, then the body, in one
+ *   writev() and without copying the buffer.
+ *
+ * - **Invalidation**: An entry is only used while the file has the size, mtime and inode it was read with (as known
+ *   by the `OpenFileCache`, so a hit costs no syscall). A modified file is read and serialized again.
+ *
+ * - **Budget**: The buffers use at most `static_cache_size` bytes, the least recently used entries are dropped first.
+ *   A dropped buffer stays alive while a DataSocket still sends it.
+ */
+class StaticResponseCache {
+public:
+    StaticResponseCache(size_t maxBytes);
+    ~StaticResponseCache();
+
+    SharedBuffer* find(const std::string& path, const OpenFileInfo& info, size_t& headerLength);
+    void insert(const std::string& path, const OpenFileInfo& info, SharedBuffer* response, size_t headerLength);
+
+    size_t getHits() const;
+    size_t getMisses() const;
+    size_t getUsedBytes() const;
+
+private:
+    struct Entry {
+        std::string path;
+        off_t size;
+        time_t mtime;
+        ino_t inode;
+        SharedBuffer* response;
+        // Status line and headers, without the empty line that ends them
+        size_t headerLength;
+        std::list<Entry*>::iterator lruPosition;
+    };
+
+    size_t maxBytes_;
+    size_t usedBytes_;
+    std::map<std::string, Entry*> entries_;
+    // Most recently used first
+    std::list<Entry*> lru_;
+    size_t hits_;
+    size_t misses_;
+
+    void removeEntry(Entry* entry);
+
+    StaticResponseCache(const StaticResponseCache&);
+    StaticResponseCache& operator=(const StaticResponseCache&);
+};
+
+#endif // STATICRESPONSECACHE_HPP
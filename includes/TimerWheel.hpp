@@ -0,0 +1,111 @@
+// TimerWheel.hpp
+#ifndef TIMERWHEEL_HPP
+#define TIMERWHEEL_HPP
+
+#include <cstddef>
+#include <ctime>
+
+class DataSocket; // Forward declaration
+class FastCgiConnection; // Forward declaration
+class TimerWheel;
+
+// Resolution of the wheel in milliseconds : a deadline fires at most one tick late
+const long long TIMER_WHEEL_TICK_MS = 100;
+// Slots of the two levels : ticks of the next 25.6 s in the first one, the next 27 min in the second one
+const size_t TIMER_WHEEL_LEVEL0_SLOTS = 256;
+const size_t TIMER_WHEEL_LEVEL1_SLOTS = 64;
+
+// What a timer is for (its expiration is handled differently in function of it)
+enum TimerType {
+    TIMER_INACTIVITY,
+    TIMER_CGI_EXECUTION,
+    TIMER_ACCEPT_RESUME,
+    TIMER_CACHE_STATS,
+    TIMER_FASTCGI,
+    TIMER_FASTCGI_RETRY,
+    TIMER_OPEN_FILE_CACHE
+};
+
+
+/**
+ * @class Timer
+ *
+ * A deadline registered in a `TimerWheel`, linked in the slot of its tick (no allocation). The WebServer keeps
+ * the timers of a DataSocket with its multiplexer registrations, a FastCgiConnection holds its own : a timer is
+ * cancelled when it is destroyed. A copy is not scheduled.
+ */
+class Timer {
+public:
+    TimerType type;
+    DataSocket* dataSocket;
+    FastCgiConnection* fastCgiConnection;
+
+    Timer();
+    Timer(const Timer& other);
+    Timer& operator=(const Timer& other);
+    ~Timer();
+
+    bool isScheduled() const;
+    long long getDeadline() const;
+
+private:
+    friend class TimerWheel;
+
+    long long deadline_;
+    // Wheel the timer is scheduled in, NULL if not scheduled
+    TimerWheel* wheel_;
+    Timer* previous_;
+    Timer* next_;
+    // Head of the list the timer is linked in
+    Timer** slot_;
+};
+
+
+/**
+ * @class TimerWheel
+ *
+ * The `TimerWheel` class owns the deadlines of the event loop (inactivity of the connections, execution time of
+ * the CGI processes, timeouts of the FastCGI connections, expiry of the open file cache) : the loop sleeps until
+ * the nearest one instead of scanning every connection periodically.
+ *
+ * - **Hierarchical wheel**: A deadline is put in the slot of its tick (TIMER_WHEEL_TICK_MS) in the first level if
+ *   it is less than TIMER_WHEEL_LEVEL0_SLOTS ticks away, else in the slot of its group of ticks in the second
+ *   level. The slots of the second level are spread in the first one when the wheel reaches them, farther
+ *   deadlines wait in the last slot of the second level.
+ *
+ * - **Cost**: Scheduling, rescheduling and cancelling a timer are O(1) (doubly linked lists), expiring them costs
+ *   O(1) for each timer and each tick elapsed, whatever the number of connections.
+ *
+ * - **Lazy deadlines**: The owner of a timer does not have to move it for every activity : it is checked once it
+ *   expires, and scheduled again at the new deadline if it is not over.
+ */
+class TimerWheel {
+public:
+    explicit TimerWheel(long long currentTimeMs);
+    ~TimerWheel();
+
+    void schedule(Timer* timer, long long deadlineMs);
+    void cancel(Timer* timer);
+    Timer* popExpired(long long currentTimeMs);
+    int getTimeout(long long currentTimeMs, int maxTimeoutMs) const;
+    size_t size() const;
+
+    static long long currentTimeMs();
+    static time_t currentTime();
+
+private:
+    Timer* level0_[TIMER_WHEEL_LEVEL0_SLOTS];
+    Timer* level1_[TIMER_WHEEL_LEVEL1_SLOTS];
+    // Next tick to expire : every tick before it has been handled
+    long long currentTick_;
+    size_t count_;
+
+    void place(Timer* timer);
+    void link(Timer* timer, Timer** slot);
+    void cascade();
+
+    TimerWheel(const TimerWheel&);
+    TimerWheel& operator=(const TimerWheel&);
+};
+
+#endif // TIMERWHEEL_HPP
@@ -5,6 +5,7 @@
 #include <string>
 #include <sstream>
 #include <fstream>
+#include <ctime>
 
 // Fonction d'aide pour convertir des entiers en chaînes de caractères
 std::string toString(int value);
@@ -13,5 +14,9 @@ std::string toString(long value);
 
 bool endsWith(const std::string& fullString, const std::string& ending);
 void decodeURI(std::string &toDecode);
+bool readFileContent(int fd, size_t length, std::string &content);
+std::string formatHttpDate(time_t time);
+bool parseHttpDate(const std::string &value, time_t &time);
+bool isRetryableIoError(int error);
 
 #endif // UTILS_HPP
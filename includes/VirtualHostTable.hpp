@@ -0,0 +1,75 @@
+// VirtualHostTable.hpp
+#ifndef VIRTUALHOSTTABLE_HPP
+#define VIRTUALHOSTTABLE_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+class Server; // Forward declaration
+
+
+/**
+ * @class VirtualHostTable
+ *
+ * The `VirtualHostTable` class selects the server of a request from its Host header, among the servers of one
+ * `ListeningSocket` (IP:PORT). It is filled when the listening sockets are initialized, then only read.
+ *
+ * - **Exact names**: The server names are kept lowercase in an open addressing hash table : a lookup costs the
+ *   hash of the host whatever the number of virtual hosts. The Host header is normalized first (lowercase,
+ *   without `:port` nor trailing dot).
+ *
+ * - **Wildcard names**: `*.example.com` matches the hosts ending with `.example.com`, `www.example.*` the hosts
+ *   starting with `www.example.`. They are stored in hash tables of their fixed part : the suffixes (then the
+ *   prefixes) of the host that end on a label boundary are looked up from the longest, so the most specific
+ *   wildcard is selected. Priority : exact name, leading wildcard, trailing wildcard.
+ *
+ * - **Default server**: Used when no name matches : the server whose `listen` has `default_server`, else the
+ *   first server of the IP:PORT. When several servers have the same name, the first one is kept.
+ */
+class VirtualHostTable {
+public:
+    VirtualHostTable();
+
+    void addServer(Server* server);
+    const Server* findServer(const std::string& hostHeader) const;
+    const Server* getDefaultServer() const;
+    size_t size() const;
+
+    static std::string normalizeHost(const std::string& hostHeader);
+
+private:
+    // Open addressing hash table (linear probing) of names to servers, at most half full
+    class NameTable {
+    public:
+        NameTable();
+
+        void insert(const std::string& name, Server* server);
+        Server* find(const char* name, size_t length) const;
+        size_t size() const;
+
+    private:
+        struct Slot {
+            std::string name;
+            Server* server;
+
+            Slot() : name(), server(NULL) {}
+        };
+
+        std::vector<Slot> slots_;
+        size_t count_;
+
+        static size_t hash(const char* name, size_t length);
+        void grow();
+    };
+
+    NameTable exactNames_;
+    // "*.example.com" stored as "example.com"
+    NameTable leadingWildcards_;
+    // "www.example.*" stored as "www.example"
+    NameTable trailingWildcards_;
+    Server* defaultServer_;
+    Server* firstServer_;
+};
+
+#endif // VIRTUALHOSTTABLE_HPP
@@ -4,9 +4,15 @@
 #include <vector>
 #include <string>
 #include <map>
-#include <poll.h> 
+#include <set>
+#include "EventMultiplexer.hpp"
 #include "ListeningSocketHandler.hpp"
 #include "DataSocketHandler.hpp"
+#include "FastCgiPool.hpp"
+#include "OpenFileCache.hpp"
+#include "StaticResponseCache.hpp"
+#include "TimerWheel.hpp"
+#include "ChildReaper.hpp"
 #include "Config.hpp"
 #include "ConfigParser.hpp"
 #include "Color_Macros.hpp"
@@ -18,23 +24,101 @@
  * The `WebServer` class represents the main server that handles client requests, manages incoming connections, 
  * and processes CGI (Common Gateway Interface) requests. It is responsible for configuring the server, 
  * running the event loop, and managing both the listening sockets and data sockets. It also handles 
- * timeouts for both the client connections and CGI processes.
+ * timeouts for both the client connections and CGI processes : their deadlines are kept in a `TimerWheel`, and
+ * the event loop waits for events until the nearest one.
  * 
  * This class integrates the server's functionality, from reading the configuration file to running the 
  * server event loop, and ensures smooth multiplexing of client requests and timeouts.
+ * 
+ * It also owns the FastCGI pools (`fastcgi_pass`) : their connections are watched by the same event loop
+ * as the client sockets and the CGI pipes.
+ * 
+ * The caches of the worker are owned here too : the `OpenFileCache` (stat / open results of the files served) and
+ * the `StaticResponseCache` (pre-serialized responses of the small static files). Their hits and misses are logged
+ * every CACHE_STATS_INTERVAL_MS while they are used.
+ * 
+ * Admission control : once `max_connections` connections are open, the listening sockets are unwatched until one
+ * closes (the new connections wait in their backlog). When the process has no fd left, a spare fd is released to
+ * accept the pending connections and refuse them (503), then the listening sockets are unwatched for
+ * ACCEPT_PAUSE_MS : the loop never spins on a listener it can't serve. With `max_connections_per_ip`, the
+ * connections of a client address over the limit are refused the same way.
  */
 
-// Time to close inactive DataSockets in seconds
-const time_t SOCKET_INACTIVITY_TIMEOUT = 45; 
 const time_t MULTIPLEXING_LOOP_TIME = 45; 
 
-class WebServer {
+// Type of the fds watched by the event loop (events are treated differently in function of the fd)
+enum WatchedFdType {
+    FD_LISTENING_SOCKET,
+    FD_DATA_SOCKET,
+    FD_CGI_PIPE,
+    FD_CGI_INPUT,
+    FD_CHILD_EXIT,
+    FD_FASTCGI
+};
+
+struct WatchedFd {
+    WatchedFdType type;
+    ListeningSocket* listeningSocket;
+    DataSocket* dataSocket;
+    FastCgiConnection* fastCgiConnection;
+};
+
+// Longest wait for events (ms)
+const int EVENT_LOOP_MAX_TIMEOUT_MS = 5000;
+// Queued FastCGI requests refused by a full backlog of the responder are dispatched again after this delay
+const int FASTCGI_RETRY_INTERVAL_MS = 1000;
+// Listening sockets unwatched after running out of fds, unless a connection closes before
+const int ACCEPT_PAUSE_MS = 500;
+// Hits / misses of the caches logged at most this often (only if there were lookups since the last report)
+const int CACHE_STATS_INTERVAL_MS = 60000;
+
+// What is currently registered in the multiplexer and in the timer wheel for a DataSocket
+struct DataSocketWatch {
+    int clientFd;
+    unsigned int clientEvents;
+    int cgiPipeFd;
+    int cgiInputFd;
+    Timer inactivityTimer;
+    Timer cgiTimer;
+};
+
+class WebServer : public CgiPipeWatcher {
 private:
     ListeningSocketHandler listeningHandler_;
     DataSocketHandler dataHandler_;           
-    std::vector<DataSocket*> activeCgiSockets_;
     Config* config_;                         
 
+    // Multiplexing
+    EventMultiplexer* multiplexer_;
+    std::map<int, WatchedFd> watchedFds_;
+    std::map<DataSocket*, DataSocketWatch> dataSocketWatches_;
+    std::set<int> staleFds_;
+    // Deadlines of the DataSockets (inactivity, CGI execution time), of the FastCGI connections and of the caches :
+    // the loop waits for events until the nearest one
+    TimerWheel timerWheel_;
+    // End of the CGI processes : SIGCHLD self-pipe watched by the loop, and the DataSocket of each running CGI
+    ChildReaper childReaper_;
+    std::map<pid_t, DataSocket*> cgiProcesses_;
+
+    // Admission control : listening sockets unwatched while saturated, fd kept in reserve for the connections
+    // refused when no fd is left, open connections of each client address (max_connections_per_ip)
+    bool listenersPaused_;
+    Timer acceptResumeTimer_;
+    int spareFd_;
+    std::map<std::string, size_t> connectionsPerIp_;
+
+    // FastCGI : one pool of connections for each fastcgi_pass socket, and the events registered for each connection
+    std::map<std::string, FastCgiPool*> fastCgiPools_;
+    std::map<FastCgiConnection*, unsigned int> fastCgiWatches_;
+    Timer fastCgiRetryTimer_;
+
+    // stat / open results and pre-serialized static responses shared by the requests of this worker
+    OpenFileCache* openFileCache_;
+    StaticResponseCache* staticResponseCache_;
+    Timer cacheStatsTimer_;
+    Timer openFileCacheTimer_;
+    size_t reportedCacheLookups_;
+
 public:
     WebServer();
     ~WebServer();
@@ -42,12 +126,46 @@ public:
     // Prepare Webserver
     void loadConfiguration(const std::string& configFile);
     void start();
+    const Config* getConfig() const;
     
     // Running WebServer Loop
     void runEventLoop(); 
-    void setupPollfds(std::vector<struct pollfd> &pollfds, std::vector<ListeningSocket*> &pollListeningSockets, std::vector<DataSocket*> &pollDataSockets, std::vector<int> &pollFdTypes);
-    void checkCgiTimeouts(); 
-    void checkDataSocketTimeouts(); 
+    void handleListeningSocketEvent(ListeningSocket* listeningSocket, unsigned int events);
+    bool admitConnection(DataSocket* dataSocket);
+    void refuseConnection(int fd);
+    void shedConnections(ListeningSocket* listeningSocket);
+    void pauseListeners(int resumeAfterMs);
+    void resumeListeners();
+    void logCacheStats();
+    void handleDataSocketEvent(DataSocket* dataSocket, unsigned int events);
+    void processReadyRequest(DataSocket* dataSocket);
+    void handleCgiPipeEvent(DataSocket* dataSocket, unsigned int events);
+    void handleCgiInputEvent(DataSocket* dataSocket, unsigned int events);
+    void handleChildExitEvent();
+    void checkTimers();
+    void handleInactivityTimer(Timer* timer, time_t currentTime);
+    void handleCgiTimer(Timer* timer, time_t currentTime);
+    void handleFastCgiTimer(Timer* timer, time_t currentTime);
+    void handleOpenFileCacheTimer(Timer* timer, time_t currentTime);
+    int getEventTimeout() const;
+
+    // Registrations in the multiplexer
+    void watchFd(int fd, unsigned int events, WatchedFdType type, ListeningSocket* listeningSocket, DataSocket* dataSocket);
+    void unwatchFd(int fd);
+    void watchDataSocket(DataSocket* dataSocket);
+    void syncDataSocketWatch(DataSocket* dataSocket);
+    void syncPipeWatch(int& watchedFd, int fd, unsigned int events, WatchedFdType type, DataSocket* dataSocket);
+    void unwatchCgiPipe(DataSocket* dataSocket, int fd);
+    void cancelFastCgiRequest(DataSocket* dataSocket);
+    void closeDataSocket(DataSocket* dataSocket);
+
+    // FastCGI pools
+    FastCgiPool* getFastCgiPool(const std::string& socketPath);
+    void submitFastCgiRequest(DataSocket* dataSocket);
+    void dispatchFastCgiRequests(FastCgiPool* pool);
+    void handleFastCgiEvent(FastCgiConnection* connection, unsigned int events);
+    void syncFastCgiWatch(FastCgiPool* pool, FastCgiConnection* connection);
+    void closeFastCgiConnection(FastCgiPool* pool, FastCgiConnection* connection, int errorCode);
 
     // Close exit Webserver
     void cleanUp(); 
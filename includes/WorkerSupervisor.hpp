@@ -0,0 +1,54 @@
+// WorkerSupervisor.hpp
+#ifndef WORKERSUPERVISOR_HPP
+#define WORKERSUPERVISOR_HPP
+
+#include <vector>
+#include <ctime>
+#include <csignal>
+#include <sys/types.h>
+#include "WebServer.hpp"
+
+// A worker that dies before this delay (seconds) is considered as a startup failure
+const time_t WORKER_MIN_LIFETIME = 2;
+// Consecutive startup failures before the supervisor gives up
+const int WORKER_MAX_FAST_FAILURES = 5;
+
+
+/**
+ * @class WorkerSupervisor
+ *
+ * The `WorkerSupervisor` class runs the web server on several cores (`workers N;` directive).
+ * The configuration is loaded once by the supervisor, then N worker processes are forked : each one
+ * inherits the same `Config` tree, binds its own ListeningSockets with SO_REUSEPORT and runs its own
+ * independent event loop. The kernel balances new connections between the workers.
+ *
+ * - **Supervision**: A worker that dies while the server is running is restarted. If workers keep dying
+ *   right after their start (e.g. bind failure), the supervisor stops instead of looping forever.
+ *
+ * - **Shutdown**: SIGINT / SIGTERM received by the supervisor are forwarded to every worker, then the
+ *   supervisor waits for all of them before exiting. SIGINT, SIGTERM and SIGCHLD are blocked in the supervisor
+ *   and only delivered inside `sigsuspend()` : a signal received while it checks `g_running` is never missed.
+ */
+class WorkerSupervisor {
+public:
+    WorkerSupervisor(WebServer& webServer, size_t workersCount);
+    ~WorkerSupervisor();
+
+    int run();
+
+private:
+    WebServer& webServer_;
+    std::vector<pid_t> workers_;
+    std::vector<time_t> workersStartTime_;
+    // Signal mask before the supervisor blocked its signals : used by sigsuspend(), given back to the workers
+    sigset_t waitMask_;
+
+    void blockSignals();
+    void restoreSignals();
+    bool spawnWorker(size_t index);
+    int runWorker();
+    void stopWorkers(int signum);
+    int findWorker(pid_t pid) const;
+};
+
+#endif // WORKERSUPERVISOR_HPP
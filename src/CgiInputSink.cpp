@@ -0,0 +1,21 @@
+// CgiInputSink.cpp
+#include "CgiInputSink.hpp"
+#include "DataSocket.hpp"
+
+CgiInputSink::CgiInputSink(DataSocket& dataSocket) : dataSocket_(dataSocket) {}
+
+// Queued for the CGI stdin (dropped if the CGI closed it) : never fails
+bool CgiInputSink::write(const char* data, size_t length) {
+    dataSocket_.appendCgiInput(data, length);
+    return true;
+}
+
+// The CGI stdin is closed once the queued bytes are written, so the script reads EOF
+bool CgiInputSink::finish() {
+    dataSocket_.finishCgiInput();
+    return true;
+}
+
+int CgiInputSink::getErrorCode() const {
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include "CgiProcess.hpp"
+#include "TimerWheel.hpp"
 #include "Color_Macros.hpp"
 #include <unistd.h>
 #include <fcntl.h>
@@ -7,19 +8,26 @@
 #include <cstdlib> // Pour _exit()
 #include <errno.h>
 #include <cstring> // Pour strerror()
+#include <csignal>
+#ifdef CGI_USE_POSIX_SPAWN
+# include <spawn.h>
+#endif
 
 CgiProcess::CgiProcess(const std::string& scriptWorkingDir, const std::string& relativeFilePath,
                        const std::map<std::string, std::string>& scriptParams,
-                       const std::vector<std::string>& envVars)
+                       const std::vector<std::string>& baseEnvVars, const std::vector<std::string>& envVars)
     : pid_(-1), 
     scriptWorkingDir_(scriptWorkingDir), 
     relativeFilePath_(relativeFilePath), 
     maxExecutionTime_(11),
+    exited_(false),
     cgiExitStatus_(0)
 {
+    std::memset(&usage_, 0, sizeof(usage_));
     createArgv(scriptParams);
-    createEnvp(envVars);
+    createEnvp(baseEnvVars, envVars);
     pipefd_[0] = pipefd_[1] = -1;
+    inputPipefd_[0] = inputPipefd_[1] = -1;
 }
 
 CgiProcess::~CgiProcess() {
@@ -27,14 +35,19 @@ CgiProcess::~CgiProcess() {
     cleanupEnvp();
     if (pipefd_[0] != -1) close(pipefd_[0]);
     if (pipefd_[1] != -1) close(pipefd_[1]);
-    if (pid_ > 0) waitpid(pid_, &cgiExitStatus_, WNOHANG);
+    if (inputPipefd_[0] != -1) close(inputPipefd_[0]);
+    if (inputPipefd_[1] != -1) close(inputPipefd_[1]);
 }
 
 
 /**
- * Starts the CGI process by creating a pipe, forking a child process, and executing the script.
- * The function sets up the necessary pipe for communication and executes the script (e.g., a Python script).
- * If any step fails (e.g., pipe creation, fork, changing the working directory, or executing the script), the function returns false.
+ * Starts the CGI process by creating the pipes and launching the script (e.g., a Python script) in a child process :
+ * the script writes its output on the stdout pipe and reads the request body on its stdin pipe. Both server ends 
+ * are non-blocking and watched by the event loop. Every end is close-on-exec : the script only keeps its stdin and
+ * stdout, and the other CGIs inherit none of them.
+ * The child is created with posix_spawn() (no copy of the page tables of the worker, whatever its memory and caches),
+ * or fork() without a recent enough glibc.
+ * If any step fails (e.g., pipe creation, spawn, changing the working directory, or executing the script), the function returns false.
  * 
  * @return true if the CGI process is successfully started, false otherwise.
  */
@@ -44,17 +57,97 @@ bool CgiProcess::start() {
     //Simulate an error of pipe/fork/fcntl here to make err 500 happen
     // return false; //remove this to make the function works normally
 
-    if (pipe(pipefd_) == -1) {
+    if (pipe(pipefd_) == -1 || pipe(inputPipefd_) == -1) {
         std::cerr << "Error : CGI pipe failed: " << strerror(errno) << std::endl;
         return false;
     }
 
-    // Make reading descriptor non-blocking
-    if (fcntl(pipefd_[0], F_SETFL, O_NONBLOCK) == -1) {
+    // Make reading descriptor (stdout) and writing descriptor (stdin) non-blocking
+    if (fcntl(pipefd_[0], F_SETFL, O_NONBLOCK) == -1 || fcntl(inputPipefd_[1], F_SETFL, O_NONBLOCK) == -1) {
         std::cerr << "Error : CGI fcntl pipe failed: " << strerror(errno) << std::endl;
         return false;
     }
+    // The copies made on the stdin / stdout of the child are not close-on-exec
+    for (int i = 0; i < 2; ++i) {
+        if (fcntl(pipefd_[i], F_SETFD, FD_CLOEXEC) == -1 || fcntl(inputPipefd_[i], F_SETFD, FD_CLOEXEC) == -1) {
+            std::cerr << "Error : CGI fcntl pipe failed: " << strerror(errno) << std::endl;
+            return false;
+        }
+    }
+
+#ifdef CGI_USE_POSIX_SPAWN
+    if (!spawn()) {
+        return false;
+    }
+#else
+    if (!forkAndExec()) {
+        return false;
+    }
+#endif
+
+    // Parent process
+    close(pipefd_[1]);
+    pipefd_[1] = -1;
+    close(inputPipefd_[0]);
+    inputPipefd_[0] = -1;
+    // Used to monitor the time of the process (Inactive process = timeout)
+    startTime_ = TimerWheel::currentTime();
+    return true;
+}
 
+#ifdef CGI_USE_POSIX_SPAWN
+/**
+ * Launches the script with posix_spawn() : the child shares the memory of the worker until it executes the
+ * interpreter (vfork semantics), its pipes, working directory and signals are set up by the spawn attributes.
+ * A failure of chdir or execve is reported here, not by the exit status of the child.
+ */
+bool CgiProcess::spawn() {
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attributes;
+    if (posix_spawn_file_actions_init(&actions) != 0) {
+        std::cerr << "Error : CGI spawn failed: file actions" << std::endl;
+        return false;
+    }
+    if (posix_spawnattr_init(&attributes) != 0) {
+        posix_spawn_file_actions_destroy(&actions);
+        std::cerr << "Error : CGI spawn failed: attributes" << std::endl;
+        return false;
+    }
+
+    // SIGPIPE is ignored by webserv : the script gets the default behaviour back
+    sigset_t defaultSignals;
+    sigemptyset(&defaultSignals);
+    sigaddset(&defaultSignals, SIGPIPE);
+    int error = posix_spawnattr_setsigdefault(&attributes, &defaultSignals);
+    if (error == 0) {
+        error = posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGDEF);
+    }
+    if (error == 0) {
+        error = posix_spawn_file_actions_adddup2(&actions, pipefd_[1], STDOUT_FILENO);
+    }
+    if (error == 0) {
+        error = posix_spawn_file_actions_adddup2(&actions, inputPipefd_[0], STDIN_FILENO);
+    }
+    // change working dir to 'scriptWorkingDir_'
+    if (error == 0) {
+        error = posix_spawn_file_actions_addchdir_np(&actions, scriptWorkingDir_.c_str());
+    }
+    // Exec script with python and args
+    if (error == 0) {
+        error = posix_spawn(&pid_, args_[0], &actions, &attributes, &args_[0], &envp_[0]);
+    }
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributes);
+    if (error != 0) {
+        pid_ = -1;
+        std::cerr << "Error : CGI spawn failed: " << strerror(error) << std::endl;
+        return false;
+    }
+    return true;
+}
+#else
+// Launches the script in a forked child (no posix_spawn_file_actions_addchdir_np)
+bool CgiProcess::forkAndExec() {
     pid_ = fork();
     if (pid_ == -1) {
         std::cerr << "Error : CGI fork failed: " << strerror(errno) << std::endl;
@@ -63,9 +156,9 @@ bool CgiProcess::start() {
 
     if (pid_ == 0) {
         // Child process
-        close(pipefd_[0]);
         dup2(pipefd_[1], STDOUT_FILENO);
-        close(pipefd_[1]);
+        dup2(inputPipefd_[0], STDIN_FILENO);
+        signal(SIGPIPE, SIG_DFL);
 
         // change working dir to 'scriptWorkingDir_'
         if (chdir(scriptWorkingDir_.c_str()) == -1) {
@@ -79,13 +172,9 @@ bool CgiProcess::start() {
             _exit(1);
         }
     }
-
-    // Parent process
-    close(pipefd_[1]);
-    // Used to monitor the time of the process (Inactive process = timeout)
-    startTime_ = time(NULL);
     return true;
 }
+#endif
 
 /**
  * Checks if the CGI process has exceeded the maximum allowed execution time.
@@ -94,41 +183,39 @@ bool CgiProcess::start() {
  * @return true if the CGI process has timed out, false otherwise.
  */
 bool CgiProcess::hasTimedOut() const {
-    time_t currentTime = time(NULL);
-    return difftime(currentTime, startTime_) > maxExecutionTime_;
+    return TimerWheel::currentTime() >= getDeadline();
+}
+
+// First second at which the process has run for more than maxExecutionTime_
+time_t CgiProcess::getDeadline() const {
+    return startTime_ + maxExecutionTime_ + 1;
 }
 
 /**
  * Terminates the CGI process by sending a kill signal to the child process.
- * This function ensures the child process is forcefully terminated and avoids the creation of a zombie process by calling `waitpid`.
+ * The process is not waited for : it is reaped by the ChildReaper of the worker (no zombie is left).
  * 
  * @return void
  */
 void CgiProcess::terminate() {
-    if (pid_ > 0) {
+    if (pid_ > 0 && !exited_) {
         kill(pid_, SIGKILL);
-        // Avoid Zombie process
-        waitpid(pid_, &cgiExitStatus_, 0); 
-        pid_ = -1;
     }
+    pid_ = -1;
 } 
 
 /**
  * Checks if the CGI process is still running.
- * This function uses `waitpid` with the `WNOHANG` option to check if the child process has completed.
+ * The process is never waited for here : it runs until the ChildReaper reports its end with setExitStatus().
  * 
  * @return true if the process is still running, false if it has ended.
  */
-bool CgiProcess::isRunning() {
-    pid_t result = waitpid(pid_, &cgiExitStatus_, WNOHANG);
-    if (result == 0) {
-        // process still executing
-        return true;
-    } else {
-        // process ended
-        pid_ = -1;
-        return false;
-    }
+bool CgiProcess::isRunning() const {
+    return pid_ > 0 && !exited_;
+}
+
+pid_t CgiProcess::getPid() const {
+    return pid_;
 }
 
 /**
@@ -142,27 +229,70 @@ int CgiProcess::getPipeFd() const {
 }
 
 /**
- * Retrieves the exit status of the CGI process.
- * This function waits for the CGI process to terminate and returns its exit status.
+ * Returns the file descriptor of the pipe used for writing the request body to the CGI process (its stdin).
+ * 
+ * @return The file descriptor, -1 once the body has been written (or if the CGI closed its stdin).
+ */
+int CgiProcess::getInputPipeFd() const {
+    return inputPipefd_[1];
+}
+
+// Closing the pipe gives EOF to the CGI stdin
+void CgiProcess::closeInputPipe() {
+    if (inputPipefd_[1] != -1) {
+        close(inputPipefd_[1]);
+        inputPipefd_[1] = -1;
+    }
+}
+
+// Stdout of the CGI fully read (EOF) : the process may still be running
+void CgiProcess::closeOutputPipe() {
+    if (pipefd_[0] != -1) {
+        close(pipefd_[0]);
+        pipefd_[0] = -1;
+    }
+}
+
+// Called once the process has been reaped (wait4 by the ChildReaper)
+void CgiProcess::setExitStatus(int status, const struct rusage& usage) {
+    exited_ = true;
+    cgiExitStatus_ = status;
+    usage_ = usage;
+}
+
+bool CgiProcess::hasExited() const {
+    return exited_;
+}
+
+/**
+ * Retrieves the exit status of the CGI process, once it has been reaped (see hasExited()).
  * 
  * @return The exit status of the CGI process.
  */
-int CgiProcess::getExitStatus(){
-    waitpid(pid_, &cgiExitStatus_, 0);
+int CgiProcess::getExitStatus() const {
     return cgiExitStatus_;
 }
 
+// CPU time and memory used by the process, once it has been reaped
+const struct rusage& CgiProcess::getResourceUsage() const {
+    return usage_;
+}
+
 /**
- * Creates the environment variables (envp) for the CGI process from a list of environment variables.
- * The environment variables are formatted and added to the `envp_` vector to be passed to the CGI process.
+ * Creates the environment variables (envp) for the CGI process : the ones computed once for the location, then the
+ * ones of the request. The pointers are taken once every string is in place.
  * 
- * @param envVars A vector of environment variables to be passed to the CGI process.
+ * @param baseEnvVars The variables that are the same for every request of the location.
+ * @param envVars The variables of the request.
  * @return void
  */
-void CgiProcess::createEnvp(const std::vector<std::string>& envVars) {
-    for (size_t i = 0; i < envVars.size(); ++i) {
-        envStrings_.push_back(envVars[i]);
-        envp_.push_back(const_cast<char*>(envStrings_.back().c_str()));
+void CgiProcess::createEnvp(const std::vector<std::string>& baseEnvVars, const std::vector<std::string>& envVars) {
+    envStrings_.reserve(baseEnvVars.size() + envVars.size());
+    envStrings_.insert(envStrings_.end(), baseEnvVars.begin(), baseEnvVars.end());
+    envStrings_.insert(envStrings_.end(), envVars.begin(), envVars.end());
+    envp_.reserve(envStrings_.size() + 1);
+    for (size_t i = 0; i < envStrings_.size(); ++i) {
+        envp_.push_back(const_cast<char*>(envStrings_[i].c_str()));
     }
     envp_.push_back(NULL);
 }
@@ -0,0 +1,102 @@
+// ChildReaper.cpp
+#include "ChildReaper.hpp"
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <cstring>
+#include <errno.h>
+#include <iostream>
+
+// Write end of the pipe of the open ChildReaper, used by the signal handler
+static volatile int g_childReaperFd = -1;
+
+// Only async-signal-safe calls : a full pipe already means the loop has to reap
+static void childSignalHandler(int) {
+    int savedErrno = errno;
+    if (g_childReaperFd != -1) {
+        ssize_t ret = write(g_childReaperFd, "c", 1);
+        (void)ret;
+    }
+    errno = savedErrno;
+}
+
+ChildReaper::ChildReaper() {
+    pipefd_[0] = pipefd_[1] = -1;
+}
+
+ChildReaper::~ChildReaper() {
+    close();
+}
+
+/**
+ * Creates the self-pipe and installs the SIGCHLD handler. Both ends are non-blocking and not inherited by
+ * the CGI scripts (close-on-exec).
+ *
+ * @return false if the pipe or the handler could not be set up.
+ */
+bool ChildReaper::open() {
+    if (pipe(pipefd_) == -1) {
+        std::cerr << "Error : SIGCHLD pipe failed: " << strerror(errno) << std::endl;
+        pipefd_[0] = pipefd_[1] = -1;
+        return false;
+    }
+    for (int i = 0; i < 2; ++i) {
+        if (fcntl(pipefd_[i], F_SETFL, O_NONBLOCK) == -1 || fcntl(pipefd_[i], F_SETFD, FD_CLOEXEC) == -1) {
+            std::cerr << "Error : SIGCHLD pipe fcntl failed: " << strerror(errno) << std::endl;
+            close();
+            return false;
+        }
+    }
+    g_childReaperFd = pipefd_[1];
+
+    // SA_RESTART : the non-blocking calls of the loop are not interrupted, only the wait for events is
+    struct sigaction sa;
+    std::memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = childSignalHandler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    if (sigaction(SIGCHLD, &sa, NULL) == -1) {
+        std::cerr << "Error : SIGCHLD sigaction failed: " << strerror(errno) << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+// Restores the default SIGCHLD handling and closes the pipe
+void ChildReaper::close() {
+    if (pipefd_[0] == -1) {
+        return;
+    }
+    signal(SIGCHLD, SIG_DFL);
+    g_childReaperFd = -1;
+    ::close(pipefd_[0]);
+    ::close(pipefd_[1]);
+    pipefd_[0] = pipefd_[1] = -1;
+}
+
+// Read end of the pipe, readable once a child has ended
+int ChildReaper::getFd() const {
+    return pipefd_[0];
+}
+
+// Empties the pipe : the children that ended are then collected with reap()
+void ChildReaper::drain() {
+    char buffer[64];
+    while (read(pipefd_[0], buffer, sizeof(buffer)) > 0) {
+    }
+}
+
+/**
+ * Collects one ended child, without waiting.
+ *
+ * @param pid    The pid of the child.
+ * @param status Its exit status (as given by waitpid).
+ * @param usage  The resources it used.
+ * @return false once no ended child is left.
+ */
+bool ChildReaper::reap(pid_t& pid, int& status, struct rusage& usage) {
+    pid = wait4(-1, &status, WNOHANG, &usage);
+    return pid > 0;
+}
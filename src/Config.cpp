@@ -1,13 +1,27 @@
 #include "../includes/Config.hpp"
 #include "../includes/Color_Macros.hpp"
+#include "../includes/EventMultiplexer.hpp"
 #include <iostream>
 
 Config::Config() : 
     clientMaxBodySize_(0),
     errorPages_(),
+    errorPageCache_(),
     root_(""),
     index_(""),
-    servers_()
+    servers_(),
+    eventBackend_(EventMultiplexer::getDefaultBackend()),
+    workers_(1),
+    keepaliveTimeout_(DEFAULT_KEEPALIVE_TIMEOUT),
+    keepaliveRequests_(DEFAULT_KEEPALIVE_REQUESTS),
+    fastCgiPoolSize_(DEFAULT_FASTCGI_POOL_SIZE),
+    fastCgiIdleTimeout_(DEFAULT_FASTCGI_IDLE_TIMEOUT),
+    fastCgiQueueSize_(DEFAULT_FASTCGI_QUEUE_SIZE),
+    openFileCacheMax_(DEFAULT_OPEN_FILE_CACHE_MAX),
+    openFileCacheValid_(DEFAULT_OPEN_FILE_CACHE_VALID),
+    staticCacheSize_(DEFAULT_STATIC_CACHE_SIZE),
+    maxConnections_(DEFAULT_MAX_CONNECTIONS),
+    maxConnectionsPerIp_(DEFAULT_MAX_CONNECTIONS_PER_IP)
 {
 }
 
@@ -51,7 +65,22 @@ const std::string Config::getErrorPage(int errorCode) const
 
 const std::string Config::getErrorPageFullPath(int errorCode) const
 {
-    return(getRoot() + getErrorPage(errorCode));
+    // No error_page for this code : empty, the default body is used (the root is not a page)
+    std::string errorPage = getErrorPage(errorCode);
+    if (errorPage.empty())
+        return "";
+    return(getRoot() + errorPage);
+}
+
+// Reads every error_page of the configuration (global, servers and locations) once for all
+void Config::loadErrorPages()
+{
+    errorPageCache_.load(*this);
+}
+
+const ErrorPageCache &Config::getErrorPageCache() const
+{
+    return errorPageCache_;
 }
 
 void Config::setRoot(const std::string &root)
@@ -84,12 +113,144 @@ const std::vector<Server*>& Config::getServers() const
     return servers_;
 }
 
+void Config::setEventBackend(const std::string &backend)
+{
+    eventBackend_ = backend;
+}
+
+const std::string &Config::getEventBackend() const
+{
+    return eventBackend_;
+}
+
+void Config::setWorkers(size_t workers)
+{
+    workers_ = workers;
+}
+
+size_t Config::getWorkers() const
+{
+    return workers_;
+}
+
+void Config::setKeepaliveTimeout(time_t timeout)
+{
+    keepaliveTimeout_ = timeout;
+}
+
+time_t Config::getKeepaliveTimeout() const
+{
+    return keepaliveTimeout_;
+}
+
+void Config::setKeepaliveRequests(size_t requests)
+{
+    keepaliveRequests_ = requests;
+}
+
+size_t Config::getKeepaliveRequests() const
+{
+    return keepaliveRequests_;
+}
+
+void Config::setFastCgiPoolSize(size_t size)
+{
+    fastCgiPoolSize_ = size;
+}
+
+size_t Config::getFastCgiPoolSize() const
+{
+    return fastCgiPoolSize_;
+}
+
+void Config::setFastCgiIdleTimeout(time_t timeout)
+{
+    fastCgiIdleTimeout_ = timeout;
+}
+
+time_t Config::getFastCgiIdleTimeout() const
+{
+    return fastCgiIdleTimeout_;
+}
+
+void Config::setFastCgiQueueSize(size_t size)
+{
+    fastCgiQueueSize_ = size;
+}
+
+size_t Config::getFastCgiQueueSize() const
+{
+    return fastCgiQueueSize_;
+}
+
+void Config::setOpenFileCacheMax(size_t entries)
+{
+    openFileCacheMax_ = entries;
+}
+
+size_t Config::getOpenFileCacheMax() const
+{
+    return openFileCacheMax_;
+}
+
+void Config::setOpenFileCacheValid(time_t valid)
+{
+    openFileCacheValid_ = valid;
+}
+
+time_t Config::getOpenFileCacheValid() const
+{
+    return openFileCacheValid_;
+}
+
+void Config::setStaticCacheSize(size_t size)
+{
+    staticCacheSize_ = size;
+}
+
+size_t Config::getStaticCacheSize() const
+{
+    return staticCacheSize_;
+}
+
+void Config::setMaxConnections(size_t connections)
+{
+    maxConnections_ = connections;
+}
+
+size_t Config::getMaxConnections() const
+{
+    return maxConnections_;
+}
+
+void Config::setMaxConnectionsPerIp(size_t connections)
+{
+    maxConnectionsPerIp_ = connections;
+}
+
+size_t Config::getMaxConnectionsPerIp() const
+{
+    return maxConnectionsPerIp_;
+}
+
 // Debug function
 void Config::displayConfig() const
 {
     std::cout << GREEN;
     std::cout << "Root global: " << this->getRoot() << std::endl;
     std::cout << "client_max_body_size global: " << this->getClientMaxBodySize() << std::endl;
+    std::cout << "event_backend: " << this->getEventBackend() << std::endl;
+    std::cout << "workers: " << this->getWorkers() << std::endl;
+    std::cout << "keepalive_timeout: " << this->getKeepaliveTimeout() << std::endl;
+    std::cout << "keepalive_requests: " << this->getKeepaliveRequests() << std::endl;
+    std::cout << "fastcgi_pool_size: " << this->getFastCgiPoolSize() << std::endl;
+    std::cout << "fastcgi_idle_timeout: " << this->getFastCgiIdleTimeout() << std::endl;
+    std::cout << "fastcgi_queue_size: " << this->getFastCgiQueueSize() << std::endl;
+    std::cout << "open_file_cache_max: " << this->getOpenFileCacheMax() << std::endl;
+    std::cout << "open_file_cache_valid: " << this->getOpenFileCacheValid() << std::endl;
+    std::cout << "static_cache_size: " << this->getStaticCacheSize() << std::endl;
+    std::cout << "max_connections: " << this->getMaxConnections() << std::endl;
+    std::cout << "max_connections_per_ip: " << this->getMaxConnectionsPerIp() << std::endl;
 
     const std::map<int, std::string> &globalErrorPages = this->getErrorPages();
     for (std::map<int, std::string>::const_iterator it = globalErrorPages.begin(); it != globalErrorPages.end(); ++it)
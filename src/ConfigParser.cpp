@@ -2,6 +2,7 @@
 #include "../includes/ConfigParser.hpp"
 #include "../includes/Server.hpp"
 #include "../includes/Location.hpp"
+#include "../includes/EventMultiplexer.hpp"
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -9,6 +10,7 @@
 #include <cstdlib>
 #include <arpa/inet.h>
 #include <limits>
+#include <unistd.h>
 
 
 ConfigParser::ConfigParser(const std::string &filePath)
@@ -43,6 +45,13 @@ Config* ConfigParser::parse()
         config_ = NULL;
         throw (e);
     }
+    // Once the servers and locations are complete : the roots of the error pages are known
+    const std::vector<Server*> &servers = config_->getServers();
+    for (size_t i = 0; i < servers.size(); ++i)
+    {
+        servers[i]->compileLocations();
+    }
+    config_->loadErrorPages();
 
     return config_;
 }
@@ -121,6 +130,69 @@ void ConfigParser::parseTokens()
             {
                 parseErrorPage(*config_);
             }
+            else if (token == "event_backend")
+            {
+                std::string backend;
+                parseSimpleDirective("event_backend", backend);
+                if (backend != "epoll" && backend != "poll")
+                    throw ParsingException("Invalid value for 'event_backend' (need 'epoll' or 'poll'): " + backend);
+                if (!EventMultiplexer::isBackendAvailable(backend))
+                    throw ParsingException("'event_backend' not available on this system: " + backend);
+                config_->setEventBackend(backend);
+            }
+            else if (token == "workers")
+            {
+                parseWorkers();
+            }
+            else if (token == "keepalive_timeout")
+            {
+                // 0 disables persistent connections
+                config_->setKeepaliveTimeout(static_cast<time_t>(parsePositiveNumber("keepalive_timeout", 3600)));
+            }
+            else if (token == "keepalive_requests")
+            {
+                config_->setKeepaliveRequests(parsePositiveNumber("keepalive_requests", 1000000));
+            }
+            else if (token == "fastcgi_pool_size")
+            {
+                size_t poolSize = parsePositiveNumber("fastcgi_pool_size", 1024);
+                if (poolSize == 0)
+                    throw ParsingException("Invalid value for 'fastcgi_pool_size': 0");
+                config_->setFastCgiPoolSize(poolSize);
+            }
+            else if (token == "fastcgi_idle_timeout")
+            {
+                config_->setFastCgiIdleTimeout(static_cast<time_t>(parsePositiveNumber("fastcgi_idle_timeout", 3600)));
+            }
+            else if (token == "fastcgi_queue_size")
+            {
+                config_->setFastCgiQueueSize(parsePositiveNumber("fastcgi_queue_size", 1000000));
+            }
+            else if (token == "open_file_cache_max")
+            {
+                // 0 disables the cache
+                config_->setOpenFileCacheMax(parsePositiveNumber("open_file_cache_max", 1000000));
+            }
+            else if (token == "open_file_cache_valid")
+            {
+                config_->setOpenFileCacheValid(static_cast<time_t>(parsePositiveNumber("open_file_cache_valid", 3600)));
+            }
+            else if (token == "static_cache_size")
+            {
+                size_t size;
+                parseSize("static_cache_size", size);
+                config_->setStaticCacheSize(size);
+            }
+            else if (token == "max_connections")
+            {
+                // Open client connections of each worker, 0 = no limit
+                config_->setMaxConnections(parsePositiveNumber("max_connections", 1000000));
+            }
+            else if (token == "max_connections_per_ip")
+            {
+                // Open client connections of each client address in each worker, 0 = no limit
+                config_->setMaxConnectionsPerIp(parsePositiveNumber("max_connections_per_ip", 1000000));
+            }
             else
             {
                 throw ParsingException("Unknown Directive in the context 'global': " + token);
@@ -157,17 +229,23 @@ void ConfigParser::parseSimpleDirective(const std::string &directiveName, std::s
 
 // Méthode pour parser 'client_max_body_size'
 void ConfigParser::parseClientMaxBodySize(size_t &size)
+{
+    parseSize("client_max_body_size", size);
+}
+
+// Méthode pour parser une taille en octets, avec une unité optionnelle ('k', 'm' ou 'g')
+void ConfigParser::parseSize(const std::string &directiveName, size_t &size)
 {
     ++currentTokenIndex_;
     if (currentTokenIndex_ >= tokens_.size())
-        throw ParsingException("Value needed after 'client_max_body_size'");
+        throw ParsingException("Value needed after '" + directiveName + "'");
 
     // Récupérer le token représentant la taille
     std::string sizeToken = tokens_[currentTokenIndex_];
 
     // Vérifier que le token n'est pas vide
     if (sizeToken.empty())
-        throw ParsingException("empty value for 'client_max_body_size'");
+        throw ParsingException("empty value for '" + directiveName + "'");
 
     // Variables pour stocker la partie numérique et l'unité
     std::string numericPart;
@@ -183,7 +261,7 @@ void ConfigParser::parseClientMaxBodySize(size_t &size)
 
     // Vérifier qu'il y a bien une partie numérique
     if (numericPart.empty())
-        throw ParsingException("Numeric value needed for 'client_max_body_size'");
+        throw ParsingException("Numeric value needed for '" + directiveName + "'");
 
     // Récupérer la partie unité
     unitPart = sizeToken.substr(pos);
@@ -193,11 +271,11 @@ void ConfigParser::parseClientMaxBodySize(size_t &size)
     errno = 0; // Réinitialiser errno avant l'appel
     unsigned long numericValue = strtoul(numericPart.c_str(), &endptr, 10);
     if (*endptr != '\0' || errno == ERANGE)
-        throw ParsingException("Invalid numeric value for'client_max_body_size'");
+        throw ParsingException("Invalid numeric value for'" + directiveName + "'");
 
     // Vérifier que numericValue peut être converti en size_t sans débordement
     if (numericValue > static_cast<unsigned long>(std::numeric_limits<size_t>::max()))
-        throw ParsingException("Too big value for 'client_max_body_size'");
+        throw ParsingException("Too big value for '" + directiveName + "'");
 
     size_t sizeInBytes = static_cast<size_t>(numericValue);
 
@@ -207,24 +285,24 @@ void ConfigParser::parseClientMaxBodySize(size_t &size)
         if (unitPart == "k" || unitPart == "K")
         {
             if (sizeInBytes > std::numeric_limits<size_t>::max() / 1024)
-                throw ParsingException("Too big value for 'client_max_body_size'");
+                throw ParsingException("Too big value for '" + directiveName + "'");
             sizeInBytes *= 1024;
         }
         else if (unitPart == "m" || unitPart == "M")
         {
             if (sizeInBytes > std::numeric_limits<size_t>::max() / (1024 * 1024))
-                throw ParsingException("Too big value for 'client_max_body_size'");
+                throw ParsingException("Too big value for '" + directiveName + "'");
             sizeInBytes *= 1024 * 1024;
         }
         else if (unitPart == "g" || unitPart == "G")
         {
             if (sizeInBytes > std::numeric_limits<size_t>::max() / (static_cast<size_t>(1024) * 1024 * 1024))
-                throw ParsingException("Too big value for 'client_max_body_size'");
+                throw ParsingException("Too big value for '" + directiveName + "'");
             sizeInBytes *= static_cast<size_t>(1024) * 1024 * 1024;
         }
         else
         {
-            throw ParsingException("Invalid unit after'client_max_body_size' (need 'k', 'm' or'g')");
+            throw ParsingException("Invalid unit after'" + directiveName + "' (need 'k', 'm' or'g')");
         }
     }
 
@@ -233,7 +311,7 @@ void ConfigParser::parseClientMaxBodySize(size_t &size)
 
     ++currentTokenIndex_;
     if (currentTokenIndex_ >= tokens_.size() || tokens_[currentTokenIndex_] != ";")
-        throw ParsingException("';' needed after 'client_max_body_size'");
+        throw ParsingException("';' needed after '" + directiveName + "'");
     ++currentTokenIndex_;
 }
 // Méthode pour parser 'error_page' pour Config
@@ -386,6 +464,31 @@ void ConfigParser::parseListen(Server &server)
 
     std::string listenValue = tokens_[currentTokenIndex_];
     ++currentTokenIndex_;
+    while (currentTokenIndex_ < tokens_.size() && tokens_[currentTokenIndex_] != ";")
+    {
+        const std::string &parameter = tokens_[currentTokenIndex_];
+        // 'listen 8080 default_server;' : server of the hosts that match no server_name on this IP:PORT
+        if (parameter == "default_server")
+        {
+            server.setDefaultServer(true);
+        }
+        // 'listen 8080 backlog=N;' : length of the queue of the connections not accepted yet
+        else if (parameter.compare(0, 8, "backlog=") == 0)
+        {
+            std::string value = parameter.substr(8);
+            if (value.empty() || !isNumber(value) || value.length() > 6)
+                throw ParsingException("Invalid backlog in 'listen': " + parameter);
+            int backlog = std::atoi(value.c_str());
+            if (backlog <= 0 || backlog > 65535)
+                throw ParsingException("Invalid backlog in 'listen': " + parameter);
+            server.setListenBacklog(backlog);
+        }
+        else
+        {
+            throw ParsingException("Unknown parameter in 'listen': " + parameter);
+        }
+        ++currentTokenIndex_;
+    }
     if (currentTokenIndex_ >= tokens_.size() || tokens_[currentTokenIndex_] != ";")
         throw ParsingException("';' needed after 'listen'");
     ++currentTokenIndex_;
@@ -424,13 +527,67 @@ void ConfigParser::parseListen(Server &server)
     // std::cout << "CONFIGPARSER.cpp parseListen : "<< ipPart << ":"<<portPart << " hexa :" << server.getHost()<< ":" << server.getPort() << std::endl;//test
 }
 
+// Méthode pour parser une directive qui prend un nombre entier entre 0 et max
+size_t ConfigParser::parsePositiveNumber(const std::string &directiveName, size_t max)
+{
+    std::string value;
+    parseSimpleDirective(directiveName, value);
+    if (value.empty() || !isNumber(value) || value.length() > 10)
+        throw ParsingException("Invalid numeric value for '" + directiveName + "': " + value);
+    unsigned long number = strtoul(value.c_str(), NULL, 10);
+    if (number > max)
+        throw ParsingException("Too big value for '" + directiveName + "': " + value);
+    return static_cast<size_t>(number);
+}
+
+// Méthode pour parser 'workers' : un nombre de workers ou 'auto' (= nombre de coeurs)
+void ConfigParser::parseWorkers()
+{
+    std::string workersValue;
+    parseSimpleDirective("workers", workersValue);
+
+    long workers;
+    if (workersValue == "auto")
+    {
+        workers = sysconf(_SC_NPROCESSORS_ONLN);
+        if (workers < 1)
+            workers = 1;
+    }
+    else
+    {
+        if (workersValue.empty() || !isNumber(workersValue) || workersValue.length() > 4)
+            throw ParsingException("Invalid value for 'workers' (need a number or 'auto'): " + workersValue);
+        workers = std::atol(workersValue.c_str());
+    }
+    if (workers < 1 || workers > static_cast<long>(MAX_WORKERS))
+        throw ParsingException("Invalid value for 'workers' (need 1 to 512): " + workersValue);
+    config_->setWorkers(static_cast<size_t>(workers));
+}
+
 void ConfigParser::parseLocation(Server &server)
 {
     ++currentTokenIndex_;
     if (currentTokenIndex_ >= tokens_.size())
         throw ParsingException("Expecting path before 'location' block");
 
+    // 'location = /path' (or '=/path') : exact match
+    bool exactMatch = false;
     std::string path = tokens_[currentTokenIndex_];
+    if (path == "=")
+    {
+        exactMatch = true;
+        ++currentTokenIndex_;
+        if (currentTokenIndex_ >= tokens_.size())
+            throw ParsingException("Expecting path after 'location ='");
+        path = tokens_[currentTokenIndex_];
+    }
+    else if (path.size() > 1 && path[0] == '=')
+    {
+        exactMatch = true;
+        path.erase(0, 1);
+    }
+    if (path == "{")
+        throw ParsingException("Expecting path before 'location' block");
     ++currentTokenIndex_;
 
     if (currentTokenIndex_ >= tokens_.size() || tokens_[currentTokenIndex_] != "{")
@@ -438,6 +595,7 @@ void ConfigParser::parseLocation(Server &server)
     ++currentTokenIndex_;
 
     Location location(server, path);
+    location.setExactMatch(exactMatch);
 
     while (currentTokenIndex_ < tokens_.size())
     {
@@ -547,6 +705,117 @@ void ConfigParser::parseLocation(Server &server)
             parseSimpleDirective("upload_store", uploadStoreValue);
             location.setUploadStore(uploadStoreValue);
         }
+        else if (token == "fastcgi_pass")
+        {
+            // Unix socket of the FastCGI responder : 'unix:/path/to/socket' or '/path/to/socket'
+            std::string fastCgiValue;
+            parseSimpleDirective("fastcgi_pass", fastCgiValue);
+            if (fastCgiValue.compare(0, 5, "unix:") == 0)
+                fastCgiValue.erase(0, 5);
+            if (fastCgiValue.empty())
+                throw ParsingException("Invalid value for 'fastcgi_pass': " + tokens_[currentTokenIndex_ - 2]);
+            location.setFastCgiPass(fastCgiValue);
+        }
+        else if (token == "static_cache")
+        {
+            ++currentTokenIndex_;
+            if (currentTokenIndex_ >= tokens_.size())
+                throw ParsingException("'on' or'off' needed after 'static_cache'");
+            if (tokens_[currentTokenIndex_] == "on")
+                location.setStaticCache(true);
+            else if (tokens_[currentTokenIndex_] == "off")
+                location.setStaticCache(false);
+            else
+                throw ParsingException("Invalid value for 'static_cache': " + tokens_[currentTokenIndex_]);
+            ++currentTokenIndex_;
+            if (currentTokenIndex_ >= tokens_.size() || tokens_[currentTokenIndex_] != ";")
+                throw ParsingException("';' needed after 'static_cache'");
+            ++currentTokenIndex_;
+        }
+        else if (token == "static_cache_max_size")
+        {
+            size_t size;
+            parseSize("static_cache_max_size", size);
+            location.setStaticCacheMaxSize(size);
+        }
+        else if (token == "gzip_static")
+        {
+            ++currentTokenIndex_;
+            if (currentTokenIndex_ >= tokens_.size())
+                throw ParsingException("'on' or'off' needed after 'gzip_static'");
+            if (tokens_[currentTokenIndex_] == "on")
+                location.setGzipStatic(true);
+            else if (tokens_[currentTokenIndex_] == "off")
+                location.setGzipStatic(false);
+            else
+                throw ParsingException("Invalid value for 'gzip_static': " + tokens_[currentTokenIndex_]);
+            ++currentTokenIndex_;
+            if (currentTokenIndex_ >= tokens_.size() || tokens_[currentTokenIndex_] != ";")
+                throw ParsingException("';' needed after 'gzip_static'");
+            ++currentTokenIndex_;
+        }
+        else if (token == "brotli_static")
+        {
+            ++currentTokenIndex_;
+            if (currentTokenIndex_ >= tokens_.size())
+                throw ParsingException("'on' or'off' needed after 'brotli_static'");
+            if (tokens_[currentTokenIndex_] == "on")
+                location.setBrotliStatic(true);
+            else if (tokens_[currentTokenIndex_] == "off")
+                location.setBrotliStatic(false);
+            else
+                throw ParsingException("Invalid value for 'brotli_static': " + tokens_[currentTokenIndex_]);
+            ++currentTokenIndex_;
+            if (currentTokenIndex_ >= tokens_.size() || tokens_[currentTokenIndex_] != ";")
+                throw ParsingException("';' needed after 'brotli_static'");
+            ++currentTokenIndex_;
+        }
+        else if (token == "gzip")
+        {
+            ++currentTokenIndex_;
+            if (currentTokenIndex_ >= tokens_.size())
+                throw ParsingException("'on' or'off' needed after 'gzip'");
+            if (tokens_[currentTokenIndex_] == "on")
+                location.setGzip(true);
+            else if (tokens_[currentTokenIndex_] == "off")
+                location.setGzip(false);
+            else
+                throw ParsingException("Invalid value for 'gzip': " + tokens_[currentTokenIndex_]);
+            ++currentTokenIndex_;
+            if (currentTokenIndex_ >= tokens_.size() || tokens_[currentTokenIndex_] != ";")
+                throw ParsingException("';' needed after 'gzip'");
+            ++currentTokenIndex_;
+        }
+        else if (token == "gzip_types")
+        {
+            // MIME types compressed in addition to text/html ('*' for every type)
+            ++currentTokenIndex_;
+            std::vector<std::string> types;
+            while (currentTokenIndex_ < tokens_.size() && tokens_[currentTokenIndex_] != ";")
+            {
+                types.push_back(tokens_[currentTokenIndex_]);
+                ++currentTokenIndex_;
+            }
+            if (types.empty())
+                throw ParsingException("Value needed after 'gzip_types'");
+            location.setGzipTypes(types);
+            if (currentTokenIndex_ >= tokens_.size() || tokens_[currentTokenIndex_] != ";")
+                throw ParsingException("';' needed after 'gzip_types'");
+            ++currentTokenIndex_;
+        }
+        else if (token == "gzip_min_length")
+        {
+            size_t length;
+            parseSize("gzip_min_length", length);
+            location.setGzipMinLength(length);
+        }
+        else if (token == "gzip_comp_level")
+        {
+            size_t level = parsePositiveNumber("gzip_comp_level", 9);
+            if (level == 0)
+                throw ParsingException("Invalid value for 'gzip_comp_level' (need 1 to 9): 0");
+            location.setGzipCompLevel(static_cast<int>(level));
+        }
         else
         {
             throw ParsingException("Unknown directive in the context 'location': " + token);
@@ -1,30 +1,55 @@
 // DataSocket.cpp
 #include "DataSocket.hpp"
 #include "RequestHandler.hpp"
+#include "CgiInputSink.hpp"
 #include "Color_Macros.hpp"
 #include "Error.hpp"
+#include "TimerWheel.hpp"
+#include "Utils.hpp"
 #include <unistd.h>
 #include <iostream>
 #include <sys/wait.h>
-#include <errno.h>//debug
+#include <sstream>
+#include <cstdlib>
+#include <cctype>
+#include <algorithm>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#ifdef __linux__
+# include <sys/sendfile.h>
+#endif
+#include <arpa/inet.h>
+#include <errno.h>
 #include <cstring>//debug
 
-DataSocket::DataSocket(int fd, const std::vector<Server*>& servers, const Config* config)
-    : client_fd_(fd), associatedServers_(servers), requestComplete_(false), config_(config),
-      sendBufferOffset_(0), cgiProcess_(NULL), cgiPipeFd_(-1), cgiComplete_(true),
+DataSocket::DataSocket(int fd, const struct sockaddr_in& peerAddress, const VirtualHostTable& virtualHosts, const Config* config,
+                       OpenFileCache* openFileCache, StaticResponseCache* staticResponseCache)
+    : client_fd_(fd), remotePort_(ntohs(peerAddress.sin_port)), virtualHosts_(virtualHosts), requestComplete_(false), config_(config), openFileCache_(openFileCache),
+      staticResponseCache_(staticResponseCache), sendBufferOffset_(0), sendFileFd_(-1), sendFileOffset_(0),
+      sendFileRemaining_(0), sendFilePartIndex_(0), sharedResponse_(NULL), sharedHeaderLength_(0), sharedBodyLength_(0), connectionHeader_(""),
+      sharedResponseOffset_(0), gzipEncoder_(NULL), gzipChunked_(false), gzipBodyPending_(false),
+      gzipSourceOffset_(0), requestsCount_(0), headRequest_(false),
+      cgiProcess_(NULL), cgiPipeWatcher_(NULL), cgiPipeFd_(-1), cgiComplete_(true), cgiResponseStarted_(false),
+      cgiChunked_(false), cgiLocation_(NULL), cgiAcceptsGzip_(false), cgiInputOffset_(0), cgiInputComplete_(true),
+      cgiBodyStreaming_(false), fastCgiActive_(false),
       shouldCloseAfterSend_(false) {
     // Timeout detection
-    lastActivityTime_ = time(NULL);
+    lastActivityTime_ = TimerWheel::currentTime();
+    char ipStr[INET_ADDRSTRLEN];
+    if (inet_ntop(AF_INET, &peerAddress.sin_addr, ipStr, sizeof(ipStr)) != NULL) {
+        remoteAddress_ = ipStr;
+    }
 }
 
 
 DataSocket::~DataSocket() {
     // std::cout << "DESTRUCTOR Datasocket" << std::endl;
     closeSocket();
-    if (cgiProcess_) {
-        delete cgiProcess_;
-        cgiProcess_ = NULL;
-    }
+    closeSendFile();
+    releaseSharedResponse();
+    releaseGzip();
+    // Connection closed while its CGI runs (client gone, inactivity, shutdown) : the script is killed
+    releaseCgiProcess();
 }
 
 bool DataSocket::receiveData() {
@@ -33,34 +58,52 @@ bool DataSocket::receiveData() {
     ssize_t bytesRead = recv(client_fd_, buffer, sizeof(buffer), 0);
 
     if (bytesRead > 0) {
-        lastActivityTime_ = time(NULL);
-        std::string data(buffer, bytesRead);
-        httpRequest_.appendData(data);
-
-        if (httpRequest_.parseRequest()) {
-            if (httpRequest_.hasParseError()) {
-                handleParseError(httpRequest_.getParseErrorCode());
-                // keep socket open to send the error
-                return true;
-            }
-            requestComplete_ = httpRequest_.isComplete();
-        } else {
-            if (httpRequest_.hasParseError()) {
-                handleParseError(httpRequest_.getParseErrorCode());
-                // keep socket open to send the error
-                return true;
-            }
-        }
-        // keep socket open to send the response
-        return true;
+        lastActivityTime_ = TimerWheel::currentTime();
+        httpRequest_.appendData(buffer, bytesRead);
+        parseReceivedData();
+        // keep socket open to send the response (unless a streamed body was invalid with nothing left to send)
+        return !isFinished();
     } else if (bytesRead == 0) {
         // std::cout << "Connection properly closed by client, closing socket." << std::endl;
         return false; 
-    } else if (bytesRead == -1) {
-        // std::cerr << "Connection suddenly closed by client, or an error occured, closing socket." << std::endl;
-        return false;
+    } else if (isRetryableIoError(errno)) {
+        // Non-blocking socket : nothing to read yet
+        return true;
     }
-    return true;
+    // std::cerr << "Connection suddenly closed by client, or an error occured, closing socket." << std::endl;
+    return false;
+}
+
+/**
+ * Parses the bytes received for the current request. Nothing is parsed while the previous response 
+ * is still being produced or sent : pipelined requests wait in the HttpRequest buffer and are answered in order.
+ */
+void DataSocket::parseReceivedData() {
+    // Body of a request whose CGI is already running : parsed as it arrives, whatever the state of the response
+    if (cgiBodyStreaming_) {
+        parseStreamedBody();
+        return;
+    }
+    if (requestComplete_ || hasDataToSend() || isWaitingForBackend()) {
+        return;
+    }
+    httpRequest_.parseRequest();
+    // Headers parsed : the body is only read once its limit (and destination) for the location is known
+    if (httpRequest_.isWaitingForBodyLimit()) {
+        RequestHandler handler(*config_, virtualHosts_, remoteAddress_, openFileCache_, staticResponseCache_);
+        // CGI : the request is processed now, its body is streamed to the script by processRequest()
+        if (handler.prepareRequestBody(httpRequest_) && !httpRequest_.hasParseError()) {
+            requestComplete_ = true;
+            return;
+        }
+        httpRequest_.parseRequest();
+    }
+    if (httpRequest_.hasParseError()) {
+        handleParseError(httpRequest_.getParseErrorCode());
+        // keep socket open to send the error
+        return;
+    }
+    requestComplete_ = httpRequest_.isComplete();
 }
 
 void DataSocket::handleParseError(int errorCode) {
@@ -68,34 +111,66 @@ void DataSocket::handleParseError(int errorCode) {
     RequestResult result;
     const Server* server = getAssociatedServer();
     if (server) {
-        result.response = handleError(errorCode, server->getErrorPageFullPath(errorCode));
+        result.response = handleError(errorCode, server->getErrorPageFullPath(errorCode), &config_->getErrorPageCache());
     } else {
-        result.response = handleError(errorCode, config_->getErrorPageFullPath(errorCode));
+        result.response = handleError(errorCode, config_->getErrorPageFullPath(errorCode), &config_->getErrorPageCache());
     }
-    sendBuffer_ = result.response.generateResponse();
-    sendBufferOffset_ = 0;
     //An error happened during parsing so the socket need to be closed
     shouldCloseAfterSend_ = true;
+    headRequest_ = false;
+    queueResponse(result.response);
 }
 
+// Default server of the IP:PORT, for the errors detected before a Host is known
 const Server* DataSocket::getAssociatedServer() const {
-    if (!associatedServers_.empty()) {
-        return associatedServers_[0];
-    }
-    return NULL;
+    return virtualHosts_.getDefaultServer();
 }
 
 bool DataSocket::isRequestComplete() const {
     return requestComplete_;
 }
 
+// A request can be processed once it is complete and the previous response has been sent
+bool DataSocket::isReadyToProcess() const {
+    return requestComplete_ && !hasDataToSend() && !isWaitingForBackend() && !shouldCloseAfterSend_;
+}
+
+// New data is only read when it can be parsed (backpressure on pipelined requests, and on a CGI slower than its client)
+bool DataSocket::wantsToReceive() const {
+    if (cgiBodyStreaming_) {
+        return cgiInputBuffer_.size() - cgiInputOffset_ < CGI_INPUT_HIGH_WATER_MARK;
+    }
+    return !requestComplete_ && !hasDataToSend() && !isWaitingForBackend() && !shouldCloseAfterSend_;
+}
+
 void DataSocket::processRequest() {
-    RequestHandler handler(*config_, associatedServers_);
+    // Persistent connection : asked by the client, allowed by keepalive_timeout and keepalive_requests
+    ++requestsCount_;
+    if (config_->getKeepaliveTimeout() == 0 || requestsCount_ >= config_->getKeepaliveRequests()) {
+        httpRequest_.disableKeepAlive();
+    }
+    shouldCloseAfterSend_ = !httpRequest_.isKeepAlive();
+    headRequest_ = httpRequest_.getMethod() == "HEAD";
+
+    RequestHandler handler(*config_, virtualHosts_, remoteAddress_, openFileCache_, staticResponseCache_);
     RequestResult result = handler.handleRequest(httpRequest_);
 
+    if (!httpRequest_.isComplete() && !result.cgiProcess && result.fastCgiPass.empty()) {
+        // Answered before its body was received (no CGI started) : the body is not read, the connection is closed
+        shouldCloseAfterSend_ = true;
+    }
     if (result.responseReady) {
-        sendBuffer_ = result.response.generateResponse();
-        sendBufferOffset_ = 0;
+        queueResponse(result.response);
+    } else if (!result.fastCgiPass.empty()) {
+        // The request is given to a FastCGI pool by the event loop, its output comes back through appendCgiOutput()
+        fastCgiActive_ = true;
+        fastCgiPass_ = result.fastCgiPass;
+        fastCgiParams_.swap(result.fastCgiParams);
+        cgiResponseStarted_ = false;
+        cgiChunked_ = httpRequest_.getHttpVersion() == "HTTP/1.1";
+        cgiLocation_ = result.location;
+        cgiAcceptsGzip_ = result.acceptsGzip;
+        startCgiInput();
     } else if (result.cgiProcess) {
         cgiProcess_ = result.cgiProcess;
         cgiPipeFd_ = cgiProcess_->getPipeFd();
@@ -103,41 +178,222 @@ void DataSocket::processRequest() {
         // std::cout << CYAN <<"DataSocket::processRequest result.cgiprocess : " << cgiPipeFd_ << RESET <<std::endl;//test
         // std::cout << CYAN <<"DataSocket::processRequest result.cgipid: " << cgiPid_ << RESET <<std::endl;//test
         cgiComplete_ = false;
+        cgiResponseStarted_ = false;
+        cgiChunked_ = httpRequest_.getHttpVersion() == "HTTP/1.1";
+        cgiLocation_ = result.location;
+        cgiAcceptsGzip_ = result.acceptsGzip;
+        startCgiInput();
     } else {
-        sendBuffer_ = result.response.generateResponse();
-        sendBufferOffset_ = 0;
+        queueResponse(result.response);
     }
 
-    httpRequest_.reset();
     requestComplete_ = false;
+    if (cgiBodyStreaming_) {
+        // The body already received goes to the CGI now, the rest as it arrives
+        parseStreamedBody();
+        return;
+    }
+    // Bytes of pipelined requests are kept by reset()
+    httpRequest_.reset();
+}
+
+/**
+ * The body is written to the CGI stdin by the event loop, when the pipe is writable (taken by the FastCGI connection 
+ * as STDIN records). A body not received yet is streamed to it by a CgiInputSink : the CGI runs while its client is 
+ * still sending.
+ */
+void DataSocket::startCgiInput() {
+    httpRequest_.moveBodyTo(cgiInputBuffer_);
+    cgiInputOffset_ = 0;
+    if (!httpRequest_.isComplete()) {
+        httpRequest_.setBodySink(new CgiInputSink(*this));
+        cgiInputComplete_ = false;
+        cgiBodyStreaming_ = true;
+        return;
+    }
+    cgiInputComplete_ = true;
+    if (cgiInputBuffer_.empty()) {
+        closeCgiInput();
+    }
+}
+
+/**
+ * Parses the next bytes of a body streamed to its CGI. Once the body is complete, the request is reset : the 
+ * bytes of a pipelined request are kept, and parsed once the response is over.
+ * An invalid body (chunk framing, client_max_body_size) ends the CGI (or the FastCGI request), and the connection 
+ * since its end is unknown.
+ */
+void DataSocket::parseStreamedBody() {
+    httpRequest_.parseRequest();
+    if (httpRequest_.hasParseError()) {
+        int errorCode = httpRequest_.getParseErrorCode();
+        cgiBodyStreaming_ = false;
+        shouldCloseAfterSend_ = true;
+        headRequest_ = false;
+        httpRequest_.reset();
+        terminateCgiProcess(errorCode);
+        if (fastCgiActive_) {
+            // Removed from the queue, or its connection (waiting for the rest of STDIN) is closed
+            if (cgiPipeWatcher_) {
+                cgiPipeWatcher_->cancelFastCgiRequest(this);
+            }
+            failFastCgiRequest(errorCode);
+        }
+        return;
+    }
+    if (httpRequest_.isComplete()) {
+        cgiBodyStreaming_ = false;
+        httpRequest_.reset();
+    }
+}
+
+/**
+ * Prepares a response to be sent to the client.
+ * The Connection header depends on the keep-alive decision taken for the request.
+ * The header block (and an in-memory body) is serialized in sendBuffer_. A file body is not read :
+ * the DataSocket takes the ownership of its fd and streams it with sendfile() once the headers are sent.
+ * A body to gzip is compressed by sendData(), one piece at a time (the CGI output by appendCgiBody()).
+ */
+void DataSocket::queueResponse(HttpResponse& response) {
+    closeSendFile();
+    releaseSharedResponse();
+    releaseGzip();
+    if (response.hasSharedResponse()) {
+        // Nothing is serialized : the buffer of the static cache or error page is sent as it is (no body for HEAD)
+        sharedResponse_ = response.getSharedResponse();
+        sharedResponse_->retain();
+        sharedHeaderLength_ = response.getSharedHeaderLength();
+        sharedExtraHeaders_ = response.generateHeaderFields();
+        sharedBodyLength_ = headRequest_ ? 0 : sharedResponse_->size() - sharedHeaderLength_;
+        connectionHeader_ = shouldCloseAfterSend_ ? "Connection: close\r\n\r\n" : "Connection: keep-alive\r\n\r\n";
+        sharedResponseOffset_ = 0;
+        sendBuffer_.clear();
+        sendBufferOffset_ = 0;
+        return;
+    }
+    // Decided before the Connection header : without chunked framing, the end of the body is the end of the connection
+    bool gzipBody = false;
+    if (response.getGzipLevel() > 0) {
+        bool chunked = isWaitingForBackend() ? cgiChunked_ : httpRequest_.getHttpVersion() == "HTTP/1.1";
+        gzipBody = startGzip(response, chunked);
+    }
+    if (shouldCloseAfterSend_) {
+        response.setHeader("Connection", "close");
+    } else {
+        response.setHeader("Connection", "keep-alive");
+    }
+    sendBuffer_ = response.generateHeaders();
+    sendBufferOffset_ = 0;
+    if (headRequest_) {
+        // Headers only : an fd given with the response goes back to the open file cache
+        releaseGzip();
+        sendFileFd_ = response.getBodyFd();
+        closeSendFile();
+        return;
+    }
+    if (gzipBody && !isWaitingForBackend()) {
+        // The body (file or in-memory) is compressed by produceGzipBody() once the headers are sent
+        gzipBodyPending_ = true;
+        if (response.hasBodyFile()) {
+            sendFileFd_ = response.getBodyFd();
+            sendFileOffset_ = response.getBodyFileOffset();
+            sendFileRemaining_ = response.getBodyFileLength();
+        } else {
+            gzipSource_ = response.getBody();
+            gzipSourceOffset_ = 0;
+        }
+        return;
+    }
+    sendBuffer_.append(response.getBody());
+    if (response.hasBodyFile()) {
+        sendFileFd_ = response.getBodyFd();
+        if (!response.getBodyFileParts().empty()) {
+            sendFileParts_ = response.getBodyFileParts();
+            sendFilePartIndex_ = 0;
+            nextFilePart();
+            return;
+        }
+        sendFileOffset_ = response.getBodyFileOffset();
+        sendFileRemaining_ = response.getBodyFileLength();
+        if (sendFileRemaining_ == 0) {
+            closeSendFile();
+        }
+    }
 }
 
 bool DataSocket::sendData() {
-    if (sendBuffer_.empty()) {
+    if (!hasDataToSend()) {
         return true;
     }
 
-    ssize_t bytesSent = send(client_fd_, sendBuffer_.c_str() + sendBufferOffset_, sendBuffer_.size() - sendBufferOffset_, 0);
+    // On-the-fly gzip : the next piece of the body is compressed once the previous one has been sent
+    if (gzipBodyPending_ && sendBufferOffset_ >= sendBuffer_.size() && !produceGzipBody()) {
+        return false;
+    }
+
+    ssize_t bytesSent;
+    if (sharedResponse_) {
+        bytesSent = sendSharedResponse();
+    } else if (sendBufferOffset_ < sendBuffer_.size()) {
+        int flags = 0;
+#ifdef MSG_MORE
+        // The file follows : the headers wait for its first bytes instead of leaving alone (Nagle + delayed ACK)
+        if (sendFileRemaining_ > 0 && !gzipBodyPending_) {
+            flags = MSG_MORE;
+        }
+#endif
+        bytesSent = send(client_fd_, sendBuffer_.c_str() + sendBufferOffset_, sendBuffer_.size() - sendBufferOffset_, flags);
+    } else {
+        bytesSent = sendFileChunk();
+    }
+
     //Data hs been succesfully sent 
     if (bytesSent > 0) {
-        lastActivityTime_ = time(NULL);
-        sendBufferOffset_ += bytesSent;
-        if (sendBufferOffset_ >= sendBuffer_.size()) {
+        lastActivityTime_ = TimerWheel::currentTime();
+        if (sharedResponse_) {
+            sharedResponseOffset_ += bytesSent;
+            if (sharedResponseOffset_ >= getSharedResponseLength()) {
+                releaseSharedResponse();
+            }
+        } else if (sendBufferOffset_ < sendBuffer_.size()) {
+            sendBufferOffset_ += bytesSent;
+        } else {
+            sendFileRemaining_ -= bytesSent;
+            if (sendFileRemaining_ == 0 && !nextFilePart()) {
+                closeSendFile();
+            }
+        }
+        if (!hasDataToSend()) {
             sendBuffer_.clear();
             sendBufferOffset_ = 0;
-            //If an error detected : shouldCloseAfterSend_ = true
+            // Streamed CGI response : the rest of the body is not produced yet
+            if (isWaitingForBackend()) {
+                return true;
+            }
+            //If an error detected or no keep-alive : shouldCloseAfterSend_ = true
             if (shouldCloseAfterSend_) {
                 return false;
             }
+            // Persistent connection : a pipelined request may already be waiting
+            lastActivityTime_ = TimerWheel::currentTime();
+            parseReceivedData();
             return true;
         }
     } 
     //Sometines occur in non-blocking systems, we will retry to send data
     else if (bytesSent == 0) {
+        // The file got shorter than announced : the response can't be completed
+        if (sendBufferOffset_ >= sendBuffer_.size() && sendFileFd_ != -1) {
+            return false;
+        }
         return true;
     } 
+    // Non-blocking socket full : retried when it is writable again
+    else if (isRetryableIoError(errno)) {
+        return true;
+    }
     //error detected during send, we close the socket responsible
-    else if (bytesSent == -1) {
+    else {
         // std::cerr << "An error occured while sending data via a DataSocket, socket will be closed" << std::endl;//Debug
         return false;
     }
@@ -145,8 +401,194 @@ bool DataSocket::sendData() {
     return true;
 }
 
+/**
+ * Sends the next part of the file body, straight from the page cache to the socket (no copy in user space).
+ * Without sendfile(), a fixed size buffer is used so the memory stays constant whatever the file size.
+ */
+ssize_t DataSocket::sendFileChunk() {
+    size_t chunk = sendFileRemaining_;
+    if (chunk > SENDFILE_CHUNK_SIZE) {
+        chunk = SENDFILE_CHUNK_SIZE;
+    }
+#ifdef __linux__
+    return sendfile(client_fd_, sendFileFd_, &sendFileOffset_, chunk);
+#else
+    char buffer[16384];
+    if (chunk > sizeof(buffer)) {
+        chunk = sizeof(buffer);
+    }
+    ssize_t bytesRead = pread(sendFileFd_, buffer, chunk, sendFileOffset_);
+    if (bytesRead <= 0) {
+        return bytesRead;
+    }
+    ssize_t bytesSent = send(client_fd_, buffer, bytesRead, 0);
+    if (bytesSent > 0) {
+        sendFileOffset_ += bytesSent;
+    }
+    return bytesSent;
+#endif
+}
+
+/**
+ * multipart/byteranges : queues the headers of the next part in sendBuffer_ and selects its slice of the file.
+ *
+ * @return false if every part has been queued.
+ */
+bool DataSocket::nextFilePart() {
+    if (sendFilePartIndex_ >= sendFileParts_.size()) {
+        return false;
+    }
+    const BodyFilePart& part = sendFileParts_[sendFilePartIndex_++];
+    if (sendBufferOffset_ > 0) {
+        sendBuffer_.erase(0, sendBufferOffset_);
+        sendBufferOffset_ = 0;
+    }
+    sendBuffer_.append(part.header);
+    sendFileOffset_ = part.offset;
+    sendFileRemaining_ = part.length;
+    if (sendFileRemaining_ == 0) {
+        // Closing delimiter : nothing else is read from the file
+        closeSendFile();
+    }
+    return true;
+}
+
+void DataSocket::closeSendFile() {
+    // A fd of the open file cache is only given back to it, it stays open for the next requests
+    if (sendFileFd_ != -1) {
+        if (!openFileCache_->release(sendFileFd_)) {
+            close(sendFileFd_);
+        }
+        sendFileFd_ = -1;
+    }
+    sendFileOffset_ = 0;
+    sendFileRemaining_ = 0;
+    std::vector<BodyFilePart>().swap(sendFileParts_);
+    sendFilePartIndex_ = 0;
+}
+
+/**
+ * Sends the next part of a pre-serialized response : its header block, the headers added to it, the Connection 
+ * header of this socket and its body are given to one writev(), the shared buffer is never copied.
+ */
+ssize_t DataSocket::sendSharedResponse() {
+    const char* parts[4] = { sharedResponse_->data(), sharedExtraHeaders_.data(), connectionHeader_,
+                             sharedResponse_->data() + sharedHeaderLength_ };
+    size_t lengths[4] = { sharedHeaderLength_, sharedExtraHeaders_.size(), strlen(connectionHeader_), sharedBodyLength_ };
+    struct iovec iov[4];
+    int count = 0;
+    size_t skip = sharedResponseOffset_;
+    for (int i = 0; i < 4; ++i) {
+        if (skip >= lengths[i]) {
+            skip -= lengths[i];
+            continue;
+        }
+        iov[count].iov_base = const_cast<char*>(parts[i] + skip);
+        iov[count].iov_len = lengths[i] - skip;
+        skip = 0;
+        ++count;
+    }
+    return writev(client_fd_, iov, count);
+}
+
+size_t DataSocket::getSharedResponseLength() const {
+    return sharedHeaderLength_ + sharedExtraHeaders_.size() + strlen(connectionHeader_) + sharedBodyLength_;
+}
+
+void DataSocket::releaseSharedResponse() {
+    if (sharedResponse_) {
+        sharedResponse_->release();
+        sharedResponse_ = NULL;
+    }
+    sharedExtraHeaders_.clear();
+    sharedBodyLength_ = 0;
+    sharedResponseOffset_ = 0;
+}
+
+/**
+ * Sets up the gzip of a response body : Content-Length is replaced by Content-Encoding, and by chunked framing 
+ * or the close of the connection.
+ *
+ * @return false if zlib could not be initialized : the body is sent as it is.
+ */
+bool DataSocket::startGzip(HttpResponse& response, bool chunked) {
+    gzipEncoder_ = new GzipEncoder(response.getGzipLevel());
+    if (!gzipEncoder_->isValid()) {
+        std::cerr << "Error : gzip compression could not be initialized" << std::endl;
+        releaseGzip();
+        return false;
+    }
+    response.removeHeader("Content-Length");
+    response.setHeader("Content-Encoding", "gzip");
+    if (chunked) {
+        response.setHeader("Transfer-Encoding", "chunked");
+    } else {
+        shouldCloseAfterSend_ = true;
+    }
+    gzipChunked_ = chunked;
+    return true;
+}
+
+/**
+ * Compresses the next pieces of the body in sendBuffer_ (which has been sent entirely), until deflate gives some 
+ * bytes : it keeps them while its window fills. At the end of the body, the gzip trailer and the last chunk are queued.
+ * Only GZIP_CHUNK_SIZE bytes of the body are read at once.
+ *
+ * @return false if the body can't be read (file shorter than announced) or compressed.
+ */
+bool DataSocket::produceGzipBody() {
+    sendBuffer_.clear();
+    sendBufferOffset_ = 0;
+    std::string compressed;
+    while (compressed.empty()) {
+        if (sendFileRemaining_ > 0) {
+            char buffer[GZIP_CHUNK_SIZE];
+            size_t length = std::min(sendFileRemaining_, sizeof(buffer));
+            ssize_t bytesRead = pread(sendFileFd_, buffer, length, sendFileOffset_);
+            if (bytesRead <= 0) {
+                return false;
+            }
+            sendFileOffset_ += bytesRead;
+            sendFileRemaining_ -= bytesRead;
+            if (!gzipEncoder_->compress(buffer, bytesRead, compressed, false)) {
+                return false;
+            }
+        } else if (gzipSourceOffset_ < gzipSource_.size()) {
+            size_t length = std::min(gzipSource_.size() - gzipSourceOffset_, GZIP_CHUNK_SIZE);
+            if (!gzipEncoder_->compress(gzipSource_.data() + gzipSourceOffset_, length, compressed, false)) {
+                return false;
+            }
+            gzipSourceOffset_ += length;
+        } else {
+            // End of the body
+            if (!gzipEncoder_->finish(compressed)) {
+                return false;
+            }
+            appendBodyChunk(compressed.data(), compressed.size(), gzipChunked_);
+            if (gzipChunked_) {
+                sendBuffer_.append("0\r\n\r\n");
+            }
+            releaseGzip();
+            closeSendFile();
+            return true;
+        }
+    }
+    appendBodyChunk(compressed.data(), compressed.size(), gzipChunked_);
+    return true;
+}
+
+void DataSocket::releaseGzip() {
+    if (gzipEncoder_) {
+        delete gzipEncoder_;
+        gzipEncoder_ = NULL;
+    }
+    gzipBodyPending_ = false;
+    std::string().swap(gzipSource_);
+    gzipSourceOffset_ = 0;
+}
+
 bool DataSocket::hasDataToSend() const {
-    return !sendBuffer_.empty();
+    return sendBufferOffset_ < sendBuffer_.size() || sendFileRemaining_ > 0 || sharedResponse_ != NULL || gzipBodyPending_;
 }
 
 void DataSocket::closeSocket() {
@@ -161,81 +603,455 @@ int DataSocket::getSocket() const {
     return client_fd_;
 }
 
+const std::string& DataSocket::getRemoteAddress() const {
+    return remoteAddress_;
+}
+
+uint16_t DataSocket::getRemotePort() const {
+    return remotePort_;
+}
+
 time_t DataSocket::getLastActivityTime() const {
     return lastActivityTime_;
 }
 
+/**
+ * Checks the inactivity of the connection. Between two requests of a persistent connection, the 
+ * keepalive_timeout applies, otherwise (request being received, response being produced) SOCKET_INACTIVITY_TIMEOUT.
+ */
+bool DataSocket::hasTimedOut(time_t currentTime) const {
+    return currentTime >= getTimeoutDeadline();
+}
+
+// First second at which the connection has been inactive for longer than its current timeout
+time_t DataSocket::getTimeoutDeadline() const {
+    time_t timeout = SOCKET_INACTIVITY_TIMEOUT;
+    if (requestsCount_ > 0 && !httpRequest_.hasPendingData() && !hasDataToSend() && !isWaitingForBackend()) {
+        timeout = config_->getKeepaliveTimeout();
+    }
+    return lastActivityTime_ + timeout + 1;
+}
+
 
 // CGI handling methods
+
+// The pipes of the CGI are unregistered by `watcher` before they are closed
+void DataSocket::setCgiPipeWatcher(CgiPipeWatcher* watcher) {
+    cgiPipeWatcher_ = watcher;
+}
+
 bool DataSocket::hasCgiProcess() const {
     return cgiProcess_ != NULL;
 }
 
+// The response is being produced by a CGI process or a FastCGI responder
+bool DataSocket::isWaitingForBackend() const {
+    return cgiProcess_ != NULL || fastCgiActive_;
+}
+
+pid_t DataSocket::getCgiPid() const {
+    if (cgiProcess_) {
+        return cgiProcess_->getPid();
+    }
+    return -1;
+}
+
 int DataSocket::getCgiPipeFd() const {
     return cgiPipeFd_;
 }
 
+int DataSocket::getCgiInputFd() const {
+    if (cgiProcess_) {
+        return cgiProcess_->getInputPipeFd();
+    }
+    return -1;
+}
+
+/**
+ * Writes the next part of the request body to the CGI stdin (non-blocking pipe, called when it is writable).
+ * The pipe is closed once the whole body has been written, so the CGI reads EOF.
+ * 
+ * @return false if the CGI closed its stdin before the end of the body.
+ */
+bool DataSocket::writeToCgiInput() {
+    int inputFd = getCgiInputFd();
+    if (inputFd == -1) {
+        return false;
+    }
+    if (!wantsCgiInput()) {
+        // The rest of the body has not been received yet
+        return true;
+    }
+    ssize_t bytesWritten = write(inputFd, cgiInputBuffer_.data() + cgiInputOffset_, cgiInputBuffer_.size() - cgiInputOffset_);
+    if (bytesWritten < 0 && isRetryableIoError(errno)) {
+        // Pipe full : written when it is writable again
+        return true;
+    }
+    if (bytesWritten <= 0) {
+        // The CGI does not read its stdin anymore (EPIPE), its output is still read
+        closeCgiInput();
+        return false;
+    }
+    lastActivityTime_ = TimerWheel::currentTime();
+    cgiInputOffset_ += bytesWritten;
+    if (cgiInputOffset_ >= cgiInputBuffer_.size() && cgiInputComplete_) {
+        closeCgiInput();
+    }
+    return true;
+}
+
+// CGI stdin : watched while part of the body waits to be written
+bool DataSocket::wantsCgiInput() const {
+    return cgiInputOffset_ < cgiInputBuffer_.size();
+}
+
+// Next piece of a streamed body (CgiInputSink) : dropped if the CGI does not read its stdin anymore
+void DataSocket::appendCgiInput(const char* data, size_t length) {
+    bool inputOpen = cgiProcess_ ? getCgiInputFd() != -1 : fastCgiActive_;
+    if (!inputOpen) {
+        return;
+    }
+    // The part already written is dropped so the buffer never holds more than the pending bytes
+    if (cgiInputOffset_ > 0) {
+        cgiInputBuffer_.erase(0, cgiInputOffset_);
+        cgiInputOffset_ = 0;
+    }
+    cgiInputBuffer_.append(data, length);
+}
+
+// End of a streamed body : the CGI stdin is closed once everything has been written, so the script reads EOF
+// (the FastCGI connection ends the STDIN stream once it has taken everything)
+void DataSocket::finishCgiInput() {
+    cgiInputComplete_ = true;
+    if (!wantsCgiInput()) {
+        closeCgiInput();
+    }
+}
+
+void DataSocket::closeCgiInput() {
+    if (cgiProcess_) {
+        if (cgiPipeWatcher_ && cgiProcess_->getInputPipeFd() != -1) {
+            cgiPipeWatcher_->unwatchCgiPipe(this, cgiProcess_->getInputPipeFd());
+        }
+        cgiProcess_->closeInputPipe();
+    }
+    std::string().swap(cgiInputBuffer_);
+    cgiInputOffset_ = 0;
+}
+
 bool DataSocket::isCgiComplete() const {
     return cgiComplete_;
 }
 
+/**
+ * Reads the next part of the CGI output. The header block is parsed first, then the body is relayed to
+ * the client as soon as it is read : nothing waits for the end of the script.
+ * The pipe is not watched while the client is slower than the CGI (see wantsCgiOutput()).
+ *
+ * @return false once the CGI output is over (EOF or error).
+ */
 bool DataSocket::readFromCgiPipe() {
     // std::cout << RED << "DataSocket::readFromCgiPipe()" << RESET << std::endl;
     
-    char buffer[4096];
+    char buffer[CGI_READ_BUFFER_SIZE];
     ssize_t bytesRead = read(cgiPipeFd_, buffer, sizeof(buffer));
 
     if (bytesRead > 0) {
-        lastActivityTime_ = time(NULL);
-        cgiOutputBuffer_.append(buffer, bytesRead);
-        // std::cout << BLUE << "CGI added buffer: " << std::string(buffer, bytesRead) << RESET << std::endl;
+        if (!appendCgiOutput(buffer, bytesRead)) {
+            terminateCgiProcess(502);
+            return false;
+        }
         return true;
     } else if (bytesRead == 0) {
-        handleCgiProcessExitStatus();
+        // The response is ended once the exit status is known : the process may not have been reaped yet
+        closeCgiPipe();
+        if (cgiProcess_->hasExited()) {
+            endCgiProcess();
+        }
         return false;
-    }else{
-        // std::cerr << "CGI Gateway : Error occured while reading on cgi Pipe" << std::endl;//Debug
+    } else if (isRetryableIoError(errno)) {
+        // Nothing to read yet (non-blocking pipe) : read again at the next readiness
+        return true;
+    } else {
         terminateCgiProcess(502);
         return false;
     }
 }
 
+/**
+ * Takes the next part of the output of a CGI (stdout pipe or FastCGI STDOUT records). The header block 
+ * is parsed first, then the body is relayed to the client as soon as it is received.
+ *
+ * @return false if the header block is invalid (too long).
+ */
+bool DataSocket::appendCgiOutput(const char* data, size_t length) {
+    lastActivityTime_ = TimerWheel::currentTime();
+    if (cgiResponseStarted_) {
+        appendCgiBody(data, length);
+        return true;
+    }
+    cgiOutputBuffer_.append(data, length);
+    // std::cout << BLUE << "CGI added buffer: " << std::string(data, length) << RESET << std::endl;
+    return parseCgiHeaders(false);
+}
+
+// Field names of the CGI header block (RFC 3875) : a line like "<html>" means the script sent no header
+static bool isCgiHeaderName(const std::string& name) {
+    if (name.empty()) {
+        return false;
+    }
+    for (size_t i = 0; i < name.size(); ++i) {
+        char c = name[i];
+        if (!isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_') {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Looks for the CGI header block at the beginning of cgiOutputBuffer_ and starts the response once it is
+ * complete. Output that does not begin with a header line is relayed as is (text/html).
+ *
+ * @param atEof true when the CGI output is over : an unfinished header block is used as it is.
+ * @return false if the header block is too long.
+ */
+bool DataSocket::parseCgiHeaders(bool atEof) {
+    size_t lineEnd = cgiOutputBuffer_.find('\n');
+    std::string firstLine = cgiOutputBuffer_.substr(0, lineEnd);
+    size_t colon = firstLine.find(':');
+
+    if (colon == std::string::npos || !isCgiHeaderName(firstLine.substr(0, colon))) {
+        // "Content-Ty" : may still become a header line
+        if (!atEof && lineEnd == std::string::npos && colon == std::string::npos && isCgiHeaderName(firstLine)
+            && cgiOutputBuffer_.size() < MAX_CGI_HEADERS_LENGTH) {
+            return true;
+        }
+        HttpResponse response;
+        response.setHeader("Content-Type", "text/html; charset=UTF-8");
+        startCgiResponse(response, 0);
+        return true;
+    }
+
+    // The header block ends with an empty line ("\n\n" or "\r\n\r\n")
+    size_t headersEnd = std::string::npos;
+    size_t bodyStart = cgiOutputBuffer_.size();
+    for (size_t pos = cgiOutputBuffer_.find('\n'); pos != std::string::npos; pos = cgiOutputBuffer_.find('\n', pos + 1)) {
+        size_t next = pos + 1;
+        if (next < cgiOutputBuffer_.size() && cgiOutputBuffer_[next] == '\r') {
+            ++next;
+        }
+        if (next < cgiOutputBuffer_.size() && cgiOutputBuffer_[next] == '\n') {
+            headersEnd = pos;
+            bodyStart = next + 1;
+            break;
+        }
+    }
+    if (headersEnd == std::string::npos) {
+        if (cgiOutputBuffer_.size() >= MAX_CGI_HEADERS_LENGTH) {
+            std::cerr << "CGI Gateway : CGI header block is too long." << std::endl;
+            return false;
+        }
+        if (!atEof) {
+            return true;
+        }
+        headersEnd = cgiOutputBuffer_.size();
+    }
+
+    HttpResponse response;
+    response.setHeader("Content-Type", "text/html; charset=UTF-8");
+    bool hasStatus = false;
+    bool hasLocation = false;
+    size_t lineStart = 0;
+    while (lineStart < headersEnd) {
+        size_t end = cgiOutputBuffer_.find('\n', lineStart);
+        if (end == std::string::npos || end > headersEnd) {
+            end = headersEnd;
+        }
+        std::string line = cgiOutputBuffer_.substr(lineStart, end - lineStart);
+        lineStart = end + 1;
+        if (!line.empty() && line[line.size() - 1] == '\r') {
+            line.erase(line.size() - 1);
+        }
+        colon = line.find(':');
+        if (colon == std::string::npos) {
+            continue;
+        }
+        std::string name = line.substr(0, colon);
+        std::string value = line.substr(colon + 1);
+        size_t valueStart = value.find_first_not_of(" \t");
+        value = (valueStart == std::string::npos) ? "" : value.substr(valueStart);
+        std::string lowerName = name;
+        for (size_t i = 0; i < lowerName.size(); ++i) {
+            lowerName[i] = tolower(static_cast<unsigned char>(lowerName[i]));
+        }
+
+        if (lowerName == "status") {
+            // "Status: 404 Not Found"
+            int code = atoi(value.c_str());
+            if (code >= 100 && code <= 599) {
+                response.setStatusCode(code);
+                size_t phraseStart = value.find(' ');
+                if (phraseStart != std::string::npos && phraseStart + 1 < value.size()) {
+                    response.setReasonPhrase(value.substr(phraseStart + 1));
+                }
+                hasStatus = true;
+            }
+        } else if (lowerName == "content-type") {
+            response.setHeader("Content-Type", value);
+        } else if (lowerName == "location") {
+            response.setHeader("Location", value);
+            hasLocation = true;
+        } else if (lowerName != "content-length" && lowerName != "transfer-encoding" && lowerName != "connection") {
+            // The framing of the body is chosen by the server
+            response.setHeader(name, value);
+        }
+    }
+    if (hasLocation && !hasStatus) {
+        response.setStatusCode(302);
+    }
+    startCgiResponse(response, bodyStart);
+    return true;
+}
+
+/**
+ * Queues the response head built from the CGI headers, followed by the body already read.
+ * The length of the body is unknown : HTTP/1.1 clients get it chunked, older clients until the connection closes.
+ * In a `gzip on` location, the output is compressed if its Content-Type is in gzip_types.
+ */
+void DataSocket::startCgiResponse(HttpResponse& response, size_t bodyStart) {
+    RequestHandler::prepareGzip(cgiLocation_, cgiAcceptsGzip_, response, -1);
+    if (cgiChunked_) {
+        response.setHeader("Transfer-Encoding", "chunked");
+    } else {
+        shouldCloseAfterSend_ = true;
+    }
+    queueResponse(response);
+    cgiResponseStarted_ = true;
+    if (bodyStart < cgiOutputBuffer_.size()) {
+        appendCgiBody(cgiOutputBuffer_.data() + bodyStart, cgiOutputBuffer_.size() - bodyStart);
+    }
+    std::string().swap(cgiOutputBuffer_);
+}
+
+void DataSocket::appendCgiBody(const char* data, size_t length) {
+    if (length == 0 || headRequest_) {
+        return;
+    }
+    if (gzipEncoder_) {
+        // Flushed : the client gets everything the script has produced so far
+        std::string compressed;
+        if (!gzipEncoder_->compress(data, length, compressed, true)) {
+            shouldCloseAfterSend_ = true;
+            return;
+        }
+        appendBodyChunk(compressed.data(), compressed.size(), cgiChunked_);
+        return;
+    }
+    appendBodyChunk(data, length, cgiChunked_);
+}
+
+// Appends a piece of body to sendBuffer_, as a chunk if the response is chunked
+void DataSocket::appendBodyChunk(const char* data, size_t length, bool chunked) {
+    if (length == 0) {
+        return;
+    }
+    // The part already sent is dropped so the buffer never holds more than the pending bytes
+    if (sendBufferOffset_ > 0) {
+        sendBuffer_.erase(0, sendBufferOffset_);
+        sendBufferOffset_ = 0;
+    }
+    if (chunked) {
+        std::ostringstream chunkSize;
+        chunkSize << std::hex << length << "\r\n";
+        sendBuffer_.append(chunkSize.str());
+    }
+    sendBuffer_.append(data, length);
+    if (chunked) {
+        sendBuffer_.append("\r\n");
+    }
+}
+
+// The response may be over with nothing left to send (HEAD of a CGI) : a pipelined request is parsed now
+void DataSocket::parseAfterBackend() {
+    if (!hasDataToSend() && !shouldCloseAfterSend_) {
+        lastActivityTime_ = TimerWheel::currentTime();
+        parseReceivedData();
+    }
+}
+
+// Backpressure : the CGI pipe is not read while too much of its output waits to be sent to the client
+bool DataSocket::wantsCgiOutput() const {
+    return sendBuffer_.size() - sendBufferOffset_ < CGI_OUTPUT_HIGH_WATER_MARK;
+}
+
+// Checks how the CGI process ended, then ends the response
 void    DataSocket::handleCgiProcessExitStatus()
 {
     // std::cout << YELLOW<< "DataSocket::handleCgiProcessExitStatus"<< RESET << std::endl;
+    if (!cgiProcess_) {
+        return;
+    }
     int status = cgiProcess_->getExitStatus();
-    if(cgiProcess_ && status){
+    bool failed = false;
+    if(status){
+        failed = true;
         // Vérify exit status
         if (WIFEXITED(status)) {
-            int exitStatus = WEXITSTATUS(status);
-            if (exitStatus != 0) {
-                std::cerr << "CGI Gateway : CGI process exited with error code: " << exitStatus << std::endl;
-                HttpResponse response = handleError(502, getAssociatedServer()->getErrorPageFullPath(502));
-                sendBuffer_ = response.generateResponse();
-                sendBufferOffset_ = 0;
-            } 
+            std::cerr << "CGI Gateway : CGI process exited with error code: " << WEXITSTATUS(status);
         } else if (WIFSIGNALED(status)) {
-            std::cerr << "CGI Gateway : CGI process was terminated by a signal." << std::endl;
-            HttpResponse response = handleError(502, getAssociatedServer()->getErrorPageFullPath(502));
-            sendBuffer_ = response.generateResponse();
-            sendBufferOffset_ = 0;
+            std::cerr << "CGI Gateway : CGI process was terminated by a signal.";
         } else {
-            std::cerr << "CGI Gateway : CGI process terminated abnormally." << std::endl;
-            HttpResponse response = handleError(502, getAssociatedServer()->getErrorPageFullPath(502));
-            sendBuffer_ = response.generateResponse();
-            sendBufferOffset_ = 0;
+            std::cerr << "CGI Gateway : CGI process terminated abnormally.";
         }
+        const struct rusage& usage = cgiProcess_->getResourceUsage();
+        long cpuMs = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000L
+                     + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000;
+        std::cerr << " (cpu " << cpuMs << " ms, max rss " << usage.ru_maxrss << " kB)" << std::endl;
+    }
+
+    finishCgiOutput(failed);
+}
+
+/**
+ * Ends the response once the output of the CGI is over. An error can only be reported if nothing has been
+ * sent yet, otherwise the response is cut (no last chunk) and the connection closed.
+ */
+void DataSocket::finishCgiOutput(bool failed) {
+    if (!cgiResponseStarted_ && (failed || !parseCgiHeaders(true))) {
+        HttpResponse response = handleError(502, getAssociatedServer()->getErrorPageFullPath(502), &config_->getErrorPageCache());
+        queueResponse(response);
+    } else if (failed) {
+        shouldCloseAfterSend_ = true;
     } else {
-        // CGI ended successfully
-        HttpResponse response;
-        response.setStatusCode(200);
-        response.setBody(cgiOutputBuffer_);
-        response.setHeader("Content-Type", "text/html; charset=UTF-8");
-        response.setHeader("Connection", "close");
-        sendBuffer_ = response.generateResponse();
-        sendBufferOffset_ = 0;
-        cgiOutputBuffer_.clear();
+        // CGI ended successfully : end of the gzip stream, last chunk
+        bool complete = true;
+        if (gzipEncoder_) {
+            std::string compressed;
+            complete = gzipEncoder_->finish(compressed);
+            appendBodyChunk(compressed.data(), compressed.size(), cgiChunked_);
+        }
+        if (!complete) {
+            shouldCloseAfterSend_ = true;
+        } else if (cgiChunked_ && !headRequest_) {
+            sendBuffer_.append("0\r\n\r\n");
+        }
+    }
+    releaseGzip();
+    std::string().swap(cgiOutputBuffer_);
+}
+
+// The CGI could not produce (or finish) its response : error page, or cut response if it has started
+void DataSocket::failCgiOutput(int errorCode) {
+    if (cgiResponseStarted_) {
+        // Part of the body has already been sent : the client can only see a truncated response
+        shouldCloseAfterSend_ = true;
+        releaseGzip();
+    } else {
+        HttpResponse response = handleError(errorCode, getAssociatedServer()->getErrorPageFullPath(errorCode), &config_->getErrorPageCache());
+        queueResponse(response);
     }
+    std::string().swap(cgiOutputBuffer_);
 }
 
 bool DataSocket::cgiProcessIsRunning() const {
@@ -252,25 +1068,130 @@ bool DataSocket::cgiProcessHasTimedOut() const {
     return false;
 }
 
+time_t DataSocket::getCgiDeadline() const {
+    if (cgiProcess_) {
+        return cgiProcess_->getDeadline();
+    }
+    return 0;
+}
+
 void DataSocket::terminateCgiProcess(int errorCode) {
     if (cgiProcess_) {
         cgiProcess_->terminate();
-        closeCgiPipe();
-        HttpResponse response = handleError(errorCode, getAssociatedServer()->getErrorPageFullPath(errorCode));
-        sendBuffer_ = response.generateResponse();
-        sendBufferOffset_ = 0;
-        cgiOutputBuffer_.clear();
+        releaseCgiProcess();
+        failCgiOutput(errorCode);
+    }
+}
+
+/**
+ * Called by the event loop when a child of the worker has been reaped.
+ *
+ * @return false if the pid is not the one of the CGI of this DataSocket (a CGI killed before, ...).
+ */
+bool DataSocket::handleCgiExit(pid_t pid, int status, const struct rusage& usage) {
+    if (!cgiProcess_ || cgiProcess_->getPid() != pid) {
+        return false;
+    }
+    cgiProcess_->setExitStatus(status, usage);
+    // Its output has already been read until EOF
+    if (cgiComplete_) {
+        endCgiProcess();
     }
+    return true;
+}
+
+// Output read until EOF and process reaped : the response is ended
+void DataSocket::endCgiProcess() {
+    handleCgiProcessExitStatus();
+    releaseCgiProcess();
+    parseAfterBackend();
 }
 
+// Response over (or cut) and fully sent : nothing else will happen on this connection
+bool DataSocket::isFinished() const {
+    return shouldCloseAfterSend_ && !hasDataToSend() && !isWaitingForBackend();
+}
+
+// No more output to read from the CGI (EOF, or given up) : the process itself may still be running
 void DataSocket::closeCgiPipe() {
-    if (cgiPipeFd_ != -1) {
-        close(cgiPipeFd_);
-        cgiPipeFd_ = -1;
+    if (cgiProcess_) {
+        if (cgiPipeWatcher_ && cgiPipeFd_ != -1) {
+            cgiPipeWatcher_->unwatchCgiPipe(this, cgiPipeFd_);
+        }
+        cgiProcess_->closeOutputPipe();
     }
+    cgiPipeFd_ = -1;
+    cgiComplete_ = true;
+}
+
+// The CGI is over, killed, or still running and killed now : it is forgotten, the ChildReaper of the worker reaps it
+void DataSocket::releaseCgiProcess() {
+    closeCgiPipe();
+    closeCgiInput();
     if (cgiProcess_) {
+        cgiProcess_->terminate();
         delete cgiProcess_;
         cgiProcess_ = NULL;
     }
-    cgiComplete_ = true;
-}
\ No newline at end of file
+}
+
+
+// FastCGI handling methods
+bool DataSocket::hasFastCgiRequest() const {
+    return fastCgiActive_;
+}
+
+const std::string& DataSocket::getFastCgiPass() const {
+    return fastCgiPass_;
+}
+
+const std::vector<std::string>& DataSocket::getFastCgiParams() const {
+    return fastCgiParams_;
+}
+
+// Part of the request body, or its end, waits to be taken by the FastCGI connection
+bool DataSocket::hasCgiInput() const {
+    return wantsCgiInput() || cgiInputComplete_;
+}
+
+/**
+ * Hands the part of the request body received so far over to the FastCGI connection (STDIN records).
+ * The connection only takes it once it has written the previous part : the client is not read meanwhile.
+ *
+ * @return true once the whole body has been taken.
+ */
+bool DataSocket::takeCgiInput(std::string& input) {
+    if (cgiInputOffset_ > 0) {
+        cgiInputBuffer_.erase(0, cgiInputOffset_);
+        cgiInputOffset_ = 0;
+    }
+    input.clear();
+    input.swap(cgiInputBuffer_);
+    return cgiInputComplete_;
+}
+
+/**
+ * Called by the FastCGI connection once the responder ended the request (FCGI_END_REQUEST).
+ *
+ * @param failed true if the application exited with an error or the request was rejected by the responder.
+ */
+void DataSocket::finishFastCgiRequest(bool failed) {
+    if (!fastCgiActive_) {
+        return;
+    }
+    fastCgiActive_ = false;
+    finishCgiOutput(failed);
+    std::vector<std::string>().swap(fastCgiParams_);
+    parseAfterBackend();
+}
+
+// The request could not be handled by the FastCGI pool (queue full, responder unreachable, timeout ...)
+void DataSocket::failFastCgiRequest(int errorCode) {
+    if (!fastCgiActive_) {
+        return;
+    }
+    fastCgiActive_ = false;
+    failCgiOutput(errorCode);
+    std::vector<std::string>().swap(fastCgiParams_);
+    closeCgiInput();
+}
@@ -9,27 +9,32 @@ DataSocketHandler::~DataSocketHandler() {
 }
 
 void DataSocketHandler::addClientSocket(DataSocket* dataSocket) {
-    clientSockets.push_back(dataSocket);
+    clientSockets.insert(dataSocket);
 }
 
-void DataSocketHandler::removeClosedSockets() {
-    for (std::vector<DataSocket*>::iterator it = clientSockets.begin(); it != clientSockets.end(); ) {
-    if ((*it)->getSocket() == -1) {
-        delete *it;
-        it = clientSockets.erase(it);
-    } else {
-        ++it;
+// Closes a socket and queues it for deletion : the event loop may still use it until the end of the iteration
+void DataSocketHandler::closeClientSocket(DataSocket* dataSocket) {
+    dataSocket->closeSocket();
+    if (clientSockets.erase(dataSocket) > 0) {
+        closedSockets.push_back(dataSocket);
     }
 }
+
+void DataSocketHandler::removeClosedSockets() {
+    for (size_t i = 0; i < closedSockets.size(); ++i) {
+        delete closedSockets[i];
+    }
+    closedSockets.clear();
 }
 
-const std::vector<DataSocket*>& DataSocketHandler::getClientSockets() const {
+const std::set<DataSocket*>& DataSocketHandler::getClientSockets() const {
     return clientSockets;
 }
 
 void DataSocketHandler::cleanUp() {
-    for (size_t i = 0; i < clientSockets.size(); ++i) {
-        delete clientSockets[i];
+    removeClosedSockets();
+    for (std::set<DataSocket*>::iterator it = clientSockets.begin(); it != clientSockets.end(); ++it) {
+        delete *it;
     }
     clientSockets.clear();
 }
@@ -0,0 +1,102 @@
+// EpollMultiplexer.cpp
+#include "EpollMultiplexer.hpp"
+
+#ifdef __linux__
+# include <unistd.h>
+# include <cstring>
+# include <cerrno>
+# include <stdexcept>
+
+// Initial size of the ready list, grows with the number of registered fds
+const size_t EPOLL_INITIAL_EVENTS = 64;
+
+EpollMultiplexer::EpollMultiplexer() : epollFd_(-1), registeredCount_(0), epollEvents_(EPOLL_INITIAL_EVENTS) {
+    epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd_ == -1) {
+        throw std::runtime_error(std::string("Error creating epoll instance: ") + strerror(errno));
+    }
+}
+
+EpollMultiplexer::~EpollMultiplexer() {
+    if (epollFd_ != -1) {
+        close(epollFd_);
+    }
+}
+
+uint32_t EpollMultiplexer::toEpollEvents(unsigned int events) {
+    uint32_t epollEvents = 0;
+    if (events & EVENT_READ)
+        epollEvents |= EPOLLIN;
+    if (events & EVENT_WRITE)
+        epollEvents |= EPOLLOUT;
+    return epollEvents;
+}
+
+bool EpollMultiplexer::addFd(int fd, unsigned int events) {
+    struct epoll_event ev;
+    std::memset(&ev, 0, sizeof(ev));
+    ev.events = toEpollEvents(events);
+    ev.data.fd = fd;
+    if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        if (errno == EEXIST) {
+            return modifyFd(fd, events);
+        }
+        return false;
+    }
+    ++registeredCount_;
+    if (registeredCount_ > epollEvents_.size()) {
+        epollEvents_.resize(epollEvents_.size() * 2);
+    }
+    return true;
+}
+
+bool EpollMultiplexer::modifyFd(int fd, unsigned int events) {
+    struct epoll_event ev;
+    std::memset(&ev, 0, sizeof(ev));
+    ev.events = toEpollEvents(events);
+    ev.data.fd = fd;
+    return epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd, &ev) == 0;
+}
+
+/**
+ * Removes a fd from the epoll set. If the fd has already been closed the kernel dropped it by itself
+ * (EBADF / ENOENT), only our counter needs to be updated.
+ */
+void EpollMultiplexer::removeFd(int fd) {
+    struct epoll_event ev;
+    std::memset(&ev, 0, sizeof(ev));
+    epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, &ev);
+    if (registeredCount_ > 0) {
+        --registeredCount_;
+    }
+}
+
+int EpollMultiplexer::waitEvents(std::vector<IoEvent>& readyEvents, int timeoutMs) {
+    readyEvents.clear();
+    int ret = epoll_wait(epollFd_, &epollEvents_[0], static_cast<int>(epollEvents_.size()), timeoutMs);
+    if (ret <= 0) {
+        return ret;
+    }
+    for (int i = 0; i < ret; ++i) {
+        uint32_t revents = epollEvents_[i].events;
+        IoEvent event;
+        event.fd = epollEvents_[i].data.fd;
+        event.events = 0;
+        if (revents & EPOLLIN)
+            event.events |= EVENT_READ;
+        if (revents & EPOLLOUT)
+            event.events |= EVENT_WRITE;
+        if (revents & (EPOLLHUP | EPOLLRDHUP))
+            event.events |= EVENT_HANGUP;
+        if (revents & EPOLLERR)
+            event.events |= EVENT_ERROR;
+        readyEvents.push_back(event);
+    }
+    return ret;
+}
+
+const char* EpollMultiplexer::getName() const {
+    return "epoll";
+}
+
+#endif // __linux__
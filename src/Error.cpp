@@ -6,57 +6,70 @@
 #include "HttpResponse.hpp"
 #include "Color_Macros.hpp"
 #include <sys/stat.h> 
+#include <unistd.h>
+#include "ErrorPageCache.hpp"
+
+// Reads a whole error page, false if it is missing, not a regular file, or unreadable
+bool readErrorPage(const std::string &errorPagePath, std::string &content)
+{
+    struct stat pathStat;
+    if (stat(errorPagePath.c_str(), &pathStat) != 0 || S_ISDIR(pathStat.st_mode)) {
+        // Path access error, or a directory : treated as if error file not found
+        return false;
+    }
+    std::ifstream errorFile(errorPagePath.c_str(), std::ios::in | std::ios::binary);
+    if (!errorFile.is_open()) {
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << errorFile.rdbuf();
+    content = buffer.str();
+    return true;
+}
 
 /**
  * Handles the creation of an error HTTP response with a specified status code and error page.
  * 
  * This function generates an HTTP response based on the given status code and the path to an error page.
-//  * If the error page path is provided and valid, the content of the error page is read and used in the response body.
+ * If the error page path is provided and valid, the content of the error page is read and used in the response body.
  * If the error page path is invalid (file does not exist, insufficient permissions, or is a directory), a default error message is used.
- * If no error page path is provided, a default error message corresponding to the status code is used.
+ * If no error page path is provided, the same default error message is used.
+ * The error pages of the configuration (and the default responses) are preloaded in the ErrorPageCache : their 
+ * serialized response is shared by reference, without filesystem I/O nor copy.
  * 
- * The function also sets the necessary headers for the error response, including the "Content-Type" as "text/html" and "Connection" as "close".
+ * The function also sets the necessary headers for the error response, including the "Content-Type" as "text/html".
+ * The "Connection" header is set by the DataSocket, according to the keep-alive state of the connection.
  * 
- * @param statusCode    The HTTP status code for the error (e.g., 404 for Not Found, 500 for Internal Server Error).
- * @param errorPagePath The path to a custom error page. If empty or invalid, a default error message is generated.
- * @return              The HTTP response object with the appropriate error status, message, and headers.
+ * @param statusCode     The HTTP status code for the error (e.g., 404 for Not Found, 500 for Internal Server Error).
+ * @param errorPagePath  The path to a custom error page. If empty or invalid, a default error message is generated.
+ * @param errorPageCache The error pages preloaded with the configuration, NULL to read the page from the filesystem.
+ * @return               The HTTP response object with the appropriate error status, message, and headers.
  */
-
-HttpResponse handleError(int statusCode, const std::string &errorPagePath) 
+HttpResponse handleError(int statusCode, const std::string &errorPagePath, const ErrorPageCache* errorPageCache) 
 {
     // std::cout << RED <<"error page path : "<< errorPagePath << RESET << std::endl; // Debug
     HttpResponse response;
     response.setStatusCode(statusCode);
 
-    if (!errorPagePath.empty()) {
-        struct stat pathStat;
-        if (stat(errorPagePath.c_str(), &pathStat) != 0) {
-            // Path access error (file does not exist or insufficient permissions)
-            response.setBody("Error " + toString(statusCode));
-        } else if (S_ISDIR(pathStat.st_mode)) {
-            // Path is a directory, treat as if error file not found
-            response.setBody("Error " + toString(statusCode));
-        } else {
-            // The path is a regular file, try to open it
-            std::ifstream errorFile(errorPagePath.c_str(), std::ios::in | std::ios::binary);
-            if (errorFile.is_open()) {
-                std::stringstream buffer;
-                buffer << errorFile.rdbuf();
-                std::string errorContent = buffer.str();
-                errorFile.close();
-                response.setBody(errorContent);
-            } else {
-                response.setBody("Error " + toString(statusCode));
-            }
+    if (errorPageCache != NULL) {
+        size_t headerLength;
+        SharedBuffer* preloaded = errorPageCache->find(statusCode, errorPagePath, headerLength);
+        if (preloaded != NULL) {
+            response.setSharedResponse(preloaded, headerLength);
+            return response;
         }
+    }
+
+    std::string errorContent;
+    if (!errorPagePath.empty() && readErrorPage(errorPagePath, errorContent)) {
+        response.setBody(errorContent);
     } else {
         // std::cout << "Default error message is used instead of an error page" << std::endl; // Debug
-        response.setBody(response.getDefaultReasonPhrase(statusCode));
+        response.setBody("Error " + toString(statusCode));
     }
 
     // Prepare error HTTP headers
     response.setHeader("Content-Type", "text/html; charset=UTF-8");
-    response.setHeader("Connection", "close");
 
     return response;
 }
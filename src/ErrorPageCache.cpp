@@ -0,0 +1,125 @@
+// ErrorPageCache.cpp
+#include "ErrorPageCache.hpp"
+#include "Config.hpp"
+#include "Error.hpp"
+#include "Utils.hpp"
+#include "HttpResponse.hpp"
+#include <iostream>
+
+// Errors answered by the server itself : their default response is serialized too, for the contexts without error_page
+static const int DEFAULT_ERROR_CODES[] = { 400, 403, 404, 405, 408, 411, 413, 414, 415, 416, 500, 501, 502, 503, 504, 505 };
+
+ErrorPageCache::ErrorPageCache() : responses_() {}
+
+ErrorPageCache::~ErrorPageCache() {
+    clear();
+}
+
+void ErrorPageCache::clear() {
+    for (std::map<Key, Entry>::iterator it = responses_.begin(); it != responses_.end(); ++it) {
+        it->second.response->release();
+    }
+    responses_.clear();
+}
+
+// Codes with an error_page in one of the contexts a page is looked up from (location > server > global)
+static void collectStatusCodes(const std::map<int, std::string>& errorPages, std::map<int, bool>& statusCodes) {
+    for (std::map<int, std::string>::const_iterator it = errorPages.begin(); it != errorPages.end(); ++it) {
+        statusCodes[it->first] = true;
+    }
+}
+
+/**
+ * Builds the error response of every (status code, full path) that RequestHandler::getErrorPageFullPath() and the
+ * DataSocket can ask for. Replaces the responses of a previous load.
+ *
+ * @param config The parsed configuration.
+ */
+void ErrorPageCache::load(const Config& config) {
+    clear();
+    // Page contents (false if unreadable), read once even when they are used by several codes or contexts
+    std::map<std::string, std::pair<bool, std::string> > contents;
+
+    for (size_t i = 0; i < sizeof(DEFAULT_ERROR_CODES) / sizeof(DEFAULT_ERROR_CODES[0]); ++i) {
+        add(DEFAULT_ERROR_CODES[i], "", contents);
+    }
+
+    std::map<int, bool> globalCodes;
+    collectStatusCodes(config.getErrorPages(), globalCodes);
+    for (std::map<int, bool>::const_iterator code = globalCodes.begin(); code != globalCodes.end(); ++code) {
+        add(code->first, config.getErrorPageFullPath(code->first), contents);
+    }
+
+    const std::vector<Server*>& servers = config.getServers();
+    for (size_t i = 0; i < servers.size(); ++i) {
+        std::map<int, bool> serverCodes = globalCodes;
+        collectStatusCodes(servers[i]->getErrorPages(), serverCodes);
+        for (std::map<int, bool>::const_iterator code = serverCodes.begin(); code != serverCodes.end(); ++code) {
+            add(code->first, servers[i]->getErrorPageFullPath(code->first), contents);
+        }
+
+        const std::vector<Location>& locations = servers[i]->getLocations();
+        for (size_t j = 0; j < locations.size(); ++j) {
+            std::map<int, bool> locationCodes = serverCodes;
+            collectStatusCodes(locations[j].getErrorPages(), locationCodes);
+            for (std::map<int, bool>::const_iterator code = locationCodes.begin(); code != locationCodes.end(); ++code) {
+                add(code->first, locations[j].getErrorPageFullPath(code->first), contents);
+            }
+        }
+    }
+    size_t unreadable = 0;
+    for (std::map<std::string, std::pair<bool, std::string> >::const_iterator it = contents.begin(); it != contents.end(); ++it) {
+        unreadable += it->second.first ? 0 : 1;
+    }
+    std::cout << "Info : " << responses_.size() << " error responses preloaded from " << contents.size() << " error pages ("
+              << unreadable << " missing or unreadable, default body used)" << std::endl;
+}
+
+// Response of `handleError()` without cache for this page, read from the filesystem only if not read yet
+void ErrorPageCache::add(int statusCode, const std::string& path, std::map<std::string, std::pair<bool, std::string> >& contents) {
+    Key key(statusCode, path);
+    if (responses_.find(key) != responses_.end()) {
+        return;
+    }
+    std::string body = "Error " + toString(statusCode);
+    if (!path.empty()) {
+        std::map<std::string, std::pair<bool, std::string> >::iterator content = contents.find(path);
+        if (content == contents.end()) {
+            content = contents.insert(std::make_pair(path, std::make_pair(false, std::string()))).first;
+            content->second.first = readErrorPage(path, content->second.second);
+        }
+        if (content->second.first) {
+            body = content->second.second;
+        }
+    }
+    HttpResponse response;
+    response.setStatusCode(statusCode);
+    response.setBody(body);
+    response.setHeader("Content-Type", "text/html; charset=UTF-8");
+
+    std::string serialized = response.generateHeaders();
+    // Without the empty line : the Connection header of each socket goes there
+    serialized.erase(serialized.size() - 2);
+    Entry entry;
+    entry.headerLength = serialized.size();
+    serialized.append(body);
+    entry.response = new SharedBuffer(serialized);
+    responses_.insert(std::make_pair(key, entry));
+}
+
+/**
+ * @param headerLength Set to the length of the status line and headers of the response.
+ * @return The serialized response (not retained : valid until the next load), NULL if it is not preloaded.
+ */
+SharedBuffer* ErrorPageCache::find(int statusCode, const std::string& path, size_t& headerLength) const {
+    std::map<Key, Entry>::const_iterator it = responses_.find(Key(statusCode, path));
+    if (it == responses_.end()) {
+        return NULL;
+    }
+    headerLength = it->second.headerLength;
+    return it->second.response;
+}
+
+size_t ErrorPageCache::size() const {
+    return responses_.size();
+}
@@ -0,0 +1,41 @@
+// EventMultiplexer.cpp
+#include "EventMultiplexer.hpp"
+#include "PollMultiplexer.hpp"
+#include "EpollMultiplexer.hpp"
+#include <stdexcept>
+
+EventMultiplexer::~EventMultiplexer() {}
+
+/**
+ * Creates the multiplexer backend selected in the configuration ("epoll" or "poll").
+ *
+ * @param backend Name of the backend.
+ * @return A new backend, owned by the caller. Throws std::runtime_error if the backend is not available.
+ */
+EventMultiplexer* EventMultiplexer::create(const std::string& backend) {
+#ifdef __linux__
+    if (backend == "epoll") {
+        return new EpollMultiplexer();
+    }
+#endif
+    if (backend == "poll") {
+        return new PollMultiplexer();
+    }
+    throw std::runtime_error("Event backend not available on this system: " + backend);
+}
+
+bool EventMultiplexer::isBackendAvailable(const std::string& backend) {
+#ifdef __linux__
+    if (backend == "epoll")
+        return true;
+#endif
+    return backend == "poll";
+}
+
+std::string EventMultiplexer::getDefaultBackend() {
+#ifdef __linux__
+    return "epoll";
+#else
+    return "poll";
+#endif
+}
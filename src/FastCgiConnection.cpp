@@ -0,0 +1,324 @@
+// FastCgiConnection.cpp
+#include "FastCgiConnection.hpp"
+#include "DataSocket.hpp"
+#include "TimerWheel.hpp"
+#include "Utils.hpp"
+#include "EventMultiplexer.hpp"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+FastCgiConnection::FastCgiConnection(const std::string& socketPath)
+    : fd_(-1), socketPath_(socketPath), connected_(false), client_(NULL), requestsCount_(0),
+      sendBufferOffset_(0), recvOffset_(0), lastActivityTime_(TimerWheel::currentTime()),
+      stdinComplete_(true)
+{
+    timer_.type = TIMER_FASTCGI;
+    timer_.fastCgiConnection = this;
+}
+
+FastCgiConnection::~FastCgiConnection() {
+    if (fd_ != -1) {
+        close(fd_);
+        fd_ = -1;
+    }
+}
+
+/**
+ * Opens a non-blocking connection to the responder. A connection still in progress is completed by
+ * handleWritable(), requests can already be queued in its send buffer.
+ *
+ * @return FASTCGI_OPEN_FAILED if the responder can't be reached (socket missing, connection refused ...),
+ *         FASTCGI_OPEN_RETRY if its listen backlog is full (a Unix socket gives EAGAIN, not EINPROGRESS).
+ */
+FastCgiOpenResult FastCgiConnection::open() {
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socketPath_.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Error : FastCGI socket path is too long: " << socketPath_ << std::endl;
+        return FASTCGI_OPEN_FAILED;
+    }
+    std::memcpy(addr.sun_path, socketPath_.c_str(), socketPath_.size());
+
+    fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd_ == -1) {
+        std::cerr << "Error : FastCGI socket failed: " << strerror(errno) << std::endl;
+        return FASTCGI_OPEN_FAILED;
+    }
+    // Not inherited by the CGI processes
+    if (fcntl(fd_, F_SETFL, O_NONBLOCK) == -1 || fcntl(fd_, F_SETFD, FD_CLOEXEC) == -1) {
+        std::cerr << "Error : FastCGI fcntl failed: " << strerror(errno) << std::endl;
+        close(fd_);
+        fd_ = -1;
+        return FASTCGI_OPEN_FAILED;
+    }
+    if (connect(fd_, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0) {
+        connected_ = true;
+    } else if (errno == EAGAIN) {
+        close(fd_);
+        fd_ = -1;
+        return FASTCGI_OPEN_RETRY;
+    } else if (errno != EINPROGRESS) {
+        std::cerr << "Error : FastCGI connection to " << socketPath_ << " failed: " << strerror(errno) << std::endl;
+        return FASTCGI_OPEN_FAILED;
+    }
+    lastActivityTime_ = TimerWheel::currentTime();
+    return FASTCGI_OPEN_OK;
+}
+
+/**
+ * Serializes the request of a DataSocket : BEGIN_REQUEST (responder role, connection kept open),
+ * the params, then the part of the request body already received as STDIN records (see appendStdin()).
+ * Empty PARAMS / STDIN records end each stream.
+ */
+void FastCgiConnection::startRequest(DataSocket* client) {
+    client_ = client;
+    lastActivityTime_ = TimerWheel::currentTime();
+
+    unsigned char beginRequest[8];
+    std::memset(beginRequest, 0, sizeof(beginRequest));
+    beginRequest[0] = static_cast<unsigned char>(FCGI_RESPONDER >> 8);
+    beginRequest[1] = static_cast<unsigned char>(FCGI_RESPONDER & 0xFF);
+    beginRequest[2] = FCGI_KEEP_CONN;
+    appendRecord(FCGI_BEGIN_REQUEST, reinterpret_cast<const char*>(beginRequest), sizeof(beginRequest));
+
+    std::string params;
+    const std::vector<std::string>& clientParams = client->getFastCgiParams();
+    for (size_t i = 0; i < clientParams.size(); ++i) {
+        std::string::size_type equal = clientParams[i].find('=');
+        if (equal == std::string::npos) {
+            continue;
+        }
+        appendParam(params, clientParams[i].substr(0, equal), clientParams[i].substr(equal + 1));
+    }
+    for (size_t offset = 0; offset < params.size(); offset += FCGI_MAX_CONTENT_LENGTH) {
+        appendRecord(FCGI_PARAMS, params.data() + offset, std::min(FCGI_MAX_CONTENT_LENGTH, params.size() - offset));
+    }
+    appendRecord(FCGI_PARAMS, NULL, 0);
+
+    stdinComplete_ = false;
+    appendStdin();
+}
+
+// Takes the body received so far from the client as STDIN records, and ends the stream once it has all been taken
+void FastCgiConnection::appendStdin() {
+    if (!client_ || stdinComplete_ || !client_->hasCgiInput()) {
+        return;
+    }
+    std::string body;
+    stdinComplete_ = client_->takeCgiInput(body);
+    for (size_t offset = 0; offset < body.size(); offset += FCGI_MAX_CONTENT_LENGTH) {
+        appendRecord(FCGI_STDIN, body.data() + offset, std::min(FCGI_MAX_CONTENT_LENGTH, body.size() - offset));
+    }
+    if (stdinComplete_) {
+        appendRecord(FCGI_STDIN, NULL, 0);
+    }
+}
+
+// Record header (version, type, request id, content length, padding) followed by the content, padded to 8 bytes
+void FastCgiConnection::appendRecord(unsigned char type, const char* content, size_t length) {
+    unsigned char padding = static_cast<unsigned char>((8 - length % 8) % 8);
+    unsigned char header[FCGI_HEADER_LENGTH];
+    header[0] = FCGI_VERSION_1;
+    header[1] = type;
+    header[2] = static_cast<unsigned char>(FCGI_REQUEST_ID >> 8);
+    header[3] = static_cast<unsigned char>(FCGI_REQUEST_ID & 0xFF);
+    header[4] = static_cast<unsigned char>((length >> 8) & 0xFF);
+    header[5] = static_cast<unsigned char>(length & 0xFF);
+    header[6] = padding;
+    header[7] = 0;
+    sendBuffer_.append(reinterpret_cast<const char*>(header), sizeof(header));
+    if (length > 0) {
+        sendBuffer_.append(content, length);
+    }
+    sendBuffer_.append(padding, '\0');
+}
+
+// Name-value pair : both lengths first (1 byte below 128, 4 bytes otherwise), then the name and the value
+void FastCgiConnection::appendParam(std::string& params, const std::string& name, const std::string& value) const {
+    appendLength(params, name.size());
+    appendLength(params, value.size());
+    params.append(name);
+    params.append(value);
+}
+
+void FastCgiConnection::appendLength(std::string& params, size_t length) const {
+    if (length < 128) {
+        params.push_back(static_cast<char>(length));
+        return;
+    }
+    params.push_back(static_cast<char>(((length >> 24) & 0x7F) | 0x80));
+    params.push_back(static_cast<char>((length >> 16) & 0xFF));
+    params.push_back(static_cast<char>((length >> 8) & 0xFF));
+    params.push_back(static_cast<char>(length & 0xFF));
+}
+
+/**
+ * Completes a connection in progress, then writes the next part of the request.
+ *
+ * @return false if the connection failed.
+ */
+bool FastCgiConnection::handleWritable() {
+    if (!connected_) {
+        int error = 0;
+        socklen_t errorLength = sizeof(error);
+        if (getsockopt(fd_, SOL_SOCKET, SO_ERROR, &error, &errorLength) == -1 || error != 0) {
+            std::cerr << "Error : FastCGI connection to " << socketPath_ << " failed: " << strerror(error ? error : errno) << std::endl;
+            return false;
+        }
+        connected_ = true;
+    }
+    // Previous part written : the next part of the body, if the client sent it
+    if (sendBufferOffset_ >= sendBuffer_.size()) {
+        appendStdin();
+    }
+    if (sendBufferOffset_ >= sendBuffer_.size()) {
+        return true;
+    }
+    ssize_t bytesSent = send(fd_, sendBuffer_.data() + sendBufferOffset_, sendBuffer_.size() - sendBufferOffset_, 0);
+    if (bytesSent < 0 && isRetryableIoError(errno)) {
+        return true;
+    }
+    if (bytesSent <= 0) {
+        return false;
+    }
+    lastActivityTime_ = TimerWheel::currentTime();
+    sendBufferOffset_ += bytesSent;
+    if (sendBufferOffset_ >= sendBuffer_.size()) {
+        std::string().swap(sendBuffer_);
+        sendBufferOffset_ = 0;
+    }
+    return true;
+}
+
+/**
+ * Reads what the responder sent and handles every complete record.
+ *
+ * @return false if the responder closed the connection or broke the protocol.
+ */
+bool FastCgiConnection::handleReadable() {
+    char buffer[FASTCGI_READ_BUFFER_SIZE];
+    ssize_t bytesRead = recv(fd_, buffer, sizeof(buffer), 0);
+    if (bytesRead < 0 && isRetryableIoError(errno)) {
+        return true;
+    }
+    if (bytesRead <= 0) {
+        return false;
+    }
+    lastActivityTime_ = TimerWheel::currentTime();
+    recvBuffer_.append(buffer, bytesRead);
+
+    while (recvBuffer_.size() - recvOffset_ >= FCGI_HEADER_LENGTH) {
+        const unsigned char* header = reinterpret_cast<const unsigned char*>(recvBuffer_.data() + recvOffset_);
+        if (header[0] != FCGI_VERSION_1) {
+            std::cerr << "Error : FastCGI invalid record version received from " << socketPath_ << std::endl;
+            return false;
+        }
+        unsigned char type = header[1];
+        unsigned short requestId = static_cast<unsigned short>((header[2] << 8) | header[3]);
+        size_t contentLength = (static_cast<size_t>(header[4]) << 8) | header[5];
+        size_t recordLength = FCGI_HEADER_LENGTH + contentLength + header[6];
+        if (recvBuffer_.size() - recvOffset_ < recordLength) {
+            break;
+        }
+        const char* content = recvBuffer_.data() + recvOffset_ + FCGI_HEADER_LENGTH;
+        recvOffset_ += recordLength;
+        // Management records (request id 0) are not used
+        if (requestId == FCGI_REQUEST_ID && !handleRecord(type, content, contentLength)) {
+            return false;
+        }
+    }
+    if (recvOffset_ >= recvBuffer_.size()) {
+        recvBuffer_.clear();
+        recvOffset_ = 0;
+    } else if (recvOffset_ > 0) {
+        recvBuffer_.erase(0, recvOffset_);
+        recvOffset_ = 0;
+    }
+    return true;
+}
+
+bool FastCgiConnection::handleRecord(unsigned char type, const char* content, size_t length) {
+    if (type == FCGI_STDOUT) {
+        // Same path as the output of a CGI process (header block, then body relayed to the client)
+        if (client_ && length > 0 && !client_->appendCgiOutput(content, length)) {
+            return false;
+        }
+    } else if (type == FCGI_STDERR) {
+        std::string message(content, length);
+        if (!message.empty() && message[message.size() - 1] == '\n') {
+            message.erase(message.size() - 1);
+        }
+        std::cerr << "FastCGI Gateway : " << message << std::endl;
+    } else if (type == FCGI_END_REQUEST && length >= 8) {
+        const unsigned char* body = reinterpret_cast<const unsigned char*>(content);
+        unsigned long appStatus = (static_cast<unsigned long>(body[0]) << 24) | (body[1] << 16) | (body[2] << 8) | body[3];
+        unsigned char protocolStatus = body[4];
+        bool failed = appStatus != 0 || protocolStatus != FCGI_REQUEST_COMPLETE;
+        if (failed) {
+            std::cerr << "FastCGI Gateway : request ended with app status " << appStatus
+                      << ", protocol status " << static_cast<int>(protocolStatus) << std::endl;
+        }
+        ++requestsCount_;
+        // The connection is idle again before the client is told, so it can be reused right away
+        DataSocket* client = client_;
+        client_ = NULL;
+        if (client) {
+            client->finishFastCgiRequest(failed);
+        }
+    }
+    return true;
+}
+
+int FastCgiConnection::getFd() const {
+    return fd_;
+}
+
+const std::string& FastCgiConnection::getSocketPath() const {
+    return socketPath_;
+}
+
+DataSocket* FastCgiConnection::getClient() const {
+    return client_;
+}
+
+// The client does not wait for the response anymore (closed, failed ...)
+DataSocket* FastCgiConnection::detachClient() {
+    DataSocket* client = client_;
+    client_ = NULL;
+    return client;
+}
+
+bool FastCgiConnection::isIdle() const {
+    return client_ == NULL;
+}
+
+/**
+ * EVENT_WRITE while the connection is in progress or the request is not fully written (part of the body waits in
+ * the client), EVENT_READ while a response is expected and the client keeps up with it. An idle connection is only
+ * watched for a hangup.
+ */
+unsigned int FastCgiConnection::getWantedEvents() const {
+    unsigned int events = 0;
+    if (!connected_ || sendBufferOffset_ < sendBuffer_.size() || (client_ && !stdinComplete_ && client_->hasCgiInput())) {
+        events |= EVENT_WRITE;
+    }
+    if (connected_ && client_ && client_->wantsCgiOutput()) {
+        events |= EVENT_READ;
+    }
+    return events;
+}
+
+time_t FastCgiConnection::getLastActivityTime() const {
+    return lastActivityTime_;
+}
+
+Timer& FastCgiConnection::getTimer() {
+    return timer_;
+}
@@ -0,0 +1,124 @@
+// FastCgiPool.cpp
+#include "FastCgiPool.hpp"
+#include <algorithm>
+
+FastCgiPool::FastCgiPool(const std::string& socketPath, size_t maxConnections, size_t maxQueued, time_t idleTimeout)
+    : socketPath_(socketPath), maxConnections_(maxConnections), maxQueued_(maxQueued), idleTimeout_(idleTimeout)
+{
+}
+
+FastCgiPool::~FastCgiPool() {
+    for (size_t i = 0; i < connections_.size(); ++i) {
+        delete connections_[i];
+    }
+    connections_.clear();
+    queue_.clear();
+}
+
+/**
+ * Queues the request of a DataSocket. It is sent by dispatchNext() once a connection is available.
+ *
+ * @return false if the queue is full.
+ */
+bool FastCgiPool::enqueue(DataSocket* client) {
+    if (queue_.size() >= maxQueued_) {
+        return false;
+    }
+    queue_.push_back(client);
+    return true;
+}
+
+/**
+ * Gives the first queued request to an idle connection, or to a new one if the pool is not full.
+ *
+ * @param connection Set to the connection used, NULL if a new connection could not be opened (the request is
+ *                   removed from the queue anyway and has to be failed by the caller).
+ * @return The DataSocket dispatched, NULL if nothing can be dispatched (empty queue, every connection busy,
+ *         backlog of the responder full : the request stays queued until the next dispatch).
+ */
+DataSocket* FastCgiPool::dispatchNext(FastCgiConnection*& connection) {
+    connection = NULL;
+    if (queue_.empty()) {
+        return NULL;
+    }
+    for (size_t i = 0; i < connections_.size(); ++i) {
+        if (connections_[i]->isIdle()) {
+            connection = connections_[i];
+            break;
+        }
+    }
+    if (!connection) {
+        if (connections_.size() >= maxConnections_) {
+            return NULL;
+        }
+        connection = new FastCgiConnection(socketPath_);
+        FastCgiOpenResult result = connection->open();
+        if (result != FASTCGI_OPEN_OK) {
+            delete connection;
+            connection = NULL;
+            if (result == FASTCGI_OPEN_RETRY) {
+                return NULL;
+            }
+        } else {
+            connections_.push_back(connection);
+        }
+    }
+
+    DataSocket* client = queue_.front();
+    queue_.pop_front();
+    if (connection) {
+        connection->startRequest(client);
+    }
+    return client;
+}
+
+/**
+ * Forgets the request of a DataSocket that is being closed.
+ *
+ * @return The connection that was handling it (its request can't be stopped : the caller closes it), NULL otherwise.
+ */
+FastCgiConnection* FastCgiPool::cancel(DataSocket* client) {
+    std::deque<DataSocket*>::iterator it = std::find(queue_.begin(), queue_.end(), client);
+    if (it != queue_.end()) {
+        queue_.erase(it);
+        return NULL;
+    }
+    FastCgiConnection* connection = findConnection(client);
+    if (connection) {
+        connection->detachClient();
+    }
+    return connection;
+}
+
+FastCgiConnection* FastCgiPool::findConnection(const DataSocket* client) const {
+    for (size_t i = 0; i < connections_.size(); ++i) {
+        if (connections_[i]->getClient() == client) {
+            return connections_[i];
+        }
+    }
+    return NULL;
+}
+
+// Closes a connection (already unregistered from the event loop)
+void FastCgiPool::removeConnection(FastCgiConnection* connection) {
+    std::vector<FastCgiConnection*>::iterator it = std::find(connections_.begin(), connections_.end(), connection);
+    if (it != connections_.end()) {
+        connections_.erase(it);
+    }
+    delete connection;
+}
+
+// First second at which a connection has been idle for too long, or busy without any news from the responder
+time_t FastCgiPool::getDeadline(const FastCgiConnection* connection) const {
+    time_t timeout = connection->isIdle() ? idleTimeout_ : FASTCGI_READ_TIMEOUT;
+    return connection->getLastActivityTime() + timeout + 1;
+}
+
+// Requests queued while a connection could be opened : the backlog of the responder was full, to retry later
+bool FastCgiPool::isWaitingForConnection() const {
+    return !queue_.empty() && connections_.size() < maxConnections_;
+}
+
+const std::string& FastCgiPool::getSocketPath() const {
+    return socketPath_;
+}
@@ -0,0 +1,72 @@
+// GzipEncoder.cpp
+#include "GzipEncoder.hpp"
+#include <cstring>
+
+// windowBits 15 + 16 : gzip header and trailer instead of the zlib ones
+GzipEncoder::GzipEncoder(int level) : valid_(false), finished_(false) {
+    memset(&stream_, 0, sizeof(stream_));
+    valid_ = deflateInit2(&stream_, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+}
+
+GzipEncoder::~GzipEncoder() {
+    if (valid_) {
+        deflateEnd(&stream_);
+    }
+}
+
+bool GzipEncoder::isValid() const {
+    return valid_;
+}
+
+/**
+ * Compresses a piece of the body and appends the compressed bytes already produced to `output`.
+ * Without `flush`, deflate may keep them to compress better with the next pieces.
+ *
+ * @param flush true to get every byte compressed so far (Z_SYNC_FLUSH).
+ * @return false if the stream is unusable.
+ */
+bool GzipEncoder::compress(const char* data, size_t length, std::string& output, bool flush) {
+    if (!valid_ || finished_) {
+        return false;
+    }
+    stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    stream_.avail_in = static_cast<uInt>(length);
+    return deflateAll(flush ? Z_SYNC_FLUSH : Z_NO_FLUSH, output);
+}
+
+// Appends the rest of the compressed stream and the gzip trailer (CRC32, length) to `output`
+bool GzipEncoder::finish(std::string& output) {
+    if (!valid_ || finished_) {
+        return false;
+    }
+    stream_.next_in = NULL;
+    stream_.avail_in = 0;
+    finished_ = true;
+    return deflateAll(Z_FINISH, output);
+}
+
+size_t GzipEncoder::getTotalIn() const {
+    return stream_.total_in;
+}
+
+size_t GzipEncoder::getTotalOut() const {
+    return stream_.total_out;
+}
+
+// Runs deflate() until the input is consumed and the output of the flush mode is complete
+bool GzipEncoder::deflateAll(int flush, std::string& output) {
+    char buffer[GZIP_CHUNK_SIZE];
+    int status;
+    do {
+        stream_.next_out = reinterpret_cast<Bytef*>(buffer);
+        stream_.avail_out = sizeof(buffer);
+        status = deflate(&stream_, flush);
+        if (status == Z_STREAM_ERROR) {
+            valid_ = false;
+            deflateEnd(&stream_);
+            return false;
+        }
+        output.append(buffer, sizeof(buffer) - stream_.avail_out);
+    } while (stream_.avail_out == 0 || (flush == Z_FINISH && status != Z_STREAM_END));
+    return true;
+}
@@ -4,11 +4,14 @@
 #include <sstream>
 #include <algorithm>
 #include <cctype>
+#include <cstdlib>
+#include <cerrno>
 #include <iostream>
-#include <set>
 
 HttpRequest::HttpRequest()
     : rawData_(""), 
+      parsePos_(0), 
+      scanPos_(0), 
       method_(""), 
       rawPath_(""), 
       path_(""), 
@@ -16,92 +19,216 @@ HttpRequest::HttpRequest()
       httpVersion_(""), 
       body_(""), 
       contentLength_(0), 
-      bodyStartPos_(0), 
       headersParsed_(false), 
+      keepAlive_(false),
       state_(REQUEST_LINE),
+      headersEndPos_(0),
+      maxBodySize_(0),
+      bodyLimitSet_(false),
+      chunked_(false),
+      chunkRemaining_(0),
+      bodyReceived_(0),
+      bodySink_(NULL),
       parseError_(false),
       parseErrorCode_(0)
 {
 }
 
 HttpRequest::~HttpRequest() {
+    delete bodySink_;
 }
 
 
 /**
  * Appends new data to the raw data of the HTTP request.
- * This function is typically called to add incoming data chunks to the request body.
+ * While the body is being received and no unparsed byte is waiting, the data goes straight to body_ : 
+ * only what does not belong to the body (next pipelined request) is buffered in rawData_.
  * 
  * @param data The new data to be appended to the request.
+ * @param length Number of bytes in data.
  */
 
-void HttpRequest::appendData(const std::string& data) {
-    rawData_ += data;
+void HttpRequest::appendData(const char* data, size_t length) {
+    if (state_ == BODY && bodyLimitSet_ && !parseError_ && parsePos_ == rawData_.size()) {
+        size_t bodyLength = std::min(length, contentLength_ - bodyReceived_);
+        appendBody(data, bodyLength);
+        data += bodyLength;
+        length -= bodyLength;
+    }
+    rawData_.append(data, length);
 }
 
 
 /**
  * Checks if the HTTP request is complete.
- * A request is considered complete if the headers are parsed and the body size matches the content length.
+ * A request is considered complete if the headers are parsed and the whole body (Content-Length bytes, 
+ * or every chunk up to the last one) has been received.
  * 
  * @return true if the request is complete, false otherwise.
  */
 
 bool HttpRequest::isComplete() const {
-    if (!headersParsed_) {
-        return false;
+    return state_ == COMPLETE;
+}
+
+
+/**
+ * The body is not parsed until the limit of the matching location is given with setMaxBodySize().
+ * 
+ * @return true if the headers are parsed and the parser waits for the body limit.
+ */
+
+bool HttpRequest::isWaitingForBodyLimit() const {
+    return headersParsed_ && !bodyLimitSet_ && state_ != COMPLETE && !parseError_;
+}
+
+
+/**
+ * Sets the client_max_body_size applying to this request. A Content-Length above the limit is 
+ * rejected right away, a chunked body is checked each time a chunk is decoded.
+ * 
+ * @param maxBodySize The maximum body size in bytes, 0 stands for 'no limit'.
+ */
+
+void HttpRequest::setMaxBodySize(size_t maxBodySize) {
+    maxBodySize_ = maxBodySize;
+    bodyLimitSet_ = true;
+    if (!chunked_ && maxBodySize_ > 0 && contentLength_ > maxBodySize_) {
+        std::cerr << "Content-Length " << contentLength_ << " exceeds client_max_body_size " << maxBodySize_ << std::endl;
+        parseError_ = true;
+        parseErrorCode_ = 413; // Payload Too Large
     }
+}
 
-    return body_.size() >= contentLength_;
+bool HttpRequest::isChunked() const {
+    return chunked_;
+}
+
+
+/**
+ * Streams the body of this request to a BodySink instead of body_. Must be called before the body is 
+ * parsed (see isWaitingForBodyLimit()). The HttpRequest takes the ownership of the sink.
+ * 
+ * @param bodySink The destination of the body.
+ */
+
+void HttpRequest::setBodySink(BodySink* bodySink) {
+    delete bodySink_;
+    bodySink_ = bodySink;
+}
+
+const BodySink* HttpRequest::getBodySink() const {
+    return bodySink_;
 }
 
 
 /**
  * Parses the HTTP request from the raw data.
- * The function processes the request line, headers, and body in sequence.
+ * The function processes the request line, headers, and body in sequence. It can be called after each 
+ * appendData() : the parsing resumes at parsePos_ and the bytes already consumed are never read again.
  * 
- * @return true if parsing is successful and the request is complete, false if an error occurs.
+ * @return true if parsing is successful and the request is complete, false if an error occurs or more data is needed.
  */
 
 bool HttpRequest::parseRequest() {
-    std::istringstream stream(rawData_);
-    std::string line;
+    while (state_ != COMPLETE) {
+        if (parseError_ || isWaitingForBodyLimit()) {
+            return false;
+        }
+        if (state_ == BODY) {
+            return handleBody();
+        }
+        if (state_ != REQUEST_LINE && state_ != HEADERS) {
+            return handleChunks();
+        }
+
+        size_t lineEnd;
+        if (!findLineEnd(lineEnd)) {
+            // Incomplete line : wait for more data, unless the header block is already too long
+            checkHeadersLength(rawData_.size());
+            return false;
+        }
+        size_t lineStart = parsePos_;
+        parsePos_ = lineEnd + 1;
+        // Lines end with CRLF, a bare LF is tolerated
+        if (lineEnd > lineStart && rawData_[lineEnd - 1] == '\r') {
+            --lineEnd;
+        }
 
-    while (state_ != COMPLETE && std::getline(stream, line)) {
-        // std::cout << "line :"<< line <<std::endl;//debug
         if (state_ == REQUEST_LINE) {
-            if (!handleRequestLine(line)) {
+            if (!handleRequestLine(lineStart, lineEnd)) {
                 return false;
             }
         } else if (state_ == HEADERS) {
-            if (!handleHeaders(line)) {
-                return false;
-            }
-        } else if (state_ == BODY) {
-            if (!handleBody()) {
+            if (!handleHeaders(lineStart, lineEnd)) {
                 return false;
             }
         }
     }
-    return state_ == COMPLETE;
+    return true;
 }
 
 
+/**
+ * Looks for the end of the line beginning at parsePos_.
+ * scanPos_ remembers how far the search already went, so an incomplete line is not scanned again 
+ * when the next chunk arrives.
+ * 
+ * @param lineEnd Set to the position of the '\n' ending the line.
+ * @return true if a complete line is available.
+ */
+
+bool HttpRequest::findLineEnd(size_t& lineEnd) {
+    size_t newline = rawData_.find('\n', std::max(scanPos_, parsePos_));
+    if (newline == std::string::npos) {
+        scanPos_ = rawData_.size();
+        return false;
+    }
+    lineEnd = newline;
+    scanPos_ = newline + 1;
+    return true;
+}
+
+
+/**
+ * Refuses a request line or a header block that keeps growing without its end being received.
+ * 
+ * @param headersLength Number of bytes of the request head received so far.
+ * @return true if the lengths are still acceptable.
+ */
+
+bool HttpRequest::checkHeadersLength(size_t headersLength) {
+    if (state_ == REQUEST_LINE && rawData_.size() - parsePos_ > MAX_REQUEST_LINE_LENGTH) {
+        std::cerr << "Request line too long" << std::endl;
+        parseError_ = true;
+        parseErrorCode_ = 400; // Bad Request
+        return false;
+    }
+    if (headersLength > MAX_HEADERS_LENGTH) {
+        std::cerr << "Request headers too long" << std::endl;
+        parseError_ = true;
+        parseErrorCode_ = 400; // Bad Request
+        return false;
+    }
+    return true;
+}
+
 
 /**
  * Handles the request line (method, path, HTTP version).
  * It validates and parses the request line, setting the corresponding attributes.
+ * Empty lines received before the request line are ignored (e.g. CRLF sent after a previous body).
  * 
- * @param line The request line to be parsed.
+ * @param lineStart Position of the line in rawData_.
+ * @param lineEnd Position of the end of the line (CRLF excluded).
  * @return true if the request line is successfully parsed, false otherwise.
  */
 
-bool HttpRequest::handleRequestLine(const std::string& line) {
-    if (line == "\r" || line.empty()) {
-        // Incomplete Request
-        return false;
+bool HttpRequest::handleRequestLine(size_t lineStart, size_t lineEnd) {
+    if (lineStart == lineEnd) {
+        return checkHeadersLength(parsePos_);
     }
-    if (!parseRequestLine(line)) {
+    if (!parseRequestLine(rawData_.substr(lineStart, lineEnd - lineStart))) {
         // An error occurred while parsing the request line
         return false;
     }
@@ -110,63 +237,238 @@ bool HttpRequest::handleRequestLine(const std::string& line) {
 }
 
 
-
-
-
 /**
  * Handles the HTTP headers.
  * It parses each header line, and once all headers are processed, validates them.
  * 
- * @param line The header line to be parsed.
+ * @param lineStart Position of the line in rawData_.
+ * @param lineEnd Position of the end of the line (CRLF excluded).
  * @return true if headers are successfully parsed, false if validation fails.
  */
 
-bool HttpRequest::handleHeaders(const std::string& line) {
-    if (line == "\r" || line.empty()) {
+bool HttpRequest::handleHeaders(size_t lineStart, size_t lineEnd) {
+    if (lineStart == lineEnd) {
         headersParsed_ = true;
         if (!validateHeaders()) {
             return false;
         }
-        // Record the position of the beginning of the body
-        bodyStartPos_ = rawData_.find("\r\n\r\n");
-        // std::cout << "bodystart :" << bodyStartPos_ << std::endl; //debug
-        if (bodyStartPos_ != std::string::npos) {
-            bodyStartPos_ += 4; // Passer les "\r\n\r\n"
+        // parsePos_ is now the beginning of the body
+        headersEndPos_ = parsePos_;
+        if (chunked_) {
+            state_ = CHUNK_SIZE;
         } else {
-            // Can't find end of headers
-            parseError_ = true;
-            parseErrorCode_ = 400; // Bad Request
+            state_ = (contentLength_ > 0) ? BODY : COMPLETE;
+        }
+        return true;
+    }
+    if (!checkHeadersLength(parsePos_)) {
+        return false;
+    }
+    return parseHeaderLine(lineStart, lineEnd);
+}
+
+
+/**
+ * Handles the HTTP body : the body bytes still buffered in rawData_ are moved to body_.
+ * Only the bytes following them (pipelined request) stay in rawData_.
+ * If the body is not complete, the function will return false and require more data to be appended.
+ * 
+ * @return true if the body is fully received, false if more data is needed.
+ */
+
+bool HttpRequest::handleBody() {
+    size_t bodyLength = std::min(rawData_.size() - parsePos_, contentLength_ - bodyReceived_);
+    if (bodyLength > 0) {
+        if (!appendBody(rawData_.data() + parsePos_, bodyLength)) {
             return false;
         }
-        state_ = (contentLength_ > 0) ? BODY : COMPLETE;
-    } else {
-        parseHeaderLine(line);
+        parsePos_ += bodyLength;
+        discardConsumedBody();
     }
-    return true;
+    if (bodyReceived_ >= contentLength_) {
+        return completeBody();
+    }
+    //need to read few more times 
+    return false;
 }
 
 
+/**
+ * Decodes a chunked body (RFC 9112 section 7.1) with the bytes available : 
+ * chunk-size [; extensions] CRLF, chunk-data CRLF, ..., last chunk "0" CRLF, optional trailer fields, CRLF.
+ * Chunk extensions and trailer fields are ignored. Decoded bytes go to body_ through appendBody().
+ * 
+ * @return true if the last chunk and the trailer have been received, false if an error occurs or more data is needed.
+ */
 
+bool HttpRequest::handleChunks() {
+    while (state_ != COMPLETE) {
+        if (state_ == CHUNK_DATA) {
+            size_t length = std::min(rawData_.size() - parsePos_, chunkRemaining_);
+            if (!appendBody(rawData_.data() + parsePos_, length)) {
+                return false;
+            }
+            parsePos_ += length;
+            chunkRemaining_ -= length;
+            if (chunkRemaining_ > 0) {
+                break;
+            }
+            state_ = CHUNK_DATA_END;
+            continue;
+        }
+
+        size_t lineEnd;
+        if (!findLineEnd(lineEnd)) {
+            if (rawData_.size() - parsePos_ > MAX_CHUNK_LINE_LENGTH) {
+                std::cerr << "Chunk line too long" << std::endl;
+                parseError_ = true;
+                parseErrorCode_ = 400; // Bad Request
+                return false;
+            }
+            break;
+        }
+        size_t lineStart = parsePos_;
+        parsePos_ = lineEnd + 1;
+        if (lineEnd > lineStart && rawData_[lineEnd - 1] == '\r') {
+            --lineEnd;
+        }
+
+        if (state_ == CHUNK_SIZE) {
+            if (!parseChunkSize(lineStart, lineEnd)) {
+                return false;
+            }
+        } else if (state_ == CHUNK_DATA_END) {
+            // chunk-data must be followed by CRLF
+            if (lineStart != lineEnd) {
+                std::cerr << "Invalid chunked body: missing CRLF after chunk data" << std::endl;
+                parseError_ = true;
+                parseErrorCode_ = 400; // Bad Request
+                return false;
+            }
+            state_ = CHUNK_SIZE;
+        } else if (state_ == CHUNK_TRAILER) {
+            // Trailer fields are skipped, an empty line ends the request
+            if (lineStart == lineEnd) {
+                discardConsumedBody();
+                return completeBody();
+            } else if (lineEnd - lineStart > MAX_CHUNK_LINE_LENGTH) {
+                std::cerr << "Trailer field too long" << std::endl;
+                parseError_ = true;
+                parseErrorCode_ = 400; // Bad Request
+                return false;
+            }
+        }
+    }
+    discardConsumedBody();
+    //need to read few more times 
+    return false;
+}
 
 
 /**
- * Handles the HTTP body by extracting the content up to the specified content length.
- * If the body is not complete, the function will return false and require more data to be appended.
+ * Parses a chunk size line (hexadecimal size, followed by optional extensions after ';').
+ * A chunk that would make the body exceed client_max_body_size is refused before its data is received.
  * 
- * @return true if the body is fully received, false if more data is needed.
+ * @param lineStart Position of the line in rawData_.
+ * @param lineEnd Position of the end of the line (CRLF excluded).
+ * @return true if the chunk size is valid.
  */
 
-bool HttpRequest::handleBody() {
-    // Calculate the remaining body size to be read
-    size_t bodyReceivedLength = rawData_.size() - bodyStartPos_;
-    if (bodyReceivedLength >= contentLength_) {
-        body_ = rawData_.substr(bodyStartPos_, contentLength_);
-        state_ = COMPLETE;
+bool HttpRequest::parseChunkSize(size_t lineStart, size_t lineEnd) {
+    size_t chunkSize = 0;
+    size_t digits = 0;
+    size_t pos = lineStart;
+    while (pos < lineEnd && std::isxdigit(static_cast<unsigned char>(rawData_[pos]))) {
+        // More than 15 hex digits can't be a real chunk (and would overflow)
+        if (++digits > 15) {
+            break;
+        }
+        char c = std::tolower(static_cast<unsigned char>(rawData_[pos]));
+        chunkSize = chunkSize * 16 + ((c >= 'a') ? c - 'a' + 10 : c - '0');
+        ++pos;
+    }
+    while (pos < lineEnd && (rawData_[pos] == ' ' || rawData_[pos] == '\t')) {
+        ++pos;
+    }
+    if (digits == 0 || digits > 15 || (pos < lineEnd && rawData_[pos] != ';')) {
+        std::cerr << "Invalid chunk size: " << rawData_.substr(lineStart, lineEnd - lineStart) << std::endl;
+        parseError_ = true;
+        parseErrorCode_ = 400; // Bad Request
+        return false;
+    }
+
+    if (chunkSize == 0) {
+        state_ = CHUNK_TRAILER;
         return true;
-    } else {
-        //need to read few more times 
+    }
+    if (maxBodySize_ > 0 && chunkSize > maxBodySize_ - bodyReceived_) {
+        std::cerr << "Chunked body exceeds client_max_body_size " << maxBodySize_ << std::endl;
+        parseError_ = true;
+        parseErrorCode_ = 413; // Payload Too Large
+        return false;
+    }
+    chunkRemaining_ = chunkSize;
+    state_ = CHUNK_DATA;
+    return true;
+}
+
+
+/**
+ * Single entry point of the decoded body bytes, checked against client_max_body_size.
+ * The bytes go to the BodySink if one is attached, to body_ otherwise.
+ * 
+ * @return false if the body exceeds the limit or if the BodySink failed.
+ */
+
+bool HttpRequest::appendBody(const char* data, size_t length) {
+    if (maxBodySize_ > 0 && bodyReceived_ + length > maxBodySize_) {
+        std::cerr << "Request body exceeds client_max_body_size " << maxBodySize_ << std::endl;
+        parseError_ = true;
+        parseErrorCode_ = 413; // Payload Too Large
         return false;
     }
+    bodyReceived_ += length;
+    if (bodySink_ == NULL) {
+        body_.append(data, length);
+    } else if (!bodySink_->write(data, length)) {
+        parseError_ = true;
+        parseErrorCode_ = bodySink_->getErrorCode();
+        return false;
+    }
+    return true;
+}
+
+
+/**
+ * The whole body has been received : the BodySink is told so (e.g. last upload renamed).
+ * 
+ * @return true if the request is complete, false if the BodySink failed.
+ */
+
+bool HttpRequest::completeBody() {
+    if (bodySink_ != NULL && !bodySink_->finish()) {
+        parseError_ = true;
+        parseErrorCode_ = bodySink_->getErrorCode();
+        return false;
+    }
+    state_ = COMPLETE;
+    return true;
+}
+
+
+/**
+ * Removes the body bytes already moved to body_ from rawData_. The header block (referenced by headers_) 
+ * and the bytes not parsed yet are kept, so rawData_ never holds more than one recv() of body.
+ */
+
+void HttpRequest::discardConsumedBody() {
+    if (parsePos_ == headersEndPos_) {
+        return;
+    }
+    size_t consumed = parsePos_ - headersEndPos_;
+    rawData_.erase(headersEndPos_, consumed);
+    parsePos_ = headersEndPos_;
+    scanPos_ = (scanPos_ > consumed) ? std::max(scanPos_ - consumed, parsePos_) : parsePos_;
 }
 
 
@@ -181,58 +483,181 @@ bool HttpRequest::handleBody() {
 
 bool HttpRequest::validateHeaders() {
     // Vérifier la présence de l'en-tête Host
-    if (headers_.find("host") == headers_.end()) {
+    if (findHeader("host") == NULL) {
         std::cerr << "Missing Host header in HTTP request." << std::endl;
         parseError_ = true;
         parseErrorCode_ = 400; // Bad Request
         return false;
     }
-    if (method_ == "POST" && (!validatePOSTContentType() || !validatePOSTContentLength() )) {
+    if (!validateTransferEncoding()) {
+        return false;
+    }
+    // Every method : a body left unread would be parsed as the next request of the connection
+    if (!validateContentLength()) {
         return false;
     }
+    if (method_ == "POST" && !validatePOSTContentType()) {
+        return false;
+    }
+
+    // HTTP/1.1 connections are persistent unless 'Connection: close', HTTP/1.0 ones only with 'Connection: keep-alive'
+    if (httpVersion_ == "HTTP/1.1") {
+        keepAlive_ = !hasConnectionToken("close");
+    } else {
+        keepAlive_ = hasConnectionToken("keep-alive");
+    }
     return true;
 }
 
 
 /**
- * Validates the Content-Length header for POST requests.
- * This function also checks for the presence of Transfer-Encoding header (which is not implemented).
+ * Checks if the Connection header contains a token (case insensitive, the header is a comma separated list).
+ * 
+ * @param token The lowercase token to search for (e.g. "close", "keep-alive").
+ * @return true if the token is present.
+ */
+bool HttpRequest::hasConnectionToken(const std::string& token) const {
+    std::string value = getHeader("connection");
+    if (value.empty()) {
+        return false;
+    }
+    std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+    std::istringstream tokens(value);
+    std::string current;
+    while (std::getline(tokens, current, ',')) {
+        std::string::size_type first = current.find_first_not_of(" \t");
+        if (first == std::string::npos)
+            continue;
+        std::string::size_type last = current.find_last_not_of(" \t");
+        if (current.compare(first, last - first + 1, token) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Checks if a content-coding is accepted by the Accept-Encoding header : listed, or covered by "*", with a 
+ * q-value that is not 0 (e.g. "gzip;q=0" refuses gzip). Without the header, only the identity is accepted.
+ * 
+ * @param coding The lowercase content-coding to search for (e.g. "gzip", "br").
+ * @return true if the response can be encoded with it.
+ */
+bool HttpRequest::acceptsEncoding(const std::string& coding) const {
+    std::string value = getHeader("accept-encoding");
+    if (value.empty()) {
+        return false;
+    }
+    std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+    std::istringstream codings(value);
+    std::string current;
+    bool wildcardAccepted = false;
+    while (std::getline(codings, current, ',')) {
+        std::string::size_type semicolon = current.find(';');
+        std::string name = current.substr(0, semicolon);
+        std::string::size_type first = name.find_first_not_of(" \t");
+        if (first == std::string::npos)
+            continue;
+        name = name.substr(first, name.find_last_not_of(" \t") - first + 1);
+
+        double quality = 1.0;
+        if (semicolon != std::string::npos) {
+            std::string::size_type q = current.find("q=", semicolon);
+            if (q != std::string::npos) {
+                quality = std::strtod(current.c_str() + q + 2, NULL);
+            }
+        }
+        if (name == coding) {
+            return quality > 0;
+        } else if (name == "*") {
+            wildcardAccepted = quality > 0;
+        }
+    }
+    return wildcardAccepted;
+}
+
+/**
+ * Validates the Transfer-Encoding header : only "chunked" is supported. 
+ * A request with both Transfer-Encoding and Content-Length is refused (request smuggling).
  * 
- * @return true if the Content-Length is valid, false otherwise.
+ * @return true if there is no Transfer-Encoding or if the body is chunked, false otherwise.
  */
 
-bool HttpRequest::validatePOSTContentLength() {
-    // Search for 'Transfer-Encoding header: chunked'
-    std::map<std::string, std::string>::iterator it = headers_.find("transfer-encoding");
-    if (it != headers_.end()) {
-        contentLength_ = 0;
-        std::cerr << "Chuncked requests are not implemented" << std::endl;
+bool HttpRequest::validateTransferEncoding() {
+    if (findHeader("transfer-encoding") == NULL) {
+        return true;
+    }
+    std::string transferEncoding = trim(getHeader("transfer-encoding"));
+    std::transform(transferEncoding.begin(), transferEncoding.end(), transferEncoding.begin(), ::tolower);
+    if (transferEncoding != "chunked") {
+        std::cerr << "Transfer-Encoding not implemented: " << transferEncoding << std::endl;
         parseError_ = true;
         parseErrorCode_ = 501;
         return false;
     }
-    
-    // Research Content-Length header
-    it = headers_.find("content-length");
-    if (it == headers_.end()) {
-        contentLength_ = 0;
-        std::cerr << "Missing Content-Length header in POST request." << std::endl;
+    if (findHeader("content-length") != NULL) {
+        std::cerr << "Both Transfer-Encoding and Content-Length in the request." << std::endl;
         parseError_ = true;
-        parseErrorCode_ = 411; // Length Required
+        parseErrorCode_ = 400; // Bad Request
         return false;
     }
+    chunked_ = true;
+    contentLength_ = 0;
+    return true;
+}
 
-    // Convert Content-Length value in an int
-    std::istringstream lengthStream(it->second);
-    int length;
-    if (!(lengthStream >> length) || length < 0) {
-        std::cerr << "Invalid Content-Length: " << it->second << std::endl;
+
+/**
+ * Validates the Content-Length header of any request (not needed when the body is chunked). The value must be
+ * digits only, and a repeated header must always give the same value : a framing the server and a proxy in
+ * front of it could read differently is refused (request smuggling). Only a POST requires it (411).
+ * 
+ * @return true if the Content-Length is valid or absent (no body), false otherwise.
+ */
+
+bool HttpRequest::validateContentLength() {
+    contentLength_ = 0;
+    if (chunked_) {
+        return true;
+    }
+
+    bool found = false;
+    for (size_t i = 0; i < headers_.size(); ++i) {
+        if (!headerNameIs(headers_[i], "content-length")) {
+            continue;
+        }
+        std::string value = rawData_.substr(headers_[i].valueStart, headers_[i].valueLength);
+        if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos) {
+            std::cerr << "Invalid Content-Length: " << value << std::endl;
+            parseError_ = true;
+            parseErrorCode_ = 400; // Bad Request
+            return false;
+        }
+        errno = 0;
+        char* end;
+        unsigned long length = std::strtoul(value.c_str(), &end, 10);
+        if (errno == ERANGE || *end != '\0') {
+            std::cerr << "Invalid Content-Length: " << value << std::endl;
+            parseError_ = true;
+            parseErrorCode_ = 400;
+            return false;
+        }
+        if (found && static_cast<size_t>(length) != contentLength_) {
+            std::cerr << "Conflicting Content-Length headers in the request." << std::endl;
+            parseError_ = true;
+            parseErrorCode_ = 400;
+            return false;
+        }
+        found = true;
+        contentLength_ = static_cast<size_t>(length);
+    }
+
+    if (!found && method_ == "POST") {
+        std::cerr << "Missing Content-Length header in POST request." << std::endl;
         parseError_ = true;
-        parseErrorCode_ = 400; // Bad Request
+        parseErrorCode_ = 411; // Length Required
         return false;
     }
-
-    contentLength_ = static_cast<size_t>(length);
     return true;
 }
 
@@ -246,8 +671,8 @@ bool HttpRequest::validatePOSTContentLength() {
  */
 bool HttpRequest::validatePOSTContentType() {
     // Verify the presence of 'Content-Type' header
-    std::map<std::string, std::string>::iterator it = headers_.find("content-type");
-    if (it == headers_.end() || it->second.empty()) {
+    std::string contentType = getHeader("content-type");
+    if (contentType.empty()) {
         std::cerr << "Missing Content-Type header in POST request." << std::endl;
         parseError_ = true;
         parseErrorCode_ = 400; // Bad Request
@@ -255,7 +680,6 @@ bool HttpRequest::validatePOSTContentType() {
     }
 
     // Extract the principal MIME TYPE (localized before semicolon)
-    std::string contentType = it->second;
     size_t semicolonPos = contentType.find(';');
     if (semicolonPos != std::string::npos) {
         contentType = contentType.substr(0, semicolonPos);
@@ -286,8 +710,9 @@ bool HttpRequest::validatePOSTContentType() {
  * @return true if the request line is valid, false otherwise.
  */
 bool HttpRequest::parseRequestLine(const std::string& line) {
-    std::istringstream lineStream(line);
-    std::string method, rawPath, httpVersion;
+    // List of allowed methods in HTTP/1.1
+    static const char* knownMethods[] = { "GET", "POST", "DELETE", "PUT", "HEAD", "OPTIONS", "TRACE", "PATCH" };
+    static const size_t knownMethodsCount = sizeof(knownMethods) / sizeof(knownMethods[0]);
 
     // Limit the max size allowed for the request line
     if (line.length() > MAX_REQUEST_LINE_LENGTH) {
@@ -297,8 +722,24 @@ bool HttpRequest::parseRequestLine(const std::string& line) {
         return false;
     }
 
+    // Split the line on whitespaces : method, target and version
+    std::string parts[3];
+    size_t count = 0;
+    size_t pos = line.find_first_not_of(" \t");
+    while (pos != std::string::npos) {
+        size_t end = line.find_first_of(" \t", pos);
+        if (count == 3) {
+            std::cerr << "Invalid request line (too many arguments): " << line << std::endl;
+            parseError_ = true;
+            parseErrorCode_ = 400; // Bad Request
+            return false;
+        }
+        parts[count++] = line.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+        pos = (end == std::string::npos) ? end : line.find_first_not_of(" \t", end);
+    }
+
     // Error if less than 3 strings in the line
-    if (!(lineStream >> method >> rawPath >> httpVersion)) {
+    if (count < 3) {
         std::cerr << "Invalid request line: " << line << std::endl;
         parseError_ = true;
         parseErrorCode_ = 400; // Bad Request
@@ -306,29 +747,16 @@ bool HttpRequest::parseRequestLine(const std::string& line) {
     }
 
     // Limit the max size allowed for the URI
-    if (rawPath.length() > MAX_URI_LENGTH) {
-        std::cerr << "URI too long: " << rawPath << std::endl;
+    if (parts[1].length() > MAX_URI_LENGTH) {
+        std::cerr << "URI too long: " << parts[1] << std::endl;
         parseError_ = true;
         parseErrorCode_ = 414; // URI Too Long
         return false;
     }
 
-    std::string extra;
-    if (lineStream >> extra) {
-        std::cerr << "Invalid request line (too many arguments): " << line << std::endl;
-        parseError_ = true;
-        parseErrorCode_ = 400; // Bad Request
-        return false;
-    }
-
-    method_ = method;
-    rawPath_ = rawPath;
-    httpVersion_ = httpVersion;
-
-    // Del \r from the HTTPver string
-    if (!httpVersion_.empty() && httpVersion_[httpVersion_.size() - 1] == '\r') {
-        httpVersion_.erase(httpVersion_.size() - 1);
-    }
+    method_ = parts[0];
+    rawPath_ = parts[1];
+    httpVersion_ = parts[2];
 
     // Vérify HTTP version
     if (httpVersion_ != "HTTP/1.1" && httpVersion_ != "HTTP/1.0") {
@@ -338,19 +766,12 @@ bool HttpRequest::parseRequestLine(const std::string& line) {
         return false;
     }
 
-    // List of allowed methods in HTTP/1.1
-    std::set<std::string> knownMethods;
-    knownMethods.insert("GET");
-    knownMethods.insert("POST");
-    knownMethods.insert("DELETE");
-    knownMethods.insert("PUT");
-    knownMethods.insert("HEAD");
-    knownMethods.insert("OPTIONS");
-    knownMethods.insert("TRACE");
-    knownMethods.insert("PATCH");
-
     // Detect impossible Methods
-    if (knownMethods.find(method_) == knownMethods.end()) {
+    size_t i = 0;
+    while (i < knownMethodsCount && method_ != knownMethods[i]) {
+        ++i;
+    }
+    if (i == knownMethodsCount) {
         std::cerr << "Unknown HTTP method: " << method_ << std::endl;
         parseError_ = true;
         parseErrorCode_ = 400; // Bad Request
@@ -358,7 +779,7 @@ bool HttpRequest::parseRequestLine(const std::string& line) {
     }
 
     // Detect unimplemented Methods
-    if (method_ != "GET" && method_ != "POST" && method_ != "DELETE") {
+    if (method_ != "GET" && method_ != "HEAD" && method_ != "POST" && method_ != "DELETE") {
         std::cerr << "Not implemented HTTP method: " << method_ << std::endl;
         parseError_ = true;
         parseErrorCode_ = 501;
@@ -419,33 +840,75 @@ std::string HttpRequest::normalizePath(const std::string& path) const {
 /**
  * Parses a single header line from the HTTP request.
  * The line is expected to be in the form of "Header-Name: Header-Value".
- * The function extracts the header name and value, trims whitespace, and converts the header name to lowercase.
+ * Nothing is copied : the positions of the name and of the value (whitespaces trimmed) are recorded in headers_.
  * 
- * @param line The header line to be parsed.
- * @return void
+ * @param lineStart Position of the line in rawData_.
+ * @param lineEnd Position of the end of the line (CRLF excluded).
+ * @return true if the line is a valid header.
  */
-void HttpRequest::parseHeaderLine(const std::string& line) {
-    size_t colonPos = line.find(':');
-    //colon is found
-    if (colonPos != std::string::npos) {
-        // Extract Name and value of the header
-        std::string headerName = line.substr(0, colonPos);
-        std::string headerValue = line.substr(colonPos + 1);
-
-        // Del whitespaces before Name and after Value
-        headerName = trim(headerName);
-        headerValue = trim(headerValue);
-
-        // Lowering headerName
-        std::transform(headerName.begin(), headerName.end(), headerName.begin(), ::tolower);
-
-        headers_[headerName] = headerValue;
-    } else {
-        // colon not found in the header line
-        std::cerr << "Invalid header line: " << line << std::endl;
+bool HttpRequest::parseHeaderLine(size_t lineStart, size_t lineEnd) {
+    size_t colonPos = rawData_.find(':', lineStart);
+    //colon not found in the header line
+    if (colonPos == std::string::npos || colonPos >= lineEnd) {
+        std::cerr << "Invalid header line: " << rawData_.substr(lineStart, lineEnd - lineStart) << std::endl;
         parseError_ = true;
         parseErrorCode_ = 400;
+        return false;
     }
+
+    // Del whitespaces before Name and after Value
+    HeaderSpan header;
+    size_t nameEnd = colonPos;
+    while (lineStart < nameEnd && (rawData_[lineStart] == ' ' || rawData_[lineStart] == '\t'))
+        ++lineStart;
+    while (nameEnd > lineStart && (rawData_[nameEnd - 1] == ' ' || rawData_[nameEnd - 1] == '\t'))
+        --nameEnd;
+    size_t valueStart = colonPos + 1;
+    while (valueStart < lineEnd && (rawData_[valueStart] == ' ' || rawData_[valueStart] == '\t'))
+        ++valueStart;
+    while (lineEnd > valueStart && (rawData_[lineEnd - 1] == ' ' || rawData_[lineEnd - 1] == '\t'))
+        --lineEnd;
+
+    if (nameEnd == lineStart) {
+        std::cerr << "Invalid header line: empty header name" << std::endl;
+        parseError_ = true;
+        parseErrorCode_ = 400;
+        return false;
+    }
+    header.nameStart = lineStart;
+    header.nameLength = nameEnd - lineStart;
+    header.valueStart = valueStart;
+    header.valueLength = lineEnd - valueStart;
+    headers_.push_back(header);
+    return true;
+}
+
+/**
+ * Finds a header by name (case insensitive). When a header is repeated, the last one wins.
+ * 
+ * @param headerName The name of the header.
+ * @return The position of the header in rawData_, NULL if the header is missing.
+ */
+const HttpRequest::HeaderSpan* HttpRequest::findHeader(const std::string& headerName) const {
+    for (size_t i = headers_.size(); i > 0; --i) {
+        if (headerNameIs(headers_[i - 1], headerName)) {
+            return &headers_[i - 1];
+        }
+    }
+    return NULL;
+}
+
+// Compares the name of a header with headerName (case insensitive)
+bool HttpRequest::headerNameIs(const HeaderSpan& header, const std::string& headerName) const {
+    if (header.nameLength != headerName.size()) {
+        return false;
+    }
+    for (size_t j = 0; j < header.nameLength; ++j) {
+        if (std::tolower(static_cast<unsigned char>(rawData_[header.nameStart + j])) != std::tolower(static_cast<unsigned char>(headerName[j]))) {
+            return false;
+        }
+    }
+    return true;
 }
 
 /**
@@ -479,9 +942,9 @@ const std::string& HttpRequest::getHttpVersion() const {
 }
 
 std::string HttpRequest::getHeader(const std::string& headerName) const {
-    std::map<std::string, std::string>::const_iterator it = headers_.find(headerName);
-    if (it != headers_.end()) {
-        return it->second;
+    const HeaderSpan* header = findHeader(headerName);
+    if (header != NULL) {
+        return rawData_.substr(header->valueStart, header->valueLength);
     }
     return "";
 }
@@ -490,10 +953,30 @@ const std::string& HttpRequest::getBody() const {
     return body_;
 }
 
+// Gives the body to its consumer without copying it (e.g. CGI stdin), body_ is left empty
+void HttpRequest::moveBodyTo(std::string& destination) {
+    destination.clear();
+    destination.swap(body_);
+}
+
 std::string HttpRequest::getQueryString() const {
         return queryString_;
 }
 
+bool HttpRequest::isKeepAlive() const {
+    return keepAlive_;
+}
+
+// Used when the server decides to close the connection anyway (keepalive_requests reached ...)
+void HttpRequest::disableKeepAlive() {
+    keepAlive_ = false;
+}
+
+// true if a request is being received, or if bytes of a (next) request have already been received
+bool HttpRequest::hasPendingData() const {
+    return state_ != REQUEST_LINE || rawData_.size() > parsePos_;
+}
+
 bool HttpRequest::hasParseError() const {
     return parseError_;
 }
@@ -522,13 +1005,21 @@ void HttpRequest::displayContent() const
 
 /**
  * Resets the state of the HttpRequest object.
- * This function clears all data, including raw data, headers, method, path, body, and any parsing state.
- * It's useful for reusing the object to parse a new request.
+ * This function clears all data, including headers, method, path, body, and any parsing state.
+ * It's useful for reusing the object to parse a new request on a persistent connection : 
+ * the bytes received after the end of the current request (pipelined requests) are kept in rawData_.
  * 
  * @return void
  */
 void HttpRequest::reset() {
-    rawData_.clear();
+    // The body has already been moved to body_ : everything after parsePos_ belongs to the next request
+    if (state_ == COMPLETE) {
+        rawData_.erase(0, parsePos_);
+    } else {
+        rawData_.clear();
+    }
+    parsePos_ = 0;
+    scanPos_ = 0;
     method_.clear();
     rawPath_.clear();
     path_.clear();
@@ -536,8 +1027,16 @@ void HttpRequest::reset() {
     httpVersion_.clear();
     body_.clear();
     contentLength_ = 0;
-    bodyStartPos_ = 0;
+    headersEndPos_ = 0;
+    maxBodySize_ = 0;
+    bodyLimitSet_ = false;
+    chunked_ = false;
+    chunkRemaining_ = 0;
+    bodyReceived_ = 0;
+    delete bodySink_;
+    bodySink_ = NULL;
     headersParsed_ = false;
+    keepAlive_ = false;
     state_ = REQUEST_LINE;
     headers_.clear();
 }
@@ -2,6 +2,7 @@
 #include "../includes/Color_Macros.hpp"
 #include <sstream>
 #include <iostream>
+#include <strings.h>
 
 /*
     classe qui contient les attributs necessaires a la construction d' une reponse http
@@ -10,10 +11,50 @@
 */
 
 HttpResponse::HttpResponse()
-    : statusCode(200), reasonPhrase("OK"), body("") {
+    : statusCode(200), reasonPhrase("OK"), body(""), bodyFd(-1), bodyFileOffset(0), bodyFileLength(0),
+      sharedResponse(NULL), sharedHeaderLength(0), gzipLevel(0) {
     headers["Content-Type"] = "text/html";
 }
 
+HttpResponse::HttpResponse(const HttpResponse& other)
+    : statusCode(other.statusCode), reasonPhrase(other.reasonPhrase), body(other.body), headers(other.headers),
+      bodyFd(other.bodyFd), bodyFileOffset(other.bodyFileOffset), bodyFileLength(other.bodyFileLength),
+      bodyFileParts(other.bodyFileParts),
+      sharedResponse(other.sharedResponse), sharedHeaderLength(other.sharedHeaderLength), gzipLevel(other.gzipLevel) {
+    if (sharedResponse) {
+        sharedResponse->retain();
+    }
+}
+
+HttpResponse& HttpResponse::operator=(const HttpResponse& other) {
+    if (this != &other) {
+        if (other.sharedResponse) {
+            other.sharedResponse->retain();
+        }
+        if (sharedResponse) {
+            sharedResponse->release();
+        }
+        statusCode = other.statusCode;
+        reasonPhrase = other.reasonPhrase;
+        body = other.body;
+        headers = other.headers;
+        bodyFd = other.bodyFd;
+        bodyFileOffset = other.bodyFileOffset;
+        bodyFileLength = other.bodyFileLength;
+        bodyFileParts = other.bodyFileParts;
+        sharedResponse = other.sharedResponse;
+        sharedHeaderLength = other.sharedHeaderLength;
+        gzipLevel = other.gzipLevel;
+    }
+    return *this;
+}
+
+HttpResponse::~HttpResponse() {
+    if (sharedResponse) {
+        sharedResponse->release();
+    }
+}
+
 void HttpResponse::setStatusCode(int code) {
     statusCode = code;
     reasonPhrase = getDefaultReasonPhrase(code);
@@ -25,37 +66,172 @@ void HttpResponse::setReasonPhrase(const std::string& phrase) {
 
 void HttpResponse::setBody(const std::string& bodyContent) {
     body = bodyContent;
+    bodyFd = -1;
+    bodyFileOffset = 0;
+    bodyFileLength = 0;
+    bodyFileParts.clear();
     // Update Content-Length header
     std::ostringstream oss;
     oss << body.size();
     headers["Content-Length"] = oss.str();
 }
 
+/**
+ * Uses `length` bytes of an open file, starting at `offset`, as the body of the response.
+ * The file is not read here : it will be streamed to the client by the DataSocket (sendfile).
+ * With a fd of -1 (HEAD), only the Content-Length of the body is set.
+ */
+void HttpResponse::setBodyFile(int fd, off_t offset, size_t length) {
+    body.clear();
+    bodyFd = fd;
+    bodyFileOffset = offset;
+    bodyFileLength = length;
+    bodyFileParts.clear();
+    std::ostringstream oss;
+    oss << length;
+    headers["Content-Length"] = oss.str();
+}
+
+/**
+ * Uses several slices of an open file, each one after its part headers, as the body of the response 
+ * (multipart/byteranges). Like with setBodyFile(), the file is streamed by the DataSocket.
+ */
+void HttpResponse::setBodyFileParts(int fd, const std::vector<BodyFilePart>& parts) {
+    body.clear();
+    bodyFd = fd;
+    bodyFileParts = parts;
+    size_t length = 0;
+    for (size_t i = 0; i < parts.size(); ++i) {
+        length += parts[i].header.size() + parts[i].length;
+    }
+    bodyFileOffset = 0;
+    bodyFileLength = length;
+    std::ostringstream oss;
+    oss << length;
+    headers["Content-Length"] = oss.str();
+}
+
+/**
+ * Uses a response already serialized (status line and headers without the final empty line, then the body).
+ * Only the Connection header is added by the DataSocket that sends it, after the headers set from now on.
+ *
+ * @param headerLength Length of the status line and headers in `response`.
+ */
+void HttpResponse::setSharedResponse(SharedBuffer* response, size_t headerLength) {
+    response->retain();
+    if (sharedResponse) {
+        sharedResponse->release();
+    }
+    body.clear();
+    headers.clear();
+    sharedResponse = response;
+    sharedHeaderLength = headerLength;
+}
+
+int HttpResponse::getStatusCode() const {
+    return statusCode;
+}
+
+const std::string& HttpResponse::getBody() const {
+    return body;
+}
+
+bool HttpResponse::hasBodyFile() const {
+    return bodyFd != -1;
+}
+
+int HttpResponse::getBodyFd() const {
+    return bodyFd;
+}
+
+off_t HttpResponse::getBodyFileOffset() const {
+    return bodyFileOffset;
+}
+
+size_t HttpResponse::getBodyFileLength() const {
+    return bodyFileLength;
+}
+
+const std::vector<BodyFilePart>& HttpResponse::getBodyFileParts() const {
+    return bodyFileParts;
+}
+
+bool HttpResponse::hasSharedResponse() const {
+    return sharedResponse != NULL;
+}
+
+SharedBuffer* HttpResponse::getSharedResponse() const {
+    return sharedResponse;
+}
+
+size_t HttpResponse::getSharedHeaderLength() const {
+    return sharedHeaderLength;
+}
+
 void HttpResponse::setHeader(const std::string& headerName, const std::string& headerValue) {
     headers[headerName] = headerValue;
 }
 
-std::string HttpResponse::generateResponse() const {
-    // std::cout << YELLOW <<"\n\n\n\nREPONSE :HttpResponse::generateResponse()\n"<< std::endl;//test
+void HttpResponse::removeHeader(const std::string& headerName) {
+    headers.erase(headerName);
+}
+
+// Value of a header (name case insensitive, the headers of a CGI keep the case of the script), empty if it is not set
+std::string HttpResponse::getHeader(const std::string& headerName) const {
+    for (std::map<std::string, std::string>::const_iterator it = headers.begin(); it != headers.end(); ++it) {
+        if (it->first.size() == headerName.size() && strcasecmp(it->first.c_str(), headerName.c_str()) == 0) {
+            return it->second;
+        }
+    }
+    return "";
+}
+
+/**
+ * Marks the body to be compressed with gzip when it is sent (0 : sent as it is). The DataSocket replaces 
+ * Content-Length by Content-Encoding and chunked framing (or closes the connection for HTTP/1.0 clients).
+ */
+void HttpResponse::setGzipLevel(int level) {
+    gzipLevel = level;
+}
+
+int HttpResponse::getGzipLevel() const {
+    return gzipLevel;
+}
+
+// Status line and headers, ended by the empty line that separates them from the body
+std::string HttpResponse::generateHeaders() const {
     std::ostringstream response;
 
     // Status line
     response << "HTTP/1.1 " << statusCode << " " << reasonPhrase << "\r\n";
 
     // Headers
+    response << generateHeaderFields();
+
+    response << "\r\n"; // Empty line to separate headers from body
+    return response.str();
+}
+
+// One "Name: value" line per header
+std::string HttpResponse::generateHeaderFields() const {
+    std::string fields;
     for (std::map<std::string, std::string>::const_iterator it = headers.begin(); it != headers.end(); ++it) {
-        response << it->first << ": " << it->second << "\r\n";
+        fields.append(it->first).append(": ").append(it->second).append("\r\n");
     }
+    return fields;
+}
 
-    response << "\r\n"; // Empty line to separate headers from body
+std::string HttpResponse::generateResponse() const {
+    // std::cout << YELLOW <<"\n\n\n\nREPONSE :HttpResponse::generateResponse()\n"<< std::endl;//test
+    std::string response = generateHeaders();
 
-    // std::cout << "HEADERS\n" << response.str() << RESET << std::endl;//test
+    // std::cout << "HEADERS\n" << response << RESET << std::endl;//test
     // std::cout << "\nBODY\n" << body << RESET << std::endl;//test
 
     // Body
-    response << body;
+    response.append(body);
 
-    return response.str();
+    return response;
 }
 
 std::string HttpResponse::getDefaultReasonPhrase(int code) const {
@@ -63,8 +239,13 @@ std::string HttpResponse::getDefaultReasonPhrase(int code) const {
         case 200: return "OK";
         case 201: return "Created";
         case 204: return "No Content";
+        case 206: return "Partial Content";
         case 301: return "Moved Permanently";
         case 302: return "Found";
+        case 303: return "See Other";
+        case 304: return "Not Modified";
+        case 307: return "Temporary Redirect";
+        case 308: return "Permanent Redirect";
         case 400: return "Bad Request";
         case 401: return "Unauthorized";
         case 403: return "Forbidden";
@@ -72,8 +253,10 @@ std::string HttpResponse::getDefaultReasonPhrase(int code) const {
         case 405: return "Method not Allowed";
         case 408: return "Request Timeout";
         case 411: return "Length Required";
+        case 413: return "Payload Too Large";
         case 414: return "URI Too Long";
         case 415: return "Unsupported Media Type";
+        case 416: return "Range Not Satisfiable";
         case 500: return "Internal Server Error";
         case 501: return "Not Implemented";
         case 502: return "Bad Gateway";
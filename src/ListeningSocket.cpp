@@ -3,6 +3,8 @@
 #include <unistd.h>
 #include <cstring>
 #include <arpa/inet.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <iostream>
 
 // ListeningSocket::ListeningSocket(uint32_t host, uint16_t port) {
@@ -50,18 +52,37 @@ std::string printIp(uint32_t host, uint16_t port) {
     return ss.str();
 }
 
-ListeningSocket::ListeningSocket(uint32_t host, uint16_t port) {
+ListeningSocket::ListeningSocket(uint32_t host, uint16_t port, int backlog, bool reusePort) {
     listeningSocket_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (listeningSocket_fd == -1) {
         throw std::runtime_error("Error creating listening socket");
     }
 
+    // accept() returns -1 once every pending connection has been accepted, instead of blocking
+    if (fcntl(listeningSocket_fd, F_SETFL, O_NONBLOCK) == -1 || fcntl(listeningSocket_fd, F_SETFD, FD_CLOEXEC) == -1) {
+        close(listeningSocket_fd);
+        throw std::runtime_error("Error setting listening socket non-blocking");
+    }
+
     int opt = 1;
     if (setsockopt(listeningSocket_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
         close(listeningSocket_fd);
         throw std::runtime_error("Error setting socket options");
     }
 
+    // Every worker binds its own socket on the same IP:PORT
+    if (reusePort) {
+#ifdef SO_REUSEPORT
+        if (setsockopt(listeningSocket_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+            close(listeningSocket_fd);
+            throw std::runtime_error("Error setting socket option SO_REUSEPORT");
+        }
+#else
+        close(listeningSocket_fd);
+        throw std::runtime_error("SO_REUSEPORT is not available, 'workers' must be 1");
+#endif
+    }
+
     address.sin_family = AF_INET;
     address.sin_addr.s_addr = host;
     address.sin_port = port;
@@ -71,7 +92,7 @@ ListeningSocket::ListeningSocket(uint32_t host, uint16_t port) {
         throw std::runtime_error("Error binding socket to " + printIp(host, port));
     }
 
-    if (listen(listeningSocket_fd, SOMAXCONN) < 0) {
+    if (listen(listeningSocket_fd, backlog) < 0) {
         close(listeningSocket_fd);
         throw std::runtime_error("Error listening on socket " + printIp(host, port));
     }
@@ -83,13 +104,33 @@ ListeningSocket::~ListeningSocket() {
 
 void ListeningSocket::addServer(Server* server) {
     associatedServers.push_back(server);
+    virtualHosts.addServer(server);
 }
 
-int ListeningSocket::acceptConnection() {
-    int addrlen = sizeof(address);
-    int new_socket = accept(listeningSocket_fd, (struct sockaddr *)&address, (socklen_t*)&addrlen);
-    if (new_socket < 0) {
-        std::cerr << "Error creating a new Datasocket (communication with a new client can't be accepted)" << std::endl;
+/**
+ * Accepts a pending connection, without blocking. The new socket is non-blocking and close-on-exec.
+ *
+ * @param peerAddress Filled with the address of the client.
+ * @return The fd of the connection, -1 if none is pending (or on error), ACCEPT_OUT_OF_FDS if the process has no
+ *         fd left for it.
+ */
+int ListeningSocket::acceptConnection(struct sockaddr_in& peerAddress) {
+    socklen_t addrlen = sizeof(peerAddress);
+#ifdef __linux__
+    int new_socket = accept4(listeningSocket_fd, (struct sockaddr *)&peerAddress, &addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+    int new_socket = accept(listeningSocket_fd, (struct sockaddr *)&peerAddress, &addrlen);
+    if (new_socket >= 0 && (fcntl(new_socket, F_SETFL, O_NONBLOCK) == -1 || fcntl(new_socket, F_SETFD, FD_CLOEXEC) == -1)) {
+        close(new_socket);
+        new_socket = -1;
+    }
+#endif
+    if (new_socket < 0 && (errno == EMFILE || errno == ENFILE)) {
+        return ACCEPT_OUT_OF_FDS;
+    }
+    // No connection left to accept, or the client gave up before being accepted : not an error
+    if (new_socket < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNABORTED && errno != EINTR) {
+        std::cerr << "Error creating a new Datasocket (communication with a new client can't be accepted): " << strerror(errno) << std::endl;
     }
     return new_socket;
 }
@@ -102,3 +143,7 @@ const std::vector<Server*>& ListeningSocket::getAssociatedServers() const {
     return associatedServers;
 }
 
+const VirtualHostTable& ListeningSocket::getVirtualHosts() const {
+    return virtualHosts;
+}
+
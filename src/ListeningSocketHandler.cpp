@@ -25,7 +25,18 @@ void ListeningSocketHandler::cleanUp() {
     listeningSocketsMap_.clear();
 }
 
-void ListeningSocketHandler::initialize(const std::vector<Server*>& servers) {
+// Largest 'backlog=' of the servers listening on an IP:PORT, DEFAULT_LISTEN_BACKLOG if none sets it
+int ListeningSocketHandler::getListenBacklog(const std::vector<Server*>& servers, const std::pair<uint32_t, uint16_t>& key) const {
+    int backlog = 0;
+    for (size_t i = 0; i < servers.size(); ++i) {
+        if (servers[i]->getHost() == key.first && servers[i]->getPort() == key.second && servers[i]->getListenBacklog() > backlog) {
+            backlog = servers[i]->getListenBacklog();
+        }
+    }
+    return backlog > 0 ? backlog : DEFAULT_LISTEN_BACKLOG;
+}
+
+void ListeningSocketHandler::initialize(const std::vector<Server*>& servers, bool reusePort) {
     for (size_t i = 0; i < servers.size(); ++i) {
         Server* server = servers[i];
         uint32_t host = server->getHost();
@@ -35,12 +46,17 @@ void ListeningSocketHandler::initialize(const std::vector<Server*>& servers) {
         try {
             // research if a socket already exists at this ip:port
             if (listeningSocketsMap_.find(key) == listeningSocketsMap_.end()) {
-                ListeningSocket* newSocket = new ListeningSocket(host, port);
+                ListeningSocket* newSocket = new ListeningSocket(host, port, getListenBacklog(servers, key), reusePort);
                 listeningSocketsMap_[key] = newSocket;
                 addListeningSocket(newSocket);
             }
 
-            // link Listening socket to the server config associated
+            // Only one default server for each IP:PORT
+            const Server* defaultServer = listeningSocketsMap_[key]->getVirtualHosts().getDefaultServer();
+            if (server->isDefaultServer() && defaultServer != NULL && defaultServer->isDefaultServer()) {
+                throw std::runtime_error("Error : several default_server for " + printIp(host, port));
+            }
+            // link Listening socket to the server config associated (indexed by its names)
             listeningSocketsMap_[key]->addServer(server);
         } catch (const std::runtime_error& e) {
             // Webserv will not run, critical error
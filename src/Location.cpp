@@ -1,6 +1,8 @@
 #include "../includes/Location.hpp"
 #include "../includes/Server.hpp"
 #include <iostream>
+#include <algorithm>
+#include <cctype>
 
 Location::Location(const Server &server, const std::string &path)
     : server_(server),                 
@@ -12,13 +14,23 @@ Location::Location(const Server &server, const std::string &path)
       index_(""),                     
       errorPages_(),                 
       path_(path),                   
+      exactMatch_(false),
       allowedMethods_(),             
       redirection_(""),               
       autoIndex_(false),             
       cgiEnable_(false),             
       cgiExtension_(""),             
       uploadEnable_(false),            
-      uploadStore_("")                 
+      uploadStore_(""),
+      fastCgiPass_(""),
+      staticCache_(false),
+      staticCacheMaxSize_(DEFAULT_STATIC_CACHE_MAX_SIZE),
+      gzipStatic_(false),
+      brotliStatic_(false),
+      gzip_(false),
+      gzipTypes_(1, "text/html"),
+      gzipMinLength_(DEFAULT_GZIP_MIN_LENGTH),
+      gzipCompLevel_(DEFAULT_GZIP_COMP_LEVEL)
 {
 }
 
@@ -36,6 +48,16 @@ const std::string &Location::getPath() const
     return path_;
 }
 
+void Location::setExactMatch(bool exactMatch)
+{
+    exactMatch_ = exactMatch;
+}
+
+bool Location::isExactMatch() const
+{
+    return exactMatch_;
+}
+
 void Location::setAllowedMethods(const std::vector<std::string> &methods)
 {
     allowedMethods_ = methods;
@@ -133,6 +155,148 @@ const std::string &Location::getUploadStore() const
     return uploadStore_;
 }
 
+void Location::setFastCgiPass(const std::string &socketPath)
+{
+    fastCgiPass_ = socketPath;
+}
+
+const std::string &Location::getFastCgiPass() const
+{
+    return fastCgiPass_;
+}
+
+void Location::setStaticCache(bool enable)
+{
+    staticCache_ = enable;
+}
+
+bool Location::getStaticCache() const
+{
+    return staticCache_;
+}
+
+void Location::setStaticCacheMaxSize(size_t size)
+{
+    staticCacheMaxSize_ = size;
+}
+
+size_t Location::getStaticCacheMaxSize() const
+{
+    return staticCacheMaxSize_;
+}
+
+void Location::setGzipStatic(bool enable)
+{
+    gzipStatic_ = enable;
+}
+
+bool Location::getGzipStatic() const
+{
+    return gzipStatic_;
+}
+
+void Location::setBrotliStatic(bool enable)
+{
+    brotliStatic_ = enable;
+}
+
+bool Location::getBrotliStatic() const
+{
+    return brotliStatic_;
+}
+
+void Location::setGzip(bool enable)
+{
+    gzip_ = enable;
+}
+
+bool Location::getGzip() const
+{
+    return gzip_;
+}
+
+// text/html is always compressed, like with nginx
+void Location::setGzipTypes(const std::vector<std::string> &types)
+{
+    gzipTypes_.assign(1, "text/html");
+    for (size_t i = 0; i < types.size(); ++i)
+    {
+        std::string type = types[i];
+        for (size_t c = 0; c < type.size(); ++c)
+            type[c] = tolower(static_cast<unsigned char>(type[c]));
+        if (std::find(gzipTypes_.begin(), gzipTypes_.end(), type) == gzipTypes_.end())
+            gzipTypes_.push_back(type);
+    }
+}
+
+const std::vector<std::string> &Location::getGzipTypes() const
+{
+    return gzipTypes_;
+}
+
+// Compares the media type of a Content-Type value ("text/html; charset=UTF-8" -> "text/html"), '*' matches any type
+bool Location::isGzipType(const std::string &contentType) const
+{
+    std::string type = contentType.substr(0, contentType.find(';'));
+    size_t end = type.find_last_not_of(" \t");
+    type.erase(end == std::string::npos ? 0 : end + 1);
+    for (size_t c = 0; c < type.size(); ++c)
+        type[c] = tolower(static_cast<unsigned char>(type[c]));
+    for (size_t i = 0; i < gzipTypes_.size(); ++i)
+    {
+        if (gzipTypes_[i] == "*" || gzipTypes_[i] == type)
+            return true;
+    }
+    return false;
+}
+
+void Location::setGzipMinLength(size_t length)
+{
+    gzipMinLength_ = length;
+}
+
+size_t Location::getGzipMinLength() const
+{
+    return gzipMinLength_;
+}
+
+void Location::setGzipCompLevel(int level)
+{
+    gzipCompLevel_ = level;
+}
+
+int Location::getGzipCompLevel() const
+{
+    return gzipCompLevel_;
+}
+
+/**
+ * Computes the directory the CGI scripts of the location are run in and the variables of their environment that are
+ * the same for every request (the request ones are added by the RequestHandler).
+ *
+ * @param currentDir The working directory of webserv : the roots are relative to it.
+ */
+void Location::compileCgiEnvironment(const std::string &currentDir)
+{
+    std::string documentRoot = currentDir + "/" + server_.getRoot();
+    cgiWorkingDir_ = documentRoot + "/" + path_ + "/";
+    cgiEnvironment_.clear();
+    cgiEnvironment_.push_back("GATEWAY_INTERFACE=CGI/1.1");
+    cgiEnvironment_.push_back("SERVER_PROTOCOL=HTTP/1.1");
+    cgiEnvironment_.push_back("SERVER_SOFTWARE=webserv");
+    cgiEnvironment_.push_back("DOCUMENT_ROOT=" + documentRoot);
+}
+
+const std::string &Location::getCgiWorkingDir() const
+{
+    return cgiWorkingDir_;
+}
+
+const std::vector<std::string> &Location::getCgiEnvironment() const
+{
+    return cgiEnvironment_;
+}
+
 void Location::setClientMaxBodySize(size_t size)
 {
     clientMaxBodySize_ = size;
@@ -172,7 +336,11 @@ const std::string Location::getErrorPage(int errorCode) const
 const std::string Location::getErrorPageFullPath(int errorCode) const
 {
     // std::cout << "Location::getErrorPageFullPath" << std::endl;//debug
-    return(getRoot() + getErrorPage(errorCode));
+    // No error_page for this code : empty, the default body is used (the root is not a page)
+    std::string errorPage = getErrorPage(errorCode);
+    if (errorPage.empty())
+        return "";
+    return(getRoot() + errorPage);
 }
 
 
@@ -194,7 +362,7 @@ bool Location::getClientMaxBodySizeIsSet() const
 // DEBUG
 void Location::displayLocation() const
 {
-    std::cout << "  Location " << this->getPath() << ":" << std::endl;
+    std::cout << "  Location " << (this->isExactMatch() ? "= " : "") << this->getPath() << ":" << std::endl;
     std::cout << "    root: " << this->getRoot() << std::endl;
     std::cout << "    index: " << this->getIndex() << std::endl;
     std::cout << "    autoindex: " << (this->getAutoIndex() ? "on" : "off") << std::endl;
@@ -230,6 +398,34 @@ void Location::displayLocation() const
         std::cout << "    upload_store: " << this->getUploadStore() << std::endl;
     }
 
+    if (!this->getFastCgiPass().empty())
+    {
+        std::cout << "    fastcgi_pass: " << this->getFastCgiPass() << std::endl;
+    }
+
+    if (this->getStaticCache())
+    {
+        std::cout << "    static_cache: on (max size " << this->getStaticCacheMaxSize() << ")" << std::endl;
+    }
+
+    if (this->getGzipStatic())
+    {
+        std::cout << "    gzip_static: on" << std::endl;
+    }
+
+    if (this->getBrotliStatic())
+    {
+        std::cout << "    brotli_static: on" << std::endl;
+    }
+
+    if (this->getGzip())
+    {
+        std::cout << "    gzip: on (level " << this->getGzipCompLevel() << ", min length " << this->getGzipMinLength() << ", types";
+        for (size_t t = 0; t < gzipTypes_.size(); ++t)
+            std::cout << " " << gzipTypes_[t];
+        std::cout << ")" << std::endl;
+    }
+
     std::cout << "    client_max_body_size: " << this->getClientMaxBodySize() << std::endl;
 
     // Affichage des pages d'erreur de la location
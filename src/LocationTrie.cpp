@@ -0,0 +1,100 @@
+// LocationTrie.cpp
+#include "LocationTrie.hpp"
+#include "Location.hpp"
+
+LocationTrie::LocationTrie() : root_(new Node("")) {}
+
+LocationTrie::~LocationTrie() {
+    deleteNode(root_);
+}
+
+void LocationTrie::clear() {
+    deleteNode(root_);
+    root_ = new Node("");
+}
+
+void LocationTrie::deleteNode(Node* node) {
+    for (std::map<char, Node*>::iterator it = node->children.begin(); it != node->children.end(); ++it) {
+        deleteNode(it->second);
+    }
+    delete node;
+}
+
+/**
+ * Adds a location to the trie : the edge the path leaves in the middle is split, so that every location
+ * path ends on a node.
+ *
+ * @param location A location of the server, which must outlive the trie.
+ */
+void LocationTrie::insert(const Location* location) {
+    const std::string& path = location->getPath();
+    Node* node = root_;
+    size_t position = 0;
+
+    while (position < path.size()) {
+        std::map<char, Node*>::iterator it = node->children.find(path[position]);
+        if (it == node->children.end()) {
+            Node* child = new Node(path.substr(position));
+            node->children[path[position]] = child;
+            node = child;
+            break;
+        }
+        Node* child = it->second;
+        size_t common = 0;
+        while (common < child->label.size() && position + common < path.size()
+               && child->label[common] == path[position + common]) {
+            ++common;
+        }
+        if (common < child->label.size()) {
+            // The path leaves the edge : a node is inserted where they differ
+            Node* middle = new Node(child->label.substr(0, common));
+            child->label.erase(0, common);
+            middle->children[child->label[0]] = child;
+            it->second = middle;
+            child = middle;
+        }
+        node = child;
+        position += common;
+    }
+
+    const Location*& slot = location->isExactMatch() ? node->exactLocation : node->prefixLocation;
+    if (slot == NULL) {
+        slot = location;
+    }
+}
+
+// True if a prefix location that ends `position` characters into `path` is on a segment boundary
+static bool isSegmentBoundary(const std::string& path, size_t position) {
+    return position == 0 || position == path.size() || path[position] == '/' || path[position - 1] == '/';
+}
+
+/**
+ * Selects the location of a request path, in a single pass over the path.
+ *
+ * @param path The path of the request (without query string).
+ * @return The exact location of the path, else the longest prefix location, NULL if no location matches.
+ */
+const Location* LocationTrie::find(const std::string& path) const {
+    const Node* node = root_;
+    size_t position = 0;
+    const Location* matched = NULL;
+
+    while (true) {
+        if (node->prefixLocation != NULL && isSegmentBoundary(path, position)) {
+            matched = node->prefixLocation;
+        }
+        if (position == path.size()) {
+            if (node->exactLocation != NULL) {
+                return node->exactLocation;
+            }
+            break;
+        }
+        std::map<char, Node*>::const_iterator it = node->children.find(path[position]);
+        if (it == node->children.end() || path.compare(position, it->second->label.size(), it->second->label) != 0) {
+            break;
+        }
+        node = it->second;
+        position += node->label.size();
+    }
+    return matched;
+}
@@ -0,0 +1,258 @@
+// MultipartUploadSink.cpp
+#include "MultipartUploadSink.hpp"
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <algorithm>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+MultipartUploadSink::MultipartUploadSink(const std::string& uploadDirectory, const std::string& boundary)
+    : state_(PREAMBLE), uploadDirectory_(uploadDirectory), delimiter_("\r\n--" + boundary),
+      errorCode_(0), fileFd_(-1), savedFilesCount_(0)
+{
+    // Boyer-Moore-Horspool : shift applied when the last byte of the window is c
+    size_t length = delimiter_.size();
+    for (size_t c = 0; c < 256; ++c) {
+        skipTable_[c] = length;
+    }
+    for (size_t i = 0; i + 1 < length; ++i) {
+        skipTable_[static_cast<unsigned char>(delimiter_[i])] = length - 1 - i;
+    }
+    // The first delimiter may be at the very beginning of the body, without the CRLF before it
+    buffer_ = "\r\n";
+}
+
+MultipartUploadSink::~MultipartUploadSink() {
+    discardPart();
+}
+
+/**
+ * Consumes a piece of the multipart body. Part payloads are written as soon as it is certain they are not 
+ * the beginning of the next delimiter.
+ *
+ * @param data Body bytes, in order.
+ * @param length Number of bytes.
+ * @return false if the body is malformed or a file can't be written (see getErrorCode()).
+ */
+bool MultipartUploadSink::write(const char* data, size_t length) {
+    if (errorCode_ != 0) {
+        return false;
+    }
+    buffer_.append(data, length);
+
+    size_t pos = 0;
+    bool needMoreData = false;
+    while (!needMoreData) {
+        if (state_ == PREAMBLE || state_ == PART_DATA) {
+            size_t found = findDelimiter(pos);
+            if (found == std::string::npos) {
+                // The last bytes may be the beginning of a delimiter split between two chunks
+                size_t keep = std::min(buffer_.size() - pos, delimiter_.size() - 1);
+                size_t end = buffer_.size() - keep;
+                if (state_ == PART_DATA && !writePartData(buffer_.data() + pos, end - pos)) {
+                    return false;
+                }
+                pos = end;
+                needMoreData = true;
+            } else {
+                if (state_ == PART_DATA && (!writePartData(buffer_.data() + pos, found - pos) || !closePart())) {
+                    return false;
+                }
+                pos = found + delimiter_.size();
+                state_ = AFTER_DELIMITER;
+            }
+        } else if (state_ == AFTER_DELIMITER) {
+            // "--" closes the body, CRLF begins a new part
+            if (buffer_.size() - pos < 2) {
+                needMoreData = true;
+            } else if (buffer_.compare(pos, 2, "--") == 0) {
+                state_ = EPILOGUE;
+            } else if (buffer_.compare(pos, 2, "\r\n") == 0) {
+                pos += 2;
+                state_ = PART_HEADERS;
+            } else {
+                return fail(400);
+            }
+        } else if (state_ == PART_HEADERS) {
+            size_t end = std::string::npos;
+            size_t headersLength = 0;
+            if (buffer_.compare(pos, 2, "\r\n") == 0) {
+                // Part without headers
+                end = pos;
+            } else {
+                end = buffer_.find("\r\n\r\n", pos);
+                headersLength = (end == std::string::npos) ? 0 : end - pos + 2;
+            }
+            if (end == std::string::npos) {
+                if (buffer_.size() - pos > MAX_PART_HEADERS_LENGTH) {
+                    return fail(400);
+                }
+                needMoreData = true;
+            } else {
+                if (!parsePartHeaders(buffer_.substr(pos, headersLength))) {
+                    return false;
+                }
+                pos += headersLength + 2;
+                state_ = PART_DATA;
+            }
+        } else {
+            // EPILOGUE : everything after the closing delimiter is ignored
+            pos = buffer_.size();
+            needMoreData = true;
+        }
+    }
+    buffer_.erase(0, pos);
+    return true;
+}
+
+/**
+ * Called when the whole body has been received : the closing delimiter must have been found.
+ */
+bool MultipartUploadSink::finish() {
+    if (errorCode_ != 0) {
+        return false;
+    }
+    if (state_ != EPILOGUE) {
+        std::cerr << "Error : Multipart body truncated" << std::endl;
+        return fail(400);
+    }
+    return true;
+}
+
+int MultipartUploadSink::getErrorCode() const {
+    return errorCode_;
+}
+
+size_t MultipartUploadSink::getSavedFilesCount() const {
+    return savedFilesCount_;
+}
+
+/**
+ * Boyer-Moore-Horspool search of the delimiter in buffer_.
+ *
+ * @param from Position where the search begins.
+ * @return The position of the delimiter, std::string::npos if it is not in the buffer.
+ */
+size_t MultipartUploadSink::findDelimiter(size_t from) const {
+    size_t length = delimiter_.size();
+    size_t last = length - 1;
+    size_t pos = from;
+    while (pos + length <= buffer_.size()) {
+        size_t i = last;
+        while (buffer_[pos + i] == delimiter_[i]) {
+            if (i == 0) {
+                return pos;
+            }
+            --i;
+        }
+        pos += skipTable_[static_cast<unsigned char>(buffer_[pos + last])];
+    }
+    return std::string::npos;
+}
+
+/**
+ * Reads the filename of a part (Content-Disposition: form-data; name="file"; filename="a.txt") and opens 
+ * its temporary file. Only the last path component of the filename is used.
+ */
+bool MultipartUploadSink::parsePartHeaders(const std::string& headers) {
+    std::string filenamePrefix = "filename=\"";
+    std::string::size_type filenamePos = headers.find(filenamePrefix);
+    if (filenamePos == std::string::npos) {
+        // Form field, not a file
+        return true;
+    }
+    filenamePos += filenamePrefix.length();
+    std::string::size_type filenameEndPos = headers.find("\"", filenamePos);
+    if (filenameEndPos == std::string::npos) {
+        return fail(400);
+    }
+    std::string filename = headers.substr(filenamePos, filenameEndPos - filenamePos);
+
+    // A filename can't leave the upload directory
+    std::string::size_type slashPos = filename.find_last_of("/\\");
+    if (slashPos != std::string::npos) {
+        filename = filename.substr(slashPos + 1);
+    }
+    if (filename.empty()) {
+        // No file selected in the form
+        return true;
+    }
+    if (filename == "." || filename == "..") {
+        return fail(400);
+    }
+    finalPath_ = uploadDirectory_ + "/" + filename;
+
+    std::string tempTemplate = uploadDirectory_ + "/.upload-XXXXXX";
+    std::vector<char> tempPath(tempTemplate.begin(), tempTemplate.end());
+    tempPath.push_back('\0');
+    fileFd_ = mkstemp(&tempPath[0]);
+    if (fileFd_ == -1) {
+        std::cerr << "Error : Failed to create temporary upload file in " << uploadDirectory_ << ": " << strerror(errno) << std::endl;
+        return fail(500);
+    }
+    tempPath_ = &tempPath[0];
+    fcntl(fileFd_, F_SETFD, FD_CLOEXEC);
+    // mkstemp creates the file with 0600, uploaded files keep the usual permissions
+    mode_t mask = umask(0);
+    umask(mask);
+    fchmod(fileFd_, 0666 & ~mask);
+    return true;
+}
+
+bool MultipartUploadSink::writePartData(const char* data, size_t length) {
+    if (fileFd_ == -1) {
+        return true;
+    }
+    while (length > 0) {
+        ssize_t written = ::write(fileFd_, data, length);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Error : Failed to save file: " << finalPath_ << ": " << strerror(errno) << std::endl;
+            return fail(500);
+        }
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+/**
+ * The part is complete : its temporary file gets its final name.
+ */
+bool MultipartUploadSink::closePart() {
+    if (fileFd_ == -1) {
+        return true;
+    }
+    int ret = close(fileFd_);
+    fileFd_ = -1;
+    if (ret == -1 || rename(tempPath_.c_str(), finalPath_.c_str()) == -1) {
+        std::cerr << "Error : Failed to save file: " << finalPath_ << ": " << strerror(errno) << std::endl;
+        return fail(500);
+    }
+    tempPath_.clear();
+    ++savedFilesCount_;
+    return true;
+}
+
+// Removes the temporary file of an unfinished part
+void MultipartUploadSink::discardPart() {
+    if (fileFd_ != -1) {
+        close(fileFd_);
+        fileFd_ = -1;
+    }
+    if (!tempPath_.empty()) {
+        unlink(tempPath_.c_str());
+        tempPath_.clear();
+    }
+}
+
+bool MultipartUploadSink::fail(int errorCode) {
+    errorCode_ = errorCode;
+    discardPart();
+    return false;
+}
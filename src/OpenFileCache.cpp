@@ -0,0 +1,268 @@
+// OpenFileCache.cpp
+#include "OpenFileCache.hpp"
+#include "TimerWheel.hpp"
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+// Fills everything but the fd from a stat() result
+static void fillInfo(const struct stat& fileStat, OpenFileInfo& info) {
+    info.error = 0;
+    info.isRegular = S_ISREG(fileStat.st_mode);
+    info.isDirectory = S_ISDIR(fileStat.st_mode);
+    info.size = fileStat.st_size;
+    info.mtime = fileStat.st_mtime;
+    info.inode = fileStat.st_ino;
+}
+
+static void statPath(const std::string& path, OpenFileInfo& info) {
+    struct stat fileStat;
+    if (stat(path.c_str(), &fileStat) != 0) {
+        int error = errno;
+        int fd = info.fd;
+        info = OpenFileInfo();
+        info.fd = fd;
+        info.error = error;
+        return;
+    }
+    fillInfo(fileStat, info);
+}
+
+OpenFileCache::OpenFileCache(size_t maxEntries, time_t validTime)
+    : maxEntries_(maxEntries), validTime_(validTime), hits_(0), misses_(0)
+{
+}
+
+OpenFileCache::~OpenFileCache() {
+    for (std::map<int, Entry*>::iterator it = fds_.begin(); it != fds_.end(); ++it) {
+        close(it->first);
+        if (it->second->retired) {
+            delete it->second;
+        }
+    }
+    fds_.clear();
+    for (std::map<std::string, Entry*>::iterator it = entries_.begin(); it != entries_.end(); ++it) {
+        delete it->second;
+    }
+    entries_.clear();
+    lru_.clear();
+}
+
+/**
+ * Gives the stat() result of a path, without any fd.
+ *
+ * @return 0, or the errno of the stat() (the same one is given until the entry is revalidated).
+ */
+int OpenFileCache::lookup(const std::string& path, OpenFileInfo& info) {
+    if (maxEntries_ == 0) {
+        info = OpenFileInfo();
+        statPath(path, info);
+        return info.error;
+    }
+    info = getEntry(path)->info;
+    info.fd = -1;
+    return info.error;
+}
+
+/**
+ * Gives the stat() result of a path and, for a regular file, a fd opened read-only (info.fd).
+ * The fd is referenced : it has to be given back with release() (or closed if release() returns false).
+ *
+ * @return 0, or the errno of the stat() or of the open(). A path that is not a regular file gives 0 and no fd.
+ */
+int OpenFileCache::open(const std::string& path, OpenFileInfo& info) {
+    if (maxEntries_ == 0) {
+        info = OpenFileInfo();
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat fileStat;
+        if (fd == -1 || fstat(fd, &fileStat) != 0) {
+            info.error = errno;
+            if (fd != -1) {
+                close(fd);
+            }
+            return info.error;
+        }
+        fillInfo(fileStat, info);
+        if (info.isRegular) {
+            info.fd = fd;
+        } else {
+            close(fd);
+        }
+        return 0;
+    }
+
+    Entry* entry = getEntry(path);
+    info = entry->info;
+    info.fd = -1;
+    if (entry->info.error != 0) {
+        return entry->info.error;
+    }
+    if (!entry->info.isRegular) {
+        return 0;
+    }
+    if (entry->info.fd == -1 && entry->openError == 0) {
+        openEntry(entry);
+    }
+    info = entry->info;
+    info.fd = -1;
+    if (entry->openError != 0) {
+        info.error = entry->openError;
+        return entry->openError;
+    }
+    if (entry->info.fd == -1) {
+        return 0;
+    }
+    ++entry->uses;
+    info = entry->info;
+    return 0;
+}
+
+/**
+ * Gives back a fd obtained from open().
+ *
+ * @return false if the fd does not come from the cache : the caller closes it.
+ */
+bool OpenFileCache::release(int fd) {
+    std::map<int, Entry*>::iterator it = fds_.find(fd);
+    if (it == fds_.end()) {
+        return false;
+    }
+    Entry* entry = it->second;
+    if (entry->uses > 0) {
+        --entry->uses;
+    }
+    if (entry->uses == 0 && entry->retired) {
+        close(fd);
+        fds_.erase(it);
+        delete entry;
+    }
+    return true;
+}
+
+// The file has been changed by the server itself (deleted ...) : the next lookup goes to the filesystem
+void OpenFileCache::invalidate(const std::string& path) {
+    std::map<std::string, Entry*>::iterator it = entries_.find(path);
+    if (it != entries_.end()) {
+        removeEntry(it->second);
+    }
+}
+
+// Drops the entries unused for OPEN_FILE_CACHE_INACTIVE, so the fds of files nobody asks for are not kept open
+void OpenFileCache::expireInactive(time_t currentTime) {
+    while (!lru_.empty() && difftime(currentTime, lru_.back()->lastUsedTime) > OPEN_FILE_CACHE_INACTIVE) {
+        removeEntry(lru_.back());
+    }
+}
+
+// First second at which the least recently used entry expires (an entry created now if the cache is empty)
+time_t OpenFileCache::getNextExpiry(time_t currentTime) const {
+    time_t lastUsedTime = lru_.empty() ? currentTime : lru_.back()->lastUsedTime;
+    return lastUsedTime + OPEN_FILE_CACHE_INACTIVE + 1;
+}
+
+size_t OpenFileCache::getHits() const {
+    return hits_;
+}
+
+size_t OpenFileCache::getMisses() const {
+    return misses_;
+}
+
+/**
+ * Finds the entry of a path, revalidated if it is older than open_file_cache_valid, or creates it
+ * (the least recently used entry is dropped if the cache is full).
+ */
+OpenFileCache::Entry* OpenFileCache::getEntry(const std::string& path) {
+    time_t currentTime = TimerWheel::currentTime();
+    Entry* entry;
+    std::map<std::string, Entry*>::iterator it = entries_.find(path);
+    if (it != entries_.end()) {
+        entry = it->second;
+        if (difftime(currentTime, entry->validatedTime) < validTime_) {
+            ++hits_;
+        } else {
+            ++misses_;
+            OpenFileInfo previous = entry->info;
+            statPath(path, entry->info);
+            if (entry->info.error != 0 || entry->info.inode != previous.inode || entry->info.size != previous.size
+                || entry->info.mtime != previous.mtime) {
+                dropFd(entry);
+            }
+            entry->openError = 0;
+            entry->validatedTime = currentTime;
+        }
+        lru_.splice(lru_.begin(), lru_, entry->lruPosition);
+    } else {
+        ++misses_;
+        if (entries_.size() >= maxEntries_) {
+            removeEntry(lru_.back());
+        }
+        entry = new Entry();
+        entry->path = path;
+        entry->openError = 0;
+        entry->uses = 0;
+        entry->retired = false;
+        entry->validatedTime = currentTime;
+        statPath(path, entry->info);
+        lru_.push_front(entry);
+        entry->lruPosition = lru_.begin();
+        entries_[path] = entry;
+    }
+    entry->lastUsedTime = currentTime;
+    return entry;
+}
+
+// Opens the regular file of an entry, its fstat() replaces the stat() done before (the file may have changed since)
+bool OpenFileCache::openEntry(Entry* entry) {
+    int fd = ::open(entry->path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        entry->openError = errno;
+        return false;
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0) {
+        entry->openError = errno;
+        close(fd);
+        return false;
+    }
+    fillInfo(fileStat, entry->info);
+    if (!entry->info.isRegular) {
+        close(fd);
+        return false;
+    }
+    entry->info.fd = fd;
+    fds_[fd] = entry;
+    return true;
+}
+
+void OpenFileCache::removeEntry(Entry* entry) {
+    dropFd(entry);
+    entries_.erase(entry->path);
+    lru_.erase(entry->lruPosition);
+    delete entry;
+}
+
+// Closes the fd of an entry, or hands it to a retired entry if responses are still streaming it
+void OpenFileCache::dropFd(Entry* entry) {
+    int fd = entry->info.fd;
+    if (fd == -1) {
+        return;
+    }
+    entry->info.fd = -1;
+    if (entry->uses == 0) {
+        close(fd);
+        fds_.erase(fd);
+        return;
+    }
+    Entry* retired = new Entry();
+    retired->path = entry->path;
+    retired->info.fd = fd;
+    retired->openError = 0;
+    retired->uses = entry->uses;
+    retired->retired = true;
+    retired->validatedTime = entry->validatedTime;
+    retired->lastUsedTime = entry->lastUsedTime;
+    fds_[fd] = retired;
+    entry->uses = 0;
+}
@@ -0,0 +1,86 @@
+// PollMultiplexer.cpp
+#include "PollMultiplexer.hpp"
+
+PollMultiplexer::PollMultiplexer() {}
+
+PollMultiplexer::~PollMultiplexer() {}
+
+short PollMultiplexer::toPollEvents(unsigned int events) {
+    short pollEvents = 0;
+    if (events & EVENT_READ)
+        pollEvents |= POLLIN;
+    if (events & EVENT_WRITE)
+        pollEvents |= POLLOUT;
+    return pollEvents;
+}
+
+bool PollMultiplexer::addFd(int fd, unsigned int events) {
+    if (indexByFd_.find(fd) != indexByFd_.end()) {
+        return modifyFd(fd, events);
+    }
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = toPollEvents(events);
+    pfd.revents = 0;
+    indexByFd_[fd] = pollfds_.size();
+    pollfds_.push_back(pfd);
+    return true;
+}
+
+bool PollMultiplexer::modifyFd(int fd, unsigned int events) {
+    std::map<int, size_t>::iterator it = indexByFd_.find(fd);
+    if (it == indexByFd_.end()) {
+        return false;
+    }
+    pollfds_[it->second].events = toPollEvents(events);
+    return true;
+}
+
+/**
+ * Removes a fd from the pollfd array. The last entry is moved in the freed slot so the array stays
+ * compact without shifting every element.
+ */
+void PollMultiplexer::removeFd(int fd) {
+    std::map<int, size_t>::iterator it = indexByFd_.find(fd);
+    if (it == indexByFd_.end()) {
+        return;
+    }
+    size_t index = it->second;
+    size_t last = pollfds_.size() - 1;
+    if (index != last) {
+        pollfds_[index] = pollfds_[last];
+        indexByFd_[pollfds_[index].fd] = index;
+    }
+    pollfds_.pop_back();
+    indexByFd_.erase(fd);
+}
+
+int PollMultiplexer::waitEvents(std::vector<IoEvent>& readyEvents, int timeoutMs) {
+    readyEvents.clear();
+    int ret = poll(pollfds_.empty() ? NULL : &pollfds_[0], pollfds_.size(), timeoutMs);
+    if (ret <= 0) {
+        return ret;
+    }
+    for (size_t i = 0; i < pollfds_.size() && readyEvents.size() < static_cast<size_t>(ret); ++i) {
+        short revents = pollfds_[i].revents;
+        if (revents == 0)
+            continue;
+        IoEvent event;
+        event.fd = pollfds_[i].fd;
+        event.events = 0;
+        if (revents & POLLIN)
+            event.events |= EVENT_READ;
+        if (revents & POLLOUT)
+            event.events |= EVENT_WRITE;
+        if (revents & POLLHUP)
+            event.events |= EVENT_HANGUP;
+        if (revents & (POLLERR | POLLNVAL))
+            event.events |= EVENT_ERROR;
+        readyEvents.push_back(event);
+    }
+    return static_cast<int>(readyEvents.size());
+}
+
+const char* PollMultiplexer::getName() const {
+    return "poll";
+}
@@ -4,20 +4,26 @@
 #include <sys/stat.h>
 #include <dirent.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <limits.h>
+#include <iomanip>
+#include <strings.h>
 #include "../includes/Utils.hpp"
 #include "../includes/Error.hpp"
 #include "../includes/Color_Macros.hpp"
+#include "../includes/MultipartUploadSink.hpp"
 #include "../includes/Utils.hpp"
 #include <cerrno>
 #include <string.h>
 
 
-RequestHandler::RequestHandler(const Config& config, const std::vector<Server*>& associatedServers)
-    : config_(config), associatedServers_(associatedServers)
+RequestHandler::RequestHandler(const Config& config, const VirtualHostTable& virtualHosts, const std::string& remoteAddress,
+                               OpenFileCache* openFileCache, StaticResponseCache* staticResponseCache)
+    : config_(config), virtualHosts_(virtualHosts), remoteAddress_(remoteAddress), openFileCache_(openFileCache),
+      staticResponseCache_(staticResponseCache)
 {
 }
 
@@ -40,6 +46,49 @@ RequestResult RequestHandler::handleRequest(const HttpRequest& request) {
     return result;
 }
 
+/**
+ * Called once the headers of a request are parsed, before its body is received : gives the request the 
+ * client_max_body_size of its location, and streams the body of an upload to the upload_store 
+ * (MultipartUploadSink) instead of keeping it in memory.
+ * 
+ * @param request The request, headers parsed.
+ * @return true if the request is handled by a CGI process or a FastCGI responder : it is processed right away, 
+ *         and its body is streamed to the script while it is received (see DataSocket::processRequest()).
+ */
+bool RequestHandler::prepareRequestBody(HttpRequest& request) const {
+    const Server* server = selectServer(request);
+    if (!server) {
+        request.setMaxBodySize(0);
+        return false;
+    }
+    const Location* location = selectLocation(server, request);
+    request.setMaxBodySize(getClientMaxBodySize(server, location));
+
+    if (isCgiRequest(location, request) || isFastCgiRequest(location, request)) {
+        return true;
+    }
+    if (!isUploadRequest(location, request)) {
+        return false;
+    }
+    std::string boundary = getUploadBoundary(request);
+    struct stat dirStat;
+    // Errors (no boundary, no upload directory) are answered by handleFileUpload()
+    if (!boundary.empty() && stat(location->getUploadStore().c_str(), &dirStat) == 0 && S_ISDIR(dirStat.st_mode)) {
+        request.setBodySink(new MultipartUploadSink(location->getUploadStore(), boundary));
+    }
+    return false;
+}
+
+size_t RequestHandler::getClientMaxBodySize(const Server* server, const Location* location) const {
+    if (location && location->getClientMaxBodySize() > 0) {
+        return location->getClientMaxBodySize();
+    } else if (server->getClientMaxBodySize() > 0) {
+        return server->getClientMaxBodySize();
+    }
+    // Default value
+    return 0; // 0 stands for 'no limit'
+}
+
 const Server* RequestHandler::selectServer(const HttpRequest& request) const {
     std::string hostHeader = request.getHeader("host");
     if (hostHeader.empty()) {
@@ -47,42 +96,17 @@ const Server* RequestHandler::selectServer(const HttpRequest& request) const {
         return NULL; // Error managed after
     }
 
-    // find the good server in associatedServers_
-    for (size_t i = 0; i < associatedServers_.size(); ++i) {
-        const std::vector<std::string>& serverNames = associatedServers_[i]->getServerNames();
-        if (std::find(serverNames.begin(), serverNames.end(), hostHeader) != serverNames.end()) {
-            return associatedServers_[i];
-        }
-    }
-
-    // first server is default
-    if (!associatedServers_.empty()) {
-        return associatedServers_[0];
-    }
-
-    // No server in .conf
-    return NULL;// Error managed after
+    // Server name (exact, then wildcard) of the IP:PORT, else its default server
+    // NULL only without server in .conf : error managed after
+    return virtualHosts_.findServer(hostHeader);
 }
 
 const Location* RequestHandler::selectLocation(const Server* server, const HttpRequest& request) const {
     if (!server) {
         return NULL;
     }
-    std::string requestPath = request.getPath();
-    const std::vector<Location>& locations = server->getLocations();
-
-    const Location* matchedLocation = NULL;
-    size_t longestMatch = 0;
-
-    for (size_t i = 0; i < locations.size(); ++i) {
-        std::string locPath = locations[i].getPath();
-        if (requestPath.find(locPath) == 0 && locPath.length() > longestMatch) {
-            matchedLocation = &locations[i];
-            longestMatch = locPath.length();
-        }
-    }
-
-    return matchedLocation; // NULL is not an error here, because it is possible that there is no specific rules for this location
+    // Exact location, else longest prefix location (LocationTrie compiled with the configuration)
+    return server->findLocation(request.getPath()); // NULL is not an error here, because it is possible that there is no specific rules for this location
 }
 
 /**
@@ -149,8 +173,9 @@ void RequestHandler::process(const Server* server, const Location* location, con
         allowedMethods.push_back("DELETE");
     }
 
-    // Verify if the extracted Method is allowed
-    std::vector<std::string>::iterator it = std::find(allowedMethods.begin(), allowedMethods.end(), request.getMethod());
+    // Verify if the extracted Method is allowed (HEAD is allowed wherever GET is)
+    std::string method = request.getMethod() == "HEAD" ? "GET" : request.getMethod();
+    std::vector<std::string>::iterator it = std::find(allowedMethods.begin(), allowedMethods.end(), method);
     if (it == allowedMethods.end()) {
         result.response = handleError(405, getErrorPageFullPath(405, location, server));
         result.response.setHeader("Allow", join(allowedMethods, ", "));
@@ -173,15 +198,7 @@ void RequestHandler::process(const Server* server, const Location* location, con
         }
 
         // Extract client max body size in the current context (location > Server)
-        size_t clientMaxBodySize = 0;
-        if (location && location->getClientMaxBodySize() > 0) {
-            clientMaxBodySize = location->getClientMaxBodySize();
-        } else if (server->getClientMaxBodySize() > 0) {
-            clientMaxBodySize = server->getClientMaxBodySize();
-        } else {
-            // Default value
-            clientMaxBodySize = 0; // 0 stands for 'no limit'
-        }
+        size_t clientMaxBodySize = getClientMaxBodySize(server, location);
 
         if (clientMaxBodySize > 0 && contentLength > clientMaxBodySize) {
             // std::cout << YELLOW << "client max body size "<<clientMaxBodySize << " vs content length " << contentLength << RESET << std::endl;//test
@@ -201,6 +218,25 @@ void RequestHandler::process(const Server* server, const Location* location, con
         return;
     }
 
+    // Handle FastCGI : the script is run by the responder listening on the fastcgi_pass socket
+    if (isFastCgiRequest(location, request)) {
+        try {
+            std::string fileFullPath = getFileFullPath(server, location, request);
+            verifyFile(fileFullPath, false);
+
+            result.fastCgiPass = location->getFastCgiPass();
+            setupFastCgiParams(request, location, fileFullPath, result.fastCgiParams);
+            result.location = location;
+            result.acceptsGzip = request.acceptsEncoding("gzip");
+            result.responseReady = false;
+            return;
+        } catch (const HttpException& e) {
+            result.response = handleError(e.statusCode, getErrorPageFullPath(e.statusCode, location, server));
+            result.responseReady = true;
+            return;
+        }
+    }
+
     // Handle CGI
     if (location && !location->getCgiExtension().empty() && location->getCGIEnable() && endsWith(request.getPath(), location->getCgiExtension())) {
         try {
@@ -208,8 +244,10 @@ void RequestHandler::process(const Server* server, const Location* location, con
             std::string fileFullPath = getFileFullPath(server, location, request); 
             verifyFile(fileFullPath, true);
 
-            CgiProcess* cgiProcess = startCgiProcess(server, location, request);
+            CgiProcess* cgiProcess = startCgiProcess(location, request);
             result.cgiProcess = cgiProcess;
+            result.location = location;
+            result.acceptsGzip = request.acceptsEncoding("gzip");
             result.responseReady = false;
             return;
         } catch (const HttpException& e) {
@@ -219,8 +257,8 @@ void RequestHandler::process(const Server* server, const Location* location, con
         }
     }
 
-    // Handle static files
-    if (request.getMethod() == "GET") {
+    // Handle static files (HEAD : the same headers, the DataSocket sends no body)
+    if (request.getMethod() == "GET" || request.getMethod() == "HEAD") {
         result.response = serveStaticFile(server, location, request);
         result.responseReady = true;
         return;
@@ -255,12 +293,13 @@ void RequestHandler::process(const Server* server, const Location* location, con
  */
 void RequestHandler::verifyFile(const std::string& fullPath, const bool tryOpen) const {
 
-    // Check file existence and accessibility
-    struct stat fileStat;
-    if (stat(fullPath.c_str(), &fileStat) != 0) {
-        if (errno == EACCES) {
+    // Check file existence and accessibility (cached stat, a missing file is cached too)
+    OpenFileInfo fileInfo;
+    int error = openFileCache_->lookup(fullPath, fileInfo);
+    if (error != 0) {
+        if (error == EACCES) {
             throw HttpException(403, "Forbidden: File access denied");
-        } else if (errno == ENOENT || errno == ENOTDIR) {
+        } else if (error == ENOENT || error == ENOTDIR) {
             throw HttpException(404, "Not Found: File not found or not a directory");
         } else {
             throw HttpException(500, "Internal Server Error: Unable to access file");
@@ -268,22 +307,24 @@ void RequestHandler::verifyFile(const std::string& fullPath, const bool tryOpen)
     }
 
     // Check that it's a regular file
-    if (!S_ISREG(fileStat.st_mode)) {
+    if (!fileInfo.isRegular) {
         throw HttpException(403, "Forbidden: Not a regular file");
     }
 
-    // check that it is possible to open the file
+    // check that it is possible to open the file (the fd stays in the cache for the next requests)
     if(tryOpen == true)
     {
-        std::ifstream file(fullPath.c_str(), std::ios::in | std::ios::binary);
-        if (!file.is_open()) {
-            if (errno == EACCES) {
+        error = openFileCache_->open(fullPath, fileInfo);
+        if (error != 0 || fileInfo.fd == -1) {
+            if (error == EACCES) {
                 throw HttpException(403, "Forbidden: Unable to open file");
             } else {
                 throw HttpException(404, "Not Found: File could not be opened");
             }
         }
-        file.close();
+        if (!openFileCache_->release(fileInfo.fd)) {
+            close(fileInfo.fd);
+        }
     }
 }
 
@@ -294,44 +335,26 @@ void RequestHandler::verifyFile(const std::string& fullPath, const bool tryOpen)
  * the working directory, constructing the argument and environment variable lists, and starting the CGI process.
  * It throws an HttpException if any step in the process fails.
  */
-CgiProcess* RequestHandler::startCgiProcess(const Server* server, const Location* location, const HttpRequest& request) const {
-    char cwd[PATH_MAX];
-
-    if (getcwd(cwd, sizeof(cwd)) == NULL) {
-        throw HttpException(500, "Internal Server Error: Unable to get current working directory");
-    }
-
-    // build scriptWorkingDir path (directory where the script is gonna be exec) = often /cgi-bin/
-    std::string scriptWorkingDir = cwd;
-    scriptWorkingDir += "/" ;
-    scriptWorkingDir += server->getRoot();
-    if (location) {
-        scriptWorkingDir += "/";
-        scriptWorkingDir += location->getPath();
-        scriptWorkingDir += "/";
-    }
+CgiProcess* RequestHandler::startCgiProcess(const Location* location, const HttpRequest& request) const {
+    // Directory where the script is gonna be exec (often /cgi-bin/), computed at config load
+    const std::string& scriptWorkingDir = location->getCgiWorkingDir();
 
     // build relativeFilePath path (file that is gonna be exec)
     std::string relativeFilePath = request.getPath();
-    if (location && relativeFilePath.compare(0, location->getPath().length(), location->getPath()) == 0) {
+    if (relativeFilePath.compare(0, location->getPath().length(), location->getPath()) == 0) {
         relativeFilePath.erase(0, location->getPath().length());
     }
     relativeFilePath = "./" + relativeFilePath;
 
     // Extract parameters to give to the script (different methods for GET and POST)
     std::map<std::string, std::string> params;
-    if (request.getMethod() == "GET") {
-        // Params are in the query string for GET
+    if (request.getMethod() == "GET" || request.getMethod() == "HEAD") {
+        // Params are in the query string for GET (HEAD : REQUEST_METHOD=HEAD, the output body is dropped)
         params = createScriptParamsGET(request.getQueryString());
     } else if (request.getMethod() == "POST") {
         std::string contentType = request.getHeader("content-type");
-        if (contentType == "application/x-www-form-urlencoded") {
-            // Params are in the body for POST
-            params = createScriptParamsPOST(request.getBody());
-        } 
-        else if (contentType == "plain/text")
-        {
-            //do nothing, body will be transmitted via envVars
+        if (contentType == "application/x-www-form-urlencoded" || contentType == "plain/text") {
+            // The body is written to the script stdin by the event loop (CONTENT_LENGTH bytes)
         }
         else {
             // Content is not supported
@@ -342,10 +365,11 @@ CgiProcess* RequestHandler::startCgiProcess(const Server* server, const Location
         throw HttpException(405, "Method Not Allowed: " + request.getMethod());
     }
 
+    // Only the variables of the request : the others are the same for every request of the location
     std::vector<std::string> envVars;
     setupScriptEnvp(request, relativeFilePath, envVars);
 
-    CgiProcess* cgiProcess = new CgiProcess(scriptWorkingDir, relativeFilePath, params, envVars);
+    CgiProcess* cgiProcess = new CgiProcess(scriptWorkingDir, relativeFilePath, params, location->getCgiEnvironment(), envVars);
     if (!cgiProcess->start()) {
         delete cgiProcess;
         throw HttpException(500, "Internal Server Error: Failed to start CGI process");
@@ -354,20 +378,48 @@ CgiProcess* RequestHandler::startCgiProcess(const Server* server, const Location
 }
 
 /**
- * @brief Sets up environment variables for the CGI script.
+ * @brief Sets up the environment variables of the request for the CGI script.
  * 
- * This function populates the environment variable list (`envVars`) required to run a CGI script.
- * It adds variables such as `REQUEST_METHOD`, `CONTENT_TYPE`, `CONTENT_LENGTH`, and the script's filename.
+ * This function populates the environment variable list (`envVars`) with the variables that depend on the request,
+ * such as `REQUEST_METHOD`, `CONTENT_TYPE`, `CONTENT_LENGTH`, and the script's filename. The other ones
+ * (`GATEWAY_INTERFACE`, ...) are computed once per location (see Location::compileCgiEnvironment()).
  */
 void RequestHandler::setupScriptEnvp(const HttpRequest& request, const std::string& relativeFilePath,  std::vector<std::string>& envVars) const{
-    envVars.push_back("GATEWAY_INTERFACE=CGI/1.1");
-    envVars.push_back("SERVER_PROTOCOL=HTTP/1.1");
     envVars.push_back("REQUEST_METHOD=" + request.getMethod());
     envVars.push_back("SCRIPT_FILENAME=" + relativeFilePath);
     envVars.push_back("CONTENT_TYPE=" + request.getHeader("content-Type"));
-    envVars.push_back("CONTENT_LENGTH=" + request.getHeader("content-Length"));
-    envVars.push_back("REQUEST_BODY=" + request.getBody());
+    // A chunked body is streamed to the script while it is received : its length is unknown, the script reads 
+    // its stdin until EOF (end of the STDIN stream with FastCGI)
+    if (!request.isChunked()) {
+        envVars.push_back("CONTENT_LENGTH=" + request.getHeader("content-Length"));
+    }
     envVars.push_back("QUERY_STRING=" + request.getQueryString());
+    envVars.push_back("REMOTE_ADDR=" + remoteAddress_);
+}
+
+/**
+ * @brief Sets up the FastCGI params of a request.
+ * 
+ * Same variables as the environment of a CGI process, plus the ones a long-lived responder needs to find the
+ * script by itself (absolute `SCRIPT_FILENAME`, `SCRIPT_NAME`, `REQUEST_URI`).
+ */
+void RequestHandler::setupFastCgiParams(const HttpRequest& request, const Location* location, const std::string& fileFullPath, std::vector<std::string>& params) const {
+    std::string scriptFilename = fileFullPath;
+    if (scriptFilename.empty() || scriptFilename[0] != '/') {
+        char cwd[PATH_MAX];
+        if (getcwd(cwd, sizeof(cwd)) == NULL) {
+            throw HttpException(500, "Internal Server Error: Unable to get current working directory");
+        }
+        scriptFilename = std::string(cwd) + "/" + scriptFilename;
+    }
+    params = location->getCgiEnvironment();
+    setupScriptEnvp(request, scriptFilename, params);
+    params.push_back("SCRIPT_NAME=" + request.getPath());
+    std::string requestUri = request.getPath();
+    if (!request.getQueryString().empty()) {
+        requestUri += "?" + request.getQueryString();
+    }
+    params.push_back("REQUEST_URI=" + requestUri);
 }
 
 /**
@@ -411,46 +463,6 @@ std::map<std::string, std::string> RequestHandler::createScriptParamsGET(const s
     return params;
 }
 
-/**
- * @brief Creates a map of parameters from the body of a POST request.
- * 
- * This function parses the body of a POST request, extracting key-value pairs and storing them in a map.
- * It assumes the body is formatted as `key=value&key=value`.
- */
-std::map<std::string, std::string> RequestHandler::createScriptParamsPOST(const std::string& postBody) const {
-    std::map<std::string, std::string> params;
-    std::string::size_type last_pos = 0, amp_pos;
-
-    while ((amp_pos = postBody.find('&', last_pos)) != std::string::npos) {
-        std::string key_value_pair = postBody.substr(last_pos, amp_pos - last_pos);
-        std::string::size_type eq_pos = key_value_pair.find('=');
-        if (eq_pos != std::string::npos) {
-            std::string key = key_value_pair.substr(0, eq_pos);
-            std::string value = key_value_pair.substr(eq_pos + 1);
-            params[key] = value;
-        } else if (!key_value_pair.empty()) {
-            params[key_value_pair] = "";
-        }
-        last_pos = amp_pos + 1;
-    }
-
-    // Treat last parameter
-    std::string key_value_pair = postBody.substr(last_pos);
-    if (!key_value_pair.empty()) {
-        std::string::size_type eq_pos = key_value_pair.find('=');
-        if (eq_pos != std::string::npos) {
-            std::string key = key_value_pair.substr(0, eq_pos);
-            std::string value = key_value_pair.substr(eq_pos + 1);
-            params[key] = value;
-        } else {
-            params[key_value_pair] = "";
-        }
-    }
-
-    return params;
-}
-
-
 /**
  * @brief Returns the full path to the requested file.
  * 
@@ -487,7 +499,15 @@ std::string RequestHandler::getFileFullPath(const Server* server, const Location
 /**
  * @brief Serves a static file to the client.
  * 
- * This function attempts to serve a static file to the client by reading the file and sending its content in the response.
+ * This function attempts to serve a static file to the client : the file is opened and its fd is given to the response, 
+ * the content is never loaded in memory (the DataSocket streams it with sendfile).
+ * In a `static_cache` location, a small file is read once and its whole response is kept pre-serialized : the next
+ * requests get the shared buffer without touching the filesystem.
+ * With gzip_static / brotli_static, a precompressed sibling of the file is served instead when the client accepts it.
+ * With gzip, the file is compressed on the fly by the DataSocket (those responses are not kept by the static cache).
+ * The response carries an ETag and a Last-Modified date : a conditional request (If-None-Match, If-Modified-Since)
+ * for the same version of the file gets a 304 without body. A Range request gets a 206 with the slices asked.
+ * A HEAD request gets the same headers, built from the cached stat alone : the file is never opened.
  * It handles the cases where the path is a directory, and it can generate an auto-index if enabled. If any error occurs,
  * it responds with an appropriate error code.
  */
@@ -499,7 +519,9 @@ HttpResponse RequestHandler::serveStaticFile(const Server* server, const Locatio
     if (fileFullPath[fileFullPath.size() - 1] == '/') {
         // if index is not defined and auto-index is enabled = Generate auto-index 
         if (location && !location->getIndexIsSet() && location->getAutoIndex()) {
-            return generateAutoIndex(fileFullPath, request.getPath());
+            response = generateAutoIndex(fileFullPath, request.getPath());
+            prepareGzip(location, request.acceptsEncoding("gzip"), response, static_cast<long>(response.getBody().size()));
+            return response;
         } 
         // if index is defined = Serve Index file 
         else if(location && location->getIndexIsSet()){
@@ -516,38 +538,374 @@ HttpResponse RequestHandler::serveStaticFile(const Server* server, const Locatio
         return handleError(e.statusCode, getErrorPageFullPath(e.statusCode, location, server)); // Forbidde
     }
 
-    // Open the file 
-    std::ifstream file(fileFullPath.c_str(), std::ios::in | std::ios::binary);
-    if (!file.is_open()) {
-        if (errno == EACCES) {
+    // File actually sent : the file itself, or its precompressed sibling
+    OpenFileInfo fileInfo;
+    openFileCache_->lookup(fileFullPath, fileInfo);
+    std::string contentEncoding;
+    std::string servedPath = selectPrecompressedFile(location, request, fileFullPath, fileInfo, contentEncoding);
+
+    // Define response headers
+    response.setStatusCode(200);
+    setContentType(response, fileFullPath);
+    if (location && (location->getGzipStatic() || location->getBrotliStatic())) {
+        // The response depends on the Accept-Encoding of the request (shared caches)
+        response.setHeader("Vary", "Accept-Encoding");
+    }
+    if (!contentEncoding.empty()) {
+        response.setHeader("Content-Encoding", contentEncoding);
+    }
+
+    // Validators of the version of the file sent, from the cached stat : an unchanged file is not opened
+    std::string etag = makeETag(fileInfo);
+    response.setHeader("ETag", etag);
+    response.setHeader("Last-Modified", formatHttpDate(fileInfo.mtime));
+    if (isNotModified(request, fileInfo, etag)) {
+        response.setStatusCode(304);
+        response.removeHeader("Content-Type");
+        response.removeHeader("Content-Encoding");
+        return response;
+    }
+
+    prepareGzip(location, request.acceptsEncoding("gzip"), response, static_cast<long>(fileInfo.size));
+
+    // Byte ranges : slices of the file as it is stored (not with an encoding made on the fly)
+    std::vector<ByteRange> ranges;
+    int rangeStatus = 200;
+    if (response.getGzipLevel() == 0) {
+        response.setHeader("Accept-Ranges", "bytes");
+        rangeStatus = evaluateRange(request, fileInfo, etag, ranges);
+    }
+    if (rangeStatus == 416) {
+        HttpResponse error = handleError(416, getErrorPageFullPath(416, location, server));
+        error.setHeader("Content-Range", "bytes */" + toString(static_cast<long>(fileInfo.size)));
+        return error;
+    }
+
+    // Compressed on the fly or partial : the body sent depends on the request, it is not kept by the static cache
+    bool headRequest = request.getMethod() == "HEAD";
+    bool staticCacheable = !headRequest && response.getGzipLevel() == 0 && rangeStatus == 200
+                           && isStaticCacheable(location, fileInfo);
+
+    // Response already serialized for this version of the file
+    if (staticCacheable) {
+        size_t headerLength;
+        SharedBuffer* cachedResponse = staticResponseCache_->find(servedPath, fileInfo, headerLength);
+        if (cachedResponse) {
+            response.setSharedResponse(cachedResponse, headerLength);
+            return response;
+        }
+    }
+
+    // Open the file : its content is not read here, the DataSocket streams it to the client (sendfile)
+    // The fd comes from the open file cache : the DataSocket gives it back once the body is sent
+    // HEAD : the file is not opened, the lengths come from the cached stat (fd -1)
+    fileInfo.fd = -1;
+    if (!headRequest) {
+        int error = openFileCache_->open(servedPath, fileInfo);
+        if (error != 0) {
+            if (error == EACCES) {
+                return handleError(403, getErrorPageFullPath(403, location, server)); // Forbidden
+            } else {
+                return handleError(404, getErrorPageFullPath(404, location, server)); // Not Found
+            }
+        }
+        if (fileInfo.fd == -1) {
             return handleError(403, getErrorPageFullPath(403, location, server)); // Forbidden
+        }
+    }
+
+    if (rangeStatus == 206) {
+        setRangeBody(response, fileInfo, ranges);
+        return response;
+    }
+    response.setBodyFile(fileInfo.fd, 0, static_cast<size_t>(fileInfo.size));
+    if (staticCacheable) {
+        cacheStaticResponse(servedPath, fileInfo, response);
+    }
+
+    return response;
+}
+
+// Small regular file of a 'static_cache on' location
+bool RequestHandler::isStaticCacheable(const Location* location, const OpenFileInfo& fileInfo) const {
+    return location && location->getStaticCache() && fileInfo.isRegular
+           && static_cast<size_t>(fileInfo.size) <= location->getStaticCacheMaxSize();
+}
+
+/**
+ * Reads the file of a response and serializes the whole response (without its Connection header) in a buffer 
+ * kept by the static cache. The response uses that buffer instead of the fd, that is given back to the open file cache.
+ * If the file can't be read entirely, the response keeps streaming it from the fd.
+ */
+void RequestHandler::cacheStaticResponse(const std::string& fileFullPath, const OpenFileInfo& fileInfo, HttpResponse& response) const {
+    std::string body;
+    if (!readFileContent(fileInfo.fd, static_cast<size_t>(fileInfo.size), body)) {
+        return;
+    }
+    if (!openFileCache_->release(fileInfo.fd)) {
+        close(fileInfo.fd);
+    }
+    response.setBody(body);
+
+    std::string serialized = response.generateHeaders();
+    // Without the empty line : the Connection header of each socket goes there
+    serialized.erase(serialized.size() - 2);
+    size_t headerLength = serialized.size();
+    serialized.append(body);
+
+    SharedBuffer* buffer = new SharedBuffer(serialized);
+    staticResponseCache_->insert(fileFullPath, fileInfo, buffer, headerLength);
+    response.setSharedResponse(buffer, headerLength);
+    buffer->release();
+}
+
+/**
+ * gzip_static / brotli_static : finds the precompressed sibling of a file (`file.css.br`, then `file.css.gz`) 
+ * to serve if the client accepts its encoding. The lookups go through the open file cache, a missing sibling 
+ * is a cached negative entry.
+ * 
+ * @param fileInfo        Info of the file, replaced by the info of the sibling if one is used.
+ * @param contentEncoding Set to the encoding of the sibling used.
+ * @return The path of the file to send.
+ */
+std::string RequestHandler::selectPrecompressedFile(const Location* location, const HttpRequest& request, const std::string& fileFullPath,
+                                                    OpenFileInfo& fileInfo, std::string& contentEncoding) const {
+    if (!location) {
+        return fileFullPath;
+    }
+    if (location->getBrotliStatic() && request.acceptsEncoding("br") && usePrecompressedFile(fileFullPath + ".br", fileInfo)) {
+        contentEncoding = "br";
+        return fileFullPath + ".br";
+    }
+    if (location->getGzipStatic() && request.acceptsEncoding("gzip") && usePrecompressedFile(fileFullPath + ".gz", fileInfo)) {
+        contentEncoding = "gzip";
+        return fileFullPath + ".gz";
+    }
+    return fileFullPath;
+}
+
+// A sibling older than the file is outdated (the file has been modified since it was compressed)
+bool RequestHandler::usePrecompressedFile(const std::string& precompressedPath, OpenFileInfo& fileInfo) const {
+    OpenFileInfo precompressedInfo;
+    if (openFileCache_->lookup(precompressedPath, precompressedInfo) != 0 || !precompressedInfo.isRegular
+        || precompressedInfo.mtime < fileInfo.mtime) {
+        return false;
+    }
+    fileInfo = precompressedInfo;
+    return true;
+}
+
+/**
+ * gzip : marks a response of a `gzip on` location to be compressed on the fly by the DataSocket, if its 
+ * Content-Type is in gzip_types and it is not encoded already. Vary is set whether the client accepts gzip or not.
+ *
+ * @param acceptsGzip true if the Accept-Encoding of the request accepts gzip.
+ * @param bodyLength  Length of the body, -1 if it is unknown (CGI output).
+ */
+void RequestHandler::prepareGzip(const Location* location, bool acceptsGzip, HttpResponse& response, long bodyLength) {
+    int status = response.getStatusCode();
+    if (!location || !location->getGzip() || status < 200 || status == 204 || status == 304) {
+        return;
+    }
+    if (!response.getHeader("Content-Encoding").empty() || !location->isGzipType(response.getHeader("Content-Type"))) {
+        return;
+    }
+    response.setHeader("Vary", "Accept-Encoding");
+    if (acceptsGzip && (bodyLength < 0 || static_cast<size_t>(bodyLength) >= location->getGzipMinLength())) {
+        response.setGzipLevel(location->getGzipCompLevel());
+    }
+}
+
+// Weak ETag of a version of a file : W/"inode-size-mtime" (hexadecimal), a precompressed sibling has its own
+std::string RequestHandler::makeETag(const OpenFileInfo& fileInfo) const {
+    std::ostringstream etag;
+    etag << std::hex << "W/\"" << fileInfo.inode << "-" << fileInfo.size << "-" << fileInfo.mtime << "\"";
+    return etag.str();
+}
+
+/**
+ * Evaluates the conditional headers of a GET (RFC 9110 13.2.2) : If-None-Match (weak comparison, '*' matches
+ * any version), or If-Modified-Since when the request has no If-None-Match.
+ *
+ * @return true if the version of the client is still the current one (304).
+ */
+bool RequestHandler::isNotModified(const HttpRequest& request, const OpenFileInfo& fileInfo, const std::string& etag) const {
+    std::string ifNoneMatch = request.getHeader("if-none-match");
+    if (!ifNoneMatch.empty()) {
+        std::string opaqueTag = etag.substr(2);
+        std::istringstream tags(ifNoneMatch);
+        std::string tag;
+        while (std::getline(tags, tag, ',')) {
+            size_t first = tag.find_first_not_of(" \t");
+            if (first == std::string::npos) {
+                continue;
+            }
+            tag = tag.substr(first, tag.find_last_not_of(" \t") - first + 1);
+            if (tag.compare(0, 2, "W/") == 0) {
+                tag.erase(0, 2);
+            }
+            if (tag == "*" || tag == opaqueTag) {
+                return true;
+            }
+        }
+        return false;
+    }
+    std::string ifModifiedSince = request.getHeader("if-modified-since");
+    time_t since;
+    if (!ifModifiedSince.empty() && parseHttpDate(ifModifiedSince, since)) {
+        return fileInfo.mtime <= since;
+    }
+    return false;
+}
+
+/**
+ * Evaluates the Range header of a request (RFC 9110 14.2), and its If-Range condition : the ranges are only
+ * used for the version of the file the client already has part of. Strong comparison is required, so our weak
+ * ETags never match : If-Range works with the exact Last-Modified date.
+ * An invalid header (other unit, syntax, too many ranges) is ignored, like the standard allows.
+ *
+ * @param ranges The satisfiable ranges, sorted and merged when they overlap.
+ * @return 200 to send the whole file, 206 to send `ranges`, 416 if no range can be satisfied.
+ */
+int RequestHandler::evaluateRange(const HttpRequest& request, const OpenFileInfo& fileInfo, const std::string& etag,
+                                  std::vector<ByteRange>& ranges) const {
+    std::string range = request.getHeader("range");
+    if (range.empty() || !fileInfo.isRegular) {
+        return 200;
+    }
+    std::string ifRange = request.getHeader("if-range");
+    if (!ifRange.empty()) {
+        time_t date;
+        if (ifRange[0] == '"' || ifRange.compare(0, 2, "W/") == 0) {
+            if (etag.compare(0, 2, "W/") == 0 || ifRange != etag) {
+                return 200;
+            }
+        } else if (!parseHttpDate(ifRange, date) || date != fileInfo.mtime) {
+            return 200;
+        }
+    }
+    if (range.size() < 6 || strncasecmp(range.c_str(), "bytes=", 6) != 0) {
+        return 200;
+    }
+
+    std::istringstream specs(range.substr(6));
+    std::string spec;
+    size_t count = 0;
+    while (std::getline(specs, spec, ',')) {
+        if (++count > MAX_BYTE_RANGES || !parseByteRange(spec, fileInfo.size, ranges)) {
+            ranges.clear();
+            return 200;
+        }
+    }
+    if (ranges.empty()) {
+        return 416;
+    }
+
+    // Overlapping ranges are merged (a request for the same bytes many times is not amplified)
+    std::sort(ranges.begin(), ranges.end());
+    size_t merged = 0;
+    for (size_t i = 1; i < ranges.size(); ++i) {
+        if (ranges[i].first <= ranges[merged].second + 1) {
+            ranges[merged].second = std::max(ranges[merged].second, ranges[i].second);
         } else {
-            return handleError(404, getErrorPageFullPath(404, location, server)); // Not Found
+            ranges[++merged] = ranges[i];
         }
     }
+    ranges.resize(merged + 1);
+    return 206;
+}
 
-    // Read fle content
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    std::string fileContent = buffer.str();
-    file.close();
+/**
+ * Parses one range of a Range header : "first-last", "first-" or "-suffixLength". A range that starts after
+ * the end of the file is valid but unsatisfiable, it is skipped.
+ *
+ * @return false if the range is invalid.
+ */
+bool RequestHandler::parseByteRange(const std::string& spec, off_t size, std::vector<ByteRange>& ranges) const {
+    size_t first = spec.find_first_not_of(" \t");
+    if (first == std::string::npos) {
+        return false;
+    }
+    std::string value = spec.substr(first, spec.find_last_not_of(" \t") - first + 1);
+    size_t dash = value.find('-');
+    if (dash == std::string::npos) {
+        return false;
+    }
+    std::string startPart = value.substr(0, dash);
+    std::string endPart = value.substr(dash + 1);
+    if ((startPart.empty() && endPart.empty()) || startPart.size() > 18 || endPart.size() > 18
+        || startPart.find_first_not_of("0123456789") != std::string::npos
+        || endPart.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
 
-    // Define response headers and body
-    response.setStatusCode(200);
-    response.setBody(fileContent);
+    off_t start;
+    off_t end = size - 1;
+    if (startPart.empty()) {
+        // Last bytes of the file
+        off_t suffixLength = strtoll(endPart.c_str(), NULL, 10);
+        if (suffixLength == 0 || size == 0) {
+            return true;
+        }
+        start = suffixLength < size ? size - suffixLength : 0;
+    } else {
+        start = strtoll(startPart.c_str(), NULL, 10);
+        if (!endPart.empty()) {
+            off_t last = strtoll(endPart.c_str(), NULL, 10);
+            if (last < start) {
+                return false;
+            }
+            end = std::min(last, size - 1);
+        }
+        if (start >= size) {
+            return true;
+        }
+    }
+    ranges.push_back(ByteRange(start, end));
+    return true;
+}
 
-    // Define Content-Type according to file extension
+/**
+ * Sets the 206 body : one range is a slice of the file fd, several ranges are a multipart/byteranges body whose 
+ * parts are slices of the same fd. Nothing is read here, the DataSocket streams the slices (sendfile).
+ */
+void RequestHandler::setRangeBody(HttpResponse& response, const OpenFileInfo& fileInfo, std::vector<ByteRange>& ranges) const {
+    response.setStatusCode(206);
+    std::string total = toString(static_cast<long>(fileInfo.size));
+    if (ranges.size() == 1) {
+        response.setHeader("Content-Range", "bytes " + toString(static_cast<long>(ranges[0].first)) + "-"
+                           + toString(static_cast<long>(ranges[0].second)) + "/" + total);
+        response.setBodyFile(fileInfo.fd, ranges[0].first, static_cast<size_t>(ranges[0].second - ranges[0].first + 1));
+        return;
+    }
+
+    static unsigned long boundaryCounter = 0;
+    std::ostringstream boundary;
+    boundary << std::hex << std::setfill('0') << std::setw(8) << static_cast<unsigned long>(time(NULL))
+             << std::setw(8) << ++boundaryCounter << std::setw(8) << static_cast<unsigned long>(getpid());
+    std::string contentType = response.getHeader("Content-Type");
+    std::vector<BodyFilePart> parts;
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        std::string header = "\r\n--" + boundary.str() + "\r\nContent-Type: " + contentType
+                             + "\r\nContent-Range: bytes " + toString(static_cast<long>(ranges[i].first)) + "-"
+                             + toString(static_cast<long>(ranges[i].second)) + "/" + total + "\r\n\r\n";
+        parts.push_back(BodyFilePart(header, ranges[i].first, static_cast<size_t>(ranges[i].second - ranges[i].first + 1)));
+    }
+    parts.push_back(BodyFilePart("\r\n--" + boundary.str() + "--\r\n", 0, 0));
+    response.setHeader("Content-Type", "multipart/byteranges; boundary=" + boundary.str());
+    response.setBodyFileParts(fileInfo.fd, parts);
+}
+
+// Content-Type according to the file extension
+void RequestHandler::setContentType(HttpResponse& response, const std::string& fileFullPath) const {
     size_t dotPos = fileFullPath.find_last_of('.');
     if (dotPos != std::string::npos) {
         std::string extension = fileFullPath.substr(dotPos + 1);
         std::string contentType = getMimeType(extension);
         if (!contentType.empty()) {
             response.setHeader("Content-Type", contentType);
-            response.setHeader("Connection", "close");
         }
     }
-
-    return response;
 }
 
 
@@ -555,41 +913,26 @@ HttpResponse RequestHandler::serveStaticFile(const Server* server, const Locatio
 /*
  * This function handles file uploads from HTTP requests with the "multipart/form-data" content type.
  * 
+ * The body itself is not parsed here : prepareRequestBody() attached a MultipartUploadSink to the request, which 
+ * wrote each file part to the upload directory while the body was received (errors in the body are answered 
+ * as parse errors by the DataSocket).
+ * 
  * Steps:
- * 1. It first checks if the Content-Type of the request is "multipart/form-data".
- * 2. It extracts the boundary parameter from the Content-Type header, which is used to separate different parts of the request body.
- * 3. It reads the body of the request and checks if the upload directory exists.
- * 4. The body of the request is then parsed to separate each part. Each part contains headers and the actual file data.
- * 5. For each part, it looks for the "filename" field in the headers to identify if it's a file part.
- * 6. If a file is found, it saves the file to the specified upload directory.
- * 7. If any errors occur (such as missing Content-Type, boundary, or upload directory issues), an error response is returned.
- * 8. On successful upload, a 201 status code is returned along with a success message.
+ * 1. It first checks if the Content-Type of the request is "multipart/form-data" with a boundary parameter.
+ * 2. It checks if the upload directory exists.
+ * 3. If any errors occur (such as missing Content-Type, boundary, or upload directory issues), an error response is returned.
+ * 4. On successful upload, a 201 status code is returned along with a success message.
  */
 HttpResponse RequestHandler::handleFileUpload(const HttpRequest& request, const Location* location, const Server* server) const {
     // std::cout << RED << "RequestHandler::handleFileUpload" << RESET << std::endl; //Debug 
     HttpResponse response;
 
-    // Check that the Content-Type is multipart/form-data
-    std::string contentType = request.getHeader("content-type");
-    if (contentType.find("multipart/form-data") != 0 ) {
+    // Check that the Content-Type is multipart/form-data, with a boundary
+    if (getUploadBoundary(request).empty()) {
         response = handleError(400, getErrorPageFullPath(400, location, server));
         return response;
     }
 
-    // Extract boundary from Content-Type header
-    std::string boundaryPrefix = "boundary=";
-    std::string::size_type boundaryPos = contentType.find(boundaryPrefix);
-    if (boundaryPos == std::string::npos) {
-        // No boundary found
-        response = handleError(400, getErrorPageFullPath(400, location, server));
-        return response;
-    }
-    boundaryPos += boundaryPrefix.length();
-    std::string boundary = "--" + contentType.substr(boundaryPos);
-
-    // Read the body of the request
-    std::string body = request.getBody();
-
     // Check that the upload directory exists
     std::string uploadDirectory = location->getUploadStore();
     struct stat dirStat;
@@ -599,55 +942,77 @@ HttpResponse RequestHandler::handleFileUpload(const HttpRequest& request, const
         return response;
     }
 
-    // Separate the different parts
-    std::string::size_type start = 0;
-    while ((start = body.find(boundary, start)) != std::string::npos) {
-        start += boundary.length();
-        //end = next boundary found (if not found, there is no more content to read)
-        std::string::size_type end = body.find(boundary, start);
-        if (end == std::string::npos) break;
-
-        std::string part = body.substr(start, end - start);
-
-        // Extract part headers (each part separated by a boudary have headers)
-        std::string::size_type headerEnd = part.find("\r\n\r\n");
-        if (headerEnd == std::string::npos) continue;
-
-        std::string headers = part.substr(0, headerEnd);
-        std::string fileData = part.substr(headerEnd + 4);
-
-        // Check if this part is a file
-        std::string filenamePrefix = "filename=\"";
-        std::string::size_type filenamePos = headers.find(filenamePrefix);
-        if (filenamePos != std::string::npos) {
-            std::string::size_type filenameEndPos = headers.find("\"", filenamePos + filenamePrefix.length());
-            if (filenameEndPos != std::string::npos) {
-                std::string filename = headers.substr(filenamePos + filenamePrefix.length(), filenameEndPos - (filenamePos + filenamePrefix.length()));
-
-                // Build the complete path to save the file
-                std::string fullPath = uploadDirectory + "/" + filename;
-
-                // Save the file
-                std::ofstream file(fullPath.c_str(), std::ios::binary);
-                if (file.is_open()) {
-                    file.write(fileData.c_str(), fileData.size());
-                    file.close();
-                    // std::cout << "Info : File saved: " << fullPath << std::endl;//debug
-                } else {
-                    std::cerr << "Error : Failed to save file: " << fullPath << std::endl;
-                    response = handleError(500, getErrorPageFullPath(500, location, server));
-                    return response;
-                }
-            }
-        }
+    // The parts have already been saved by the MultipartUploadSink while the body was received
+    // (no sink : empty body)
+    if (request.getBodySink() == NULL) {
+        response = handleError(400, getErrorPageFullPath(400, location, server));
+        return response;
     }
 
     response.setStatusCode(201);
-    response.setHeader("Connection", "close");
     response.setBody("File upload successful.\n");
     return response;
 }
 
+/**
+ * Tells if a request will be handled by handleFileUpload() (same checks as process()).
+ */
+bool RequestHandler::isUploadRequest(const Location* location, const HttpRequest& request) const {
+    if (request.getMethod() != "POST" || !location || !location->getUploadEnable() || !location->getRedirection().empty()) {
+        return false;
+    }
+    if (isCgiRequest(location, request) || isFastCgiRequest(location, request)) {
+        return false;
+    }
+    const std::vector<std::string>& allowedMethods = location->getAllowedMethods();
+    return allowedMethods.empty() || std::find(allowedMethods.begin(), allowedMethods.end(), "POST") != allowedMethods.end();
+}
+
+/**
+ * Tells if a request is handled by the FastCGI responder of its location : every request of a `fastcgi_pass`
+ * location, or only the scripts with the `cgi_pass` extension when one is set.
+ */
+bool RequestHandler::isFastCgiRequest(const Location* location, const HttpRequest& request) const {
+    if (!location || location->getFastCgiPass().empty() || !location->getRedirection().empty()) {
+        return false;
+    }
+    return location->getCgiExtension().empty() || endsWith(request.getPath(), location->getCgiExtension());
+}
+
+/**
+ * Tells if a request is handled by a CGI process (same checks as process() : FastCGI is tried first).
+ */
+bool RequestHandler::isCgiRequest(const Location* location, const HttpRequest& request) const {
+    if (!location || !location->getRedirection().empty() || isFastCgiRequest(location, request)) {
+        return false;
+    }
+    return !location->getCgiExtension().empty() && location->getCGIEnable() && endsWith(request.getPath(), location->getCgiExtension());
+}
+
+/**
+ * Extracts the boundary of a multipart/form-data request (Content-Type: multipart/form-data; boundary=xyz).
+ * 
+ * @return The boundary, empty if the request is not multipart/form-data or has no boundary.
+ */
+std::string RequestHandler::getUploadBoundary(const HttpRequest& request) const {
+    std::string contentType = request.getHeader("content-type");
+    if (contentType.find("multipart/form-data") != 0 ) {
+        return "";
+    }
+    std::string boundaryPrefix = "boundary=";
+    std::string::size_type boundaryPos = contentType.find(boundaryPrefix);
+    if (boundaryPos == std::string::npos) {
+        return "";
+    }
+    boundaryPos += boundaryPrefix.length();
+    std::string boundary = contentType.substr(boundaryPos, contentType.find(';', boundaryPos) - boundaryPos);
+    // The boundary may be quoted
+    if (boundary.size() >= 2 && boundary[0] == '"' && boundary[boundary.size() - 1] == '"') {
+        boundary = boundary.substr(1, boundary.size() - 2);
+    }
+    return boundary;
+}
+
 
 /**
  * @brief Handles file deletion requests.
@@ -729,12 +1094,12 @@ HttpResponse RequestHandler::handleDeletion(const HttpRequest& request, const Lo
         response = handleError(500, getErrorPageFullPath(500, location, server)); // Internal Server Error
         return response;
     }
+    openFileCache_->invalidate(fullPath);
 
     // std::cout << "Info: file deleted: " << fullPath << std::endl; // Debug
     // build success response
     response.setStatusCode(204);
     response.setHeader("Content-Type", "text/plain; charset=UTF-8");
-    response.setHeader("Connection", "close");
 
     return response;
 }
@@ -776,7 +1141,6 @@ HttpResponse RequestHandler::generateAutoIndex(const std::string& fullPath, cons
     response.setStatusCode(200);
     response.setBody(ss.str());
     response.setHeader("Content-Type", "text/html; charset=UTF-8");
-    response.setHeader("Connection", "close");
 
     return response; 
 }
@@ -833,6 +1197,11 @@ bool RequestHandler::isPathSecure(const std::string& root, const std::string& fu
     return true;
 }
 
+// Error response preloaded with the configuration (no filesystem I/O)
+HttpResponse RequestHandler::handleError(int statusCode, const std::string& errorPagePath) const {
+    return ::handleError(statusCode, errorPagePath, &config_.getErrorPageCache());
+}
+
 
 /**
  * @brief Retrieves the full file path for the error page based on the status code.
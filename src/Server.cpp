@@ -3,10 +3,13 @@
 #include "../includes/Location.hpp"
 #include <iostream>
 #include <arpa/inet.h> // Pour inet_ntop
+#include <unistd.h>
+#include <climits>
+#include <stdexcept>
 
 Server::Server(const Config &config)
     : config_(config), clientMaxBodySizeIsSet_(false), rootIsSet_(false), indexIsSet_(false),
-      host_(INADDR_ANY), port_(htons(0))
+      host_(INADDR_ANY), port_(htons(0)), defaultServer_(false), listenBacklog_(0)
 {
 }
 
@@ -62,6 +65,26 @@ void Server::setPort(uint16_t port)
     port_ = port;
 }
 
+void Server::setDefaultServer(bool defaultServer)
+{
+    defaultServer_ = defaultServer;
+}
+
+bool Server::isDefaultServer() const
+{
+    return defaultServer_;
+}
+
+void Server::setListenBacklog(int backlog)
+{
+    listenBacklog_ = backlog;
+}
+
+int Server::getListenBacklog() const
+{
+    return listenBacklog_;
+}
+
 const std::vector<std::string> &Server::getServerNames() const
 {
     return serverNames_;
@@ -102,7 +125,11 @@ const std::string Server::getErrorPage(int errorCode) const
 
 const std::string Server::getErrorPageFullPath(int errorCode) const
 {
-    return(getRoot() + getErrorPage(errorCode));
+    // No error_page for this code : empty, the default body is used (the root is not a page)
+    std::string errorPage = getErrorPage(errorCode);
+    if (errorPage.empty())
+        return "";
+    return(getRoot() + errorPage);
 }
 
 
@@ -124,12 +151,39 @@ const std::vector<Location> &Server::getLocations() const
     return locations_;
 }
 
+// Called once every location of the server is added : the trie points to the elements of locations_
+void Server::compileLocations()
+{
+    char cwd[PATH_MAX];
+    if (getcwd(cwd, sizeof(cwd)) == NULL)
+    {
+        throw std::runtime_error("Error : Unable to get current working directory");
+    }
+    locationTrie_.clear();
+    for (size_t i = 0; i < locations_.size(); ++i)
+    {
+        locationTrie_.insert(&locations_[i]);
+        locations_[i].compileCgiEnvironment(cwd);
+    }
+}
+
+// Exact location of the path, else its longest prefix location, NULL if none
+const Location* Server::findLocation(const std::string &path) const
+{
+    return locationTrie_.find(path);
+}
+
 // DEBUG
 void Server::displayServer() const
 {
     char ipStr[INET_ADDRSTRLEN];
     inet_ntop(AF_INET, &host_, ipStr, INET_ADDRSTRLEN);
-    std::cout << "  listen: " << ipStr << ":" << ntohs(port_) << std::endl;
+    std::cout << "  listen: " << ipStr << ":" << ntohs(port_) << (defaultServer_ ? " default_server" : "");
+    if (listenBacklog_ > 0)
+    {
+        std::cout << " backlog=" << listenBacklog_;
+    }
+    std::cout << std::endl;
 
     const std::vector<std::string> &serverNames = this->getServerNames();
     for (size_t j = 0; j < serverNames.size(); ++j)
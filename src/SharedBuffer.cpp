@@ -0,0 +1,28 @@
+// SharedBuffer.cpp
+#include "SharedBuffer.hpp"
+
+// The content of `data` is taken (swapped), not copied
+SharedBuffer::SharedBuffer(std::string& data) : references_(1) {
+    data_.swap(data);
+}
+
+SharedBuffer::~SharedBuffer() {
+}
+
+void SharedBuffer::retain() {
+    ++references_;
+}
+
+void SharedBuffer::release() {
+    if (--references_ == 0) {
+        delete this;
+    }
+}
+
+const char* SharedBuffer::data() const {
+    return data_.data();
+}
+
+size_t SharedBuffer::size() const {
+    return data_.size();
+}
@@ -0,0 +1,84 @@
+// StaticResponseCache.cpp
+#include "StaticResponseCache.hpp"
+
+StaticResponseCache::StaticResponseCache(size_t maxBytes)
+    : maxBytes_(maxBytes), usedBytes_(0), hits_(0), misses_(0)
+{
+}
+
+StaticResponseCache::~StaticResponseCache() {
+    while (!lru_.empty()) {
+        removeEntry(lru_.back());
+    }
+}
+
+/**
+ * Gives the cached response of a file, if it was serialized from the same version of the file.
+ * The buffer is not retained for the caller.
+ *
+ * @return The response, NULL if it is not cached (or outdated, it is dropped then).
+ */
+SharedBuffer* StaticResponseCache::find(const std::string& path, const OpenFileInfo& info, size_t& headerLength) {
+    std::map<std::string, Entry*>::iterator it = entries_.find(path);
+    if (it == entries_.end()) {
+        ++misses_;
+        return NULL;
+    }
+    Entry* entry = it->second;
+    if (entry->size != info.size || entry->mtime != info.mtime || entry->inode != info.inode) {
+        ++misses_;
+        removeEntry(entry);
+        return NULL;
+    }
+    ++hits_;
+    lru_.splice(lru_.begin(), lru_, entry->lruPosition);
+    headerLength = entry->headerLength;
+    return entry->response;
+}
+
+// Keeps a reference to the response of a file (replaces an older one), unless it is bigger than the whole budget
+void StaticResponseCache::insert(const std::string& path, const OpenFileInfo& info, SharedBuffer* response, size_t headerLength) {
+    if (response->size() > maxBytes_) {
+        return;
+    }
+    std::map<std::string, Entry*>::iterator it = entries_.find(path);
+    if (it != entries_.end()) {
+        removeEntry(it->second);
+    }
+    while (!lru_.empty() && usedBytes_ + response->size() > maxBytes_) {
+        removeEntry(lru_.back());
+    }
+
+    Entry* entry = new Entry();
+    entry->path = path;
+    entry->size = info.size;
+    entry->mtime = info.mtime;
+    entry->inode = info.inode;
+    entry->response = response;
+    entry->headerLength = headerLength;
+    response->retain();
+    lru_.push_front(entry);
+    entry->lruPosition = lru_.begin();
+    entries_[path] = entry;
+    usedBytes_ += response->size();
+}
+
+size_t StaticResponseCache::getHits() const {
+    return hits_;
+}
+
+size_t StaticResponseCache::getMisses() const {
+    return misses_;
+}
+
+size_t StaticResponseCache::getUsedBytes() const {
+    return usedBytes_;
+}
+
+void StaticResponseCache::removeEntry(Entry* entry) {
+    usedBytes_ -= entry->response->size();
+    entry->response->release();
+    entries_.erase(entry->path);
+    lru_.erase(entry->lruPosition);
+    delete entry;
+}
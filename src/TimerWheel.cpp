@@ -0,0 +1,201 @@
+// TimerWheel.cpp
+#include "TimerWheel.hpp"
+#include <time.h>
+
+Timer::Timer() : type(TIMER_INACTIVITY), dataSocket(NULL), fastCgiConnection(NULL), deadline_(0), wheel_(NULL), previous_(NULL), next_(NULL), slot_(NULL) {}
+
+Timer::Timer(const Timer& other)
+    : type(other.type), dataSocket(other.dataSocket), fastCgiConnection(other.fastCgiConnection), deadline_(0), wheel_(NULL), previous_(NULL), next_(NULL), slot_(NULL) {}
+
+Timer& Timer::operator=(const Timer& other) {
+    type = other.type;
+    dataSocket = other.dataSocket;
+    fastCgiConnection = other.fastCgiConnection;
+    return *this;
+}
+
+// A destroyed timer never expires
+Timer::~Timer() {
+    if (wheel_ != NULL) {
+        wheel_->cancel(this);
+    }
+}
+
+bool Timer::isScheduled() const {
+    return wheel_ != NULL;
+}
+
+long long Timer::getDeadline() const {
+    return deadline_;
+}
+
+TimerWheel::TimerWheel(long long currentTimeMs) : currentTick_(currentTimeMs / TIMER_WHEEL_TICK_MS), count_(0) {
+    for (size_t i = 0; i < TIMER_WHEEL_LEVEL0_SLOTS; ++i) {
+        level0_[i] = NULL;
+    }
+    for (size_t i = 0; i < TIMER_WHEEL_LEVEL1_SLOTS; ++i) {
+        level1_[i] = NULL;
+    }
+}
+
+// The timers still scheduled are only unlinked, they belong to their owners
+TimerWheel::~TimerWheel() {
+    for (size_t i = 0; i < TIMER_WHEEL_LEVEL0_SLOTS; ++i) {
+        while (level0_[i] != NULL) {
+            cancel(level0_[i]);
+        }
+    }
+    for (size_t i = 0; i < TIMER_WHEEL_LEVEL1_SLOTS; ++i) {
+        while (level1_[i] != NULL) {
+            cancel(level1_[i]);
+        }
+    }
+}
+
+/**
+ * Monotonic clock of the deadlines : a change of the wall clock (NTP step, date) neither stalls them nor
+ * fires them all at once. Only meaningful as a difference, it is not a date.
+ */
+long long TimerWheel::currentTimeMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<long long>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Same clock in seconds : the activity times and deadlines of the connections, CGIs and FastCGI connections, and the
+// validation and use times of the OpenFileCache
+time_t TimerWheel::currentTime() {
+    return static_cast<time_t>(currentTimeMs() / 1000);
+}
+
+/**
+ * Schedules a timer, or moves it if it is already scheduled.
+ *
+ * @param deadlineMs Time (ms of currentTimeMs(), the monotonic clock) from which the timer expires. A past
+ *                   deadline expires with the next popExpired().
+ */
+void TimerWheel::schedule(Timer* timer, long long deadlineMs) {
+    cancel(timer);
+    timer->deadline_ = deadlineMs;
+    timer->wheel_ = this;
+    place(timer);
+    ++count_;
+}
+
+void TimerWheel::cancel(Timer* timer) {
+    if (timer->wheel_ != this) {
+        return;
+    }
+    if (timer->previous_ != NULL) {
+        timer->previous_->next_ = timer->next_;
+    } else {
+        *timer->slot_ = timer->next_;
+    }
+    if (timer->next_ != NULL) {
+        timer->next_->previous_ = timer->previous_;
+    }
+    timer->previous_ = NULL;
+    timer->next_ = NULL;
+    timer->slot_ = NULL;
+    timer->wheel_ = NULL;
+    --count_;
+}
+
+/**
+ * Gives the timers whose deadline is reached, one at a time : the caller can cancel or destroy other timers
+ * (or schedule this one again) before asking for the next one.
+ *
+ * @return An expired timer (no longer scheduled), NULL once there is none.
+ */
+Timer* TimerWheel::popExpired(long long currentTimeMs) {
+    long long lastTick = currentTimeMs / TIMER_WHEEL_TICK_MS;
+    if (count_ == 0) {
+        // Nothing to expire in the ticks elapsed
+        if (currentTick_ <= lastTick) {
+            currentTick_ = lastTick + 1;
+        }
+        return NULL;
+    }
+    while (currentTick_ <= lastTick) {
+        Timer* timer = level0_[currentTick_ % TIMER_WHEEL_LEVEL0_SLOTS];
+        if (timer != NULL) {
+            cancel(timer);
+            return timer;
+        }
+        ++currentTick_;
+        if (currentTick_ % TIMER_WHEEL_LEVEL0_SLOTS == 0) {
+            cascade();
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Time the event loop can wait for events before a timer expires.
+ *
+ * @param maxTimeoutMs Timeout when no timer expires sooner.
+ * @return Milliseconds until the nearest tick with a timer (0 if already due), at most maxTimeoutMs.
+ */
+int TimerWheel::getTimeout(long long currentTimeMs, int maxTimeoutMs) const {
+    if (count_ == 0) {
+        return maxTimeoutMs;
+    }
+    // First tick of the first level with a timer, else the next cascade of the second level
+    long long nextTick = currentTick_ - currentTick_ % TIMER_WHEEL_LEVEL0_SLOTS + TIMER_WHEEL_LEVEL0_SLOTS;
+    for (long long tick = currentTick_; tick < nextTick; ++tick) {
+        if (level0_[tick % TIMER_WHEEL_LEVEL0_SLOTS] != NULL) {
+            nextTick = tick;
+            break;
+        }
+    }
+    long long timeout = nextTick * TIMER_WHEEL_TICK_MS - currentTimeMs;
+    if (timeout < 0) {
+        return 0;
+    }
+    return timeout < maxTimeoutMs ? static_cast<int>(timeout) : maxTimeoutMs;
+}
+
+size_t TimerWheel::size() const {
+    return count_;
+}
+
+// Slot of the tick of the deadline (rounded up : a timer never expires before its deadline)
+void TimerWheel::place(Timer* timer) {
+    long long tick = (timer->deadline_ + TIMER_WHEEL_TICK_MS - 1) / TIMER_WHEEL_TICK_MS;
+    if (tick < currentTick_) {
+        tick = currentTick_;
+    }
+    long long group = tick / static_cast<long long>(TIMER_WHEEL_LEVEL0_SLOTS);
+    long long currentGroup = currentTick_ / static_cast<long long>(TIMER_WHEEL_LEVEL0_SLOTS);
+    if (group == currentGroup) {
+        link(timer, &level0_[tick % TIMER_WHEEL_LEVEL0_SLOTS]);
+    } else {
+        // Too far for the second level : waits in its last slot and is placed again when it is cascaded
+        if (group - currentGroup >= static_cast<long long>(TIMER_WHEEL_LEVEL1_SLOTS)) {
+            group = currentGroup + TIMER_WHEEL_LEVEL1_SLOTS - 1;
+        }
+        link(timer, &level1_[group % TIMER_WHEEL_LEVEL1_SLOTS]);
+    }
+}
+
+void TimerWheel::link(Timer* timer, Timer** slot) {
+    timer->slot_ = slot;
+    timer->previous_ = NULL;
+    timer->next_ = *slot;
+    if (*slot != NULL) {
+        (*slot)->previous_ = timer;
+    }
+    *slot = timer;
+}
+
+// The wheel enters a new group of ticks : the timers of its slot in the second level go to the first one
+void TimerWheel::cascade() {
+    Timer** slot = &level1_[(currentTick_ / static_cast<long long>(TIMER_WHEEL_LEVEL0_SLOTS)) % TIMER_WHEEL_LEVEL1_SLOTS];
+    Timer* timer = *slot;
+    *slot = NULL;
+    while (timer != NULL) {
+        Timer* next = timer->next_;
+        place(timer);
+        timer = next;
+    }
+}
@@ -1,5 +1,8 @@
 #include "Utils.hpp"
 #include <cstdlib>
+#include <unistd.h>
+#include <cstring>
+#include <cerrno>
 
 std::string toString(int value) {
     std::stringstream ss;
@@ -41,4 +44,55 @@ void decodeURI(std::string &toDecode)
         }
     }
     toDecode = decoded;
-}
\ No newline at end of file
+}
+// Reads the first `length` bytes of an open file with pread() (the shared file position is not used)
+bool readFileContent(int fd, size_t length, std::string &content)
+{
+    content.resize(length);
+    size_t offset = 0;
+    while (offset < length) {
+        ssize_t bytesRead = pread(fd, &content[offset], length - offset, static_cast<off_t>(offset));
+        if (bytesRead <= 0) {
+            break;
+        }
+        offset += bytesRead;
+    }
+    content.resize(offset);
+    return offset == length;
+}
+
+// HTTP-date (IMF-fixdate) : "Sun, 06 Nov 1994 08:49:37 GMT"
+std::string formatHttpDate(time_t time)
+{
+    struct tm gmt;
+    char buffer[64];
+    gmtime_r(&time, &gmt);
+    strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", &gmt);
+    return buffer;
+}
+
+/**
+ * Parses an HTTP-date in one of the three formats of RFC 9110 (IMF-fixdate, RFC 850, asctime).
+ *
+ * @return false if the value is not a valid date.
+ */
+bool parseHttpDate(const std::string &value, time_t &time)
+{
+    const char* formats[] = { "%a, %d %b %Y %H:%M:%S GMT", "%A, %d-%b-%y %H:%M:%S GMT", "%a %b %d %H:%M:%S %Y" };
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i) {
+        struct tm gmt;
+        memset(&gmt, 0, sizeof(gmt));
+        const char* end = strptime(value.c_str(), formats[i], &gmt);
+        if (end && *end == '\0') {
+            time = timegm(&gmt);
+            return time != static_cast<time_t>(-1);
+        }
+    }
+    return false;
+}
+
+// Error of a non-blocking read / write that only means "not now" : retried at the next readiness of the fd
+bool isRetryableIoError(int error)
+{
+    return error == EAGAIN || error == EWOULDBLOCK || error == EINTR;
+}
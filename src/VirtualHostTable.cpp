@@ -0,0 +1,162 @@
+// VirtualHostTable.cpp
+#include "VirtualHostTable.hpp"
+#include "Server.hpp"
+#include <cctype>
+
+// Slots of a table created by the first insertion (power of two)
+const size_t NAME_TABLE_INITIAL_SLOTS = 16;
+
+VirtualHostTable::NameTable::NameTable() : slots_(), count_(0) {}
+
+// FNV-1a
+size_t VirtualHostTable::NameTable::hash(const char* name, size_t length) {
+    size_t hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= static_cast<unsigned char>(name[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// The first server of a name is kept
+void VirtualHostTable::NameTable::insert(const std::string& name, Server* server) {
+    if ((count_ + 1) * 2 > slots_.size()) {
+        grow();
+    }
+    size_t mask = slots_.size() - 1;
+    size_t index = hash(name.data(), name.size()) & mask;
+    while (slots_[index].server != NULL) {
+        if (slots_[index].name == name) {
+            return;
+        }
+        index = (index + 1) & mask;
+    }
+    slots_[index].name = name;
+    slots_[index].server = server;
+    ++count_;
+}
+
+Server* VirtualHostTable::NameTable::find(const char* name, size_t length) const {
+    if (slots_.empty()) {
+        return NULL;
+    }
+    size_t mask = slots_.size() - 1;
+    size_t index = hash(name, length) & mask;
+    while (slots_[index].server != NULL) {
+        const std::string& slotName = slots_[index].name;
+        if (slotName.size() == length && slotName.compare(0, length, name, length) == 0) {
+            return slots_[index].server;
+        }
+        index = (index + 1) & mask;
+    }
+    return NULL;
+}
+
+size_t VirtualHostTable::NameTable::size() const {
+    return count_;
+}
+
+void VirtualHostTable::NameTable::grow() {
+    std::vector<Slot> previous;
+    previous.swap(slots_);
+    slots_.resize(previous.empty() ? NAME_TABLE_INITIAL_SLOTS : previous.size() * 2);
+    count_ = 0;
+    for (size_t i = 0; i < previous.size(); ++i) {
+        if (previous[i].server != NULL) {
+            insert(previous[i].name, previous[i].server);
+        }
+    }
+}
+
+VirtualHostTable::VirtualHostTable() : defaultServer_(NULL), firstServer_(NULL) {}
+
+/**
+ * Adds the names of a server listening on the IP:PORT of the table.
+ *
+ * @param server A server of the configuration, which must outlive the table.
+ */
+void VirtualHostTable::addServer(Server* server) {
+    if (firstServer_ == NULL) {
+        firstServer_ = server;
+    }
+    if (defaultServer_ == NULL && server->isDefaultServer()) {
+        defaultServer_ = server;
+    }
+    const std::vector<std::string>& serverNames = server->getServerNames();
+    for (size_t i = 0; i < serverNames.size(); ++i) {
+        std::string name = normalizeHost(serverNames[i]);
+        if (name.size() > 2 && name.compare(0, 2, "*.") == 0) {
+            leadingWildcards_.insert(name.substr(2), server);
+        } else if (name.size() > 2 && name.compare(name.size() - 2, 2, ".*") == 0) {
+            trailingWildcards_.insert(name.substr(0, name.size() - 2), server);
+        } else {
+            exactNames_.insert(name, server);
+        }
+    }
+}
+
+/**
+ * Selects the server of a Host header : exact name, else longest `*.` wildcard, else longest `.*` wildcard,
+ * else the default server.
+ *
+ * @param hostHeader The Host header of the request, as received.
+ * @return The server, NULL only if the table is empty.
+ */
+const Server* VirtualHostTable::findServer(const std::string& hostHeader) const {
+    std::string host = normalizeHost(hostHeader);
+    if (!host.empty()) {
+        const Server* server = exactNames_.find(host.data(), host.size());
+        if (server != NULL) {
+            return server;
+        }
+        if (leadingWildcards_.size() > 0) {
+            // Suffixes after each dot, longest first : "a.b.example.com" -> "b.example.com", "example.com", "com"
+            for (size_t dot = host.find('.'); dot != std::string::npos; dot = host.find('.', dot + 1)) {
+                server = leadingWildcards_.find(host.data() + dot + 1, host.size() - dot - 1);
+                if (server != NULL) {
+                    return server;
+                }
+            }
+        }
+        if (trailingWildcards_.size() > 0) {
+            // Prefixes before each dot, longest first : "www.example.com" -> "www.example", "www"
+            for (size_t dot = host.rfind('.'); dot != std::string::npos && dot > 0; dot = host.rfind('.', dot - 1)) {
+                server = trailingWildcards_.find(host.data(), dot);
+                if (server != NULL) {
+                    return server;
+                }
+            }
+        }
+    }
+    return getDefaultServer();
+}
+
+const Server* VirtualHostTable::getDefaultServer() const {
+    return defaultServer_ != NULL ? defaultServer_ : firstServer_;
+}
+
+size_t VirtualHostTable::size() const {
+    return exactNames_.size() + leadingWildcards_.size() + trailingWildcards_.size();
+}
+
+// "WWW.Example.com.:8080" -> "www.example.com", "[::1]:8080" -> "[::1]"
+std::string VirtualHostTable::normalizeHost(const std::string& hostHeader) {
+    size_t end = hostHeader.size();
+    if (!hostHeader.empty() && hostHeader[0] == '[') {
+        size_t bracket = hostHeader.find(']');
+        end = bracket == std::string::npos ? end : bracket + 1;
+    } else {
+        size_t colon = hostHeader.rfind(':');
+        if (colon != std::string::npos) {
+            end = colon;
+        }
+    }
+    if (end > 0 && hostHeader[end - 1] == '.') {
+        --end;
+    }
+    std::string host(hostHeader, 0, end);
+    for (size_t i = 0; i < host.size(); ++i) {
+        host[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(host[i])));
+    }
+    return host;
+}
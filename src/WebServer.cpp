@@ -4,14 +4,32 @@
 #include <stdexcept>
 #include <unistd.h>
 #include <signal.h>
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/socket.h>
 
 // Extern, defined in main.cpp, monitored by signals (Ctrl+C SIGINT is a way to stop Webserver properly)
 extern volatile bool g_running;
 
-WebServer::WebServer() : config_(NULL) {}
+WebServer::WebServer() : config_(NULL), multiplexer_(NULL),
+    timerWheel_(TimerWheel::currentTimeMs()), listenersPaused_(false), spareFd_(-1), openFileCache_(NULL),
+    staticResponseCache_(NULL), reportedCacheLookups_(0) {
+    acceptResumeTimer_.type = TIMER_ACCEPT_RESUME;
+    acceptResumeTimer_.dataSocket = NULL;
+    cacheStatsTimer_.type = TIMER_CACHE_STATS;
+    cacheStatsTimer_.dataSocket = NULL;
+    openFileCacheTimer_.type = TIMER_OPEN_FILE_CACHE;
+    openFileCacheTimer_.dataSocket = NULL;
+    fastCgiRetryTimer_.type = TIMER_FASTCGI_RETRY;
+    fastCgiRetryTimer_.dataSocket = NULL;
+}
 
 WebServer::~WebServer() {
     cleanUp();
+    if (multiplexer_ != NULL) {
+        delete multiplexer_;
+        multiplexer_ = NULL;
+    }
     if (config_ != NULL) {
         delete config_;
         config_ = NULL;
@@ -38,136 +56,125 @@ void WebServer::start() {
     const std::vector<Server*>& servers = config_->getServers();
     
     try {
-        listeningHandler_.initialize(servers);
+        // With several workers, each one binds its own ListeningSockets (SO_REUSEPORT)
+        listeningHandler_.initialize(servers, config_->getWorkers() > 1);
     } catch (const std::runtime_error& e) {
         std::cerr << "Server initialization failed " << std::endl;
         // Webserver will not run
         throw (e);
     }
 
+    // Created by each worker : the cached fds are not shared between processes
+    openFileCache_ = new OpenFileCache(config_->getOpenFileCacheMax(), config_->getOpenFileCacheValid());
+    staticResponseCache_ = new StaticResponseCache(config_->getStaticCacheSize());
+    timerWheel_.schedule(&cacheStatsTimer_, TimerWheel::currentTimeMs() + CACHE_STATS_INTERVAL_MS);
+    timerWheel_.schedule(&openFileCacheTimer_, openFileCache_->getNextExpiry(TimerWheel::currentTime()) * 1000LL);
+
+    // Setup multiplexing : every ListeningSocket stays registered for the whole life of the WebServer
+    multiplexer_ = EventMultiplexer::create(config_->getEventBackend());
+    const std::vector<ListeningSocket*>& listeningSockets = listeningHandler_.getListeningSockets();
+    for (size_t i = 0; i < listeningSockets.size(); ++i) {
+        watchFd(listeningSockets[i]->getSocket(), EVENT_READ, FD_LISTENING_SOCKET, listeningSockets[i], NULL);
+    }
+
     // Ignore SigPipe (broken pipe signal) 
     //=> a broken pipe (CGI error) will not make Webserver stop but need to send HTTP 500 code and close client connection
     signal(SIGPIPE, SIG_IGN);
 
-    std::cout << "Info : WebServer is ready and is currently managing " << servers.size() << " servers." << std::endl; // debug
+    // The end of the CGI processes is an event of the loop (SIGCHLD), they are never waited for
+    if (!childReaper_.open()) {
+        throw std::runtime_error("Error : the SIGCHLD pipe could not be set up");
+    }
+    watchFd(childReaper_.getFd(), EVENT_READ, FD_CHILD_EXIT, NULL, NULL);
+
+    // Kept in reserve : released to accept and refuse the pending connections once no fd is left (EMFILE)
+    spareFd_ = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (spareFd_ == -1) {
+        std::cerr << "Error : no spare fd, the connections can't be refused when no fd is left" << std::endl;
+    }
+
+    std::cout << "Info : WebServer is ready and is currently managing " << servers.size() << " servers (event backend: " << multiplexer_->getName() << ")." << std::endl; // debug
 }
 
 
 /**
  * @brief Runs the event loop for the web server, handling incoming events and socket communication.
  * 
- * This function implements an event-driven model using multiplexing with `poll()`, allowing the server to monitor 
- * multiple file descriptors (sockets and pipes) for input (`POLLIN`) and output (`POLLOUT`) events in a non-blocking manner. 
- * By using multiplexing, the server can efficiently handle multiple connections and processes concurrently without blocking on 
- * any single socket or operation. 
+ * This function implements an event-driven model using multiplexing through an `EventMultiplexer` (epoll or poll backend), 
+ * allowing the server to monitor multiple file descriptors (sockets and pipes) for input (`EVENT_READ`) and output (`EVENT_WRITE`) 
+ * events in a non-blocking manner. By using multiplexing, the server can efficiently handle multiple connections and processes 
+ * concurrently without blocking on any single socket or operation. 
  * 
- * Specifically: POLLIN and POLLOUT are watched at THE same time for every DataSocket 
- * - **POLLIN** is monitored for sockets that have incoming data to read, indicating when a new request or data is available.
- * - **POLLOUT** is monitored for sockets that are ready to send data, allowing the server to send responses back to clients when they are ready.
- * 
- * The `poll()` system call monitors these events across multiple file descriptors, allowing the server to handle multiple 
- * requests and responses concurrently without wasting resources on blocked operations. 
+ * Registrations are persistent : a fd is added to the multiplexer when it is created (accept, CGI start) and removed when it is closed.
+ * A wakeup only costs the number of ready fds, nothing is rebuilt between two iterations.
+ * - **EVENT_READ** is watched for DataSockets while a request can be received : it is paused while a response is being
+ *   produced or sent, so pipelined requests are read and answered one after the other.
+ * - **EVENT_WRITE** is only watched while a DataSocket has data to send : the interest is updated when `hasDataToSend()` flips.
+ * - **CGI pipes** : the stdout pipe of a CGI is watched for EVENT_READ, its stdin pipe for EVENT_WRITE while part of the
+ *   request body waits to be written to it (the body is streamed to the CGI while it is received).
+ * - **FastCGI connections** : watched for EVENT_WRITE while a request is written to them, EVENT_READ while a response is expected.
+ * - **Child exits** : the read end of the SIGCHLD self-pipe of the `ChildReaper` is watched for EVENT_READ, the CGI
+ *   processes that ended are reaped when it is readable.
  * 
  * The event loop also handles timeouts, processes CGI output, and closes idle or erroneous sockets as needed.
  */
 void WebServer::runEventLoop() {
     std::cout << "Info : Webserver is now running" << std::endl;
     
+    std::vector<IoEvent> readyEvents;
     while (g_running) {
-        //Pollfds stores all fds we want to keep an eye on : it is used to monitor events in multiplexing IO (non-blocking state)
-        std::vector<struct pollfd> pollfds;
-        
-        //Utils allowing the access to sockets when an event is detected
-        std::vector<ListeningSocket*> pollListeningSockets;
-        std::vector<DataSocket*> pollDataSockets;
-
-        //Used to identify the type of the fd watched (events are treated differently in function of the fd)
-        std::vector<int> pollFdTypes; // 0: ListeningSocket, 1: ClientSocket, 2: CgiPipe
-
-        //Setup structures
-        setupPollfds(pollfds, pollListeningSockets, pollDataSockets, pollFdTypes);
-
         // Monitor Multiplexing I/O phase
-        //      poll detect events and add flags to pollfds[i].revents
-        //      if a flag is detected for a fd / or poll timeout :  Multiplexing I/O phase ends
+        //      the multiplexer detects events on the registered fds and fills readyEvents
+        //      if an event is detected for a fd / or timeout :  Multiplexing I/O phase ends
         //      ret < 0 : Fatal Error or SIGINT
-        int timeout = 5000;
-        int ret = poll(&pollfds[0], pollfds.size(), timeout);
+        int ret = multiplexer_->waitEvents(readyEvents, getEventTimeout());
         if (ret < 0) {
-            //poll failed, retry ..
+            //wait failed, retry ..
             continue;
         }
 
         // Events are treated after Multiplexing I/O phase
-        size_t i;
-        for (i = 0; i < pollfds.size(); ++i) {
-            if (pollfds[i].revents == 0)
+        //      a fd closed while treating this batch may be reused right away by a new fd (accept, pipe) :
+        //      its remaining events are stale and skipped (level-triggered, a real event will be reported again)
+        staleFds_.clear();
+        for (size_t i = 0; i < readyEvents.size(); ++i) {
+            int fd = readyEvents[i].fd;
+            if (staleFds_.find(fd) != staleFds_.end())
                 continue;
-            // Listening Sockets
-            if (pollFdTypes[i] == 0) {
-                if (pollfds[i].revents & POLLIN) {
-                    // std::cout << GREEN <<"LISTENINGSOCKET POLLIN" << RESET << std::endl;
-                    ListeningSocket* listeningSocket = pollListeningSockets[i];
-                    int new_fd = listeningSocket->acceptConnection();
-                    if (new_fd >= 0) {
-                        DataSocket* newDataSocket = new DataSocket(new_fd, listeningSocket->getAssociatedServers(), config_);
-                        dataHandler_.addClientSocket(newDataSocket);
-                    }
-                }
-            } 
+            std::map<int, WatchedFd>::iterator it = watchedFds_.find(fd);
+            if (it == watchedFds_.end())
+                continue;
+            WatchedFd watched = it->second;
 
+            // Listening Sockets
+            if (watched.type == FD_LISTENING_SOCKET) {
+                handleListeningSocketEvent(watched.listeningSocket, readyEvents[i].events);
+            }
             // Data Sockets
-            else if (pollFdTypes[i] == 1) {
-                DataSocket* dataSocket = pollDataSockets[i];
-                if (pollfds[i].revents & POLLIN) {
-                    // std::cout << GREEN <<"DATASOCKET POLLIN fd :" << pollfds[i].fd << RESET << std::endl;
-                    if (!dataSocket->receiveData()) {
-                        dataSocket->closeSocket();
-                    } else if (dataSocket->isRequestComplete()) {
-                        dataSocket->processRequest();
-                        if (dataSocket->hasCgiProcess()) {
-                            activeCgiSockets_.push_back(dataSocket);
-                        }
-                    }
-                }if (pollfds[i].revents & POLLOUT) {
-                    // std::cout << GREEN <<"DATASOCKET POLLOUT" << RESET << std::endl;
-                    if (dataSocket->hasDataToSend()) {
-                        if (!dataSocket->sendData()) {
-                            dataSocket->closeSocket();
-                        }
-                    }
-                }if (pollfds[i].revents & (POLLHUP | POLLERR | POLLNVAL)) {
-                    // std::cout << GREEN <<"DATASOCKET POLLHUP POLLERR POLLNVAL" << RESET << std::endl;
-                    dataSocket->closeSocket();
-                }
-
-            } 
-
+            else if (watched.type == FD_DATA_SOCKET) {
+                handleDataSocketEvent(watched.dataSocket, readyEvents[i].events);
+            }
             // Pipes CGI 
-            //      fd stored in poll = pipe / Datasocket that contains this fd = pollDataSockets[i]
-            else if (pollFdTypes[i] == 2) {
-                DataSocket* dataSocket = pollDataSockets[i];
-                //Data sent by CGI
-                if (pollfds[i].revents & POLLIN) {
-                    // std::cout << GREEN<< "CGI POLLIN EVENT" << RESET <<std::endl;
-                    dataSocket->readFromCgiPipe();
-                }
-                //EOF sent by CGI
-                else if (pollfds[i].revents & (POLLHUP)) {
-                    // std::cout<< GREEN << "CGI POLLHUP EVENT"<< RESET <<std::endl;
-                    dataSocket->readFromCgiPipe();
-                    dataSocket->closeCgiPipe();
-                }
-                else if (pollfds[i].revents & (POLLERR | POLLNVAL)) {
-                    // std::cout<< GREEN << "CGI POLLERR EVENT"<< RESET <<std::endl;//test
-                    dataSocket->closeCgiPipe();
-                }
+            //      fd watched = pipe / Datasocket that contains this fd = watched.dataSocket
+            else if (watched.type == FD_CGI_PIPE) {
+                handleCgiPipeEvent(watched.dataSocket, readyEvents[i].events);
+            }
+            // CGI stdin : the request body is written while the pipe is writable
+            else if (watched.type == FD_CGI_INPUT) {
+                handleCgiInputEvent(watched.dataSocket, readyEvents[i].events);
+            }
+            // Connections to the FastCGI responders
+            else if (watched.type == FD_FASTCGI) {
+                handleFastCgiEvent(watched.fastCgiConnection, readyEvents[i].events);
+            }
+            // SIGCHLD received : CGI processes to reap
+            else if (watched.type == FD_CHILD_EXIT) {
+                handleChildExitEvent();
             }
         }
 
         //Events triggered after each multiplexing session
-        checkCgiTimeouts();
-        checkDataSocketTimeouts();
+        checkTimers();
         dataHandler_.removeClosedSockets();
     }
     //Events triggered afet a SIGINT (not recquired by the subject but useful)
@@ -175,96 +182,693 @@ void WebServer::runEventLoop() {
     cleanUp();
 }
 
-void WebServer::setupPollfds(std::vector<struct pollfd> &pollfds,
-        std::vector<ListeningSocket*> &pollListeningSockets,
-        std::vector<DataSocket*> &pollDataSockets,
-        std::vector<int> &pollFdTypes)
-{
-    // Add Listening Sockets to pollfds 
-        //      a ListeningSocket is setup at IP:PORT of every server
-        //      Listening sockets are used to detect new connections and setup Datasockets for every client
+/**
+ * Accepts the pending connections of a listening socket until there is none left : a burst of connections is
+ * accepted in one wakeup. At most ACCEPT_BATCH_MAX at a time, so the other fds are not starved.
+ */
+void WebServer::handleListeningSocketEvent(ListeningSocket* listeningSocket, unsigned int events) {
+    if (events & EVENT_READ) {
+        // std::cout << GREEN <<"LISTENINGSOCKET EVENT_READ" << RESET << std::endl;
+        size_t maxConnections = config_->getMaxConnections();
+        for (int i = 0; i < ACCEPT_BATCH_MAX; ++i) {
+            // max_connections reached : the next connections wait in the backlog until one is closed
+            if (maxConnections > 0 && dataSocketWatches_.size() >= maxConnections) {
+                pauseListeners(0);
+                return;
+            }
+            struct sockaddr_in peerAddress;
+            int new_fd = listeningSocket->acceptConnection(peerAddress);
+            if (new_fd == ACCEPT_OUT_OF_FDS) {
+                shedConnections(listeningSocket);
+                return;
+            }
+            if (new_fd < 0) {
+                break;
+            }
+            DataSocket* newDataSocket = new DataSocket(new_fd, peerAddress, listeningSocket->getVirtualHosts(), config_,
+                                                      openFileCache_, staticResponseCache_);
+            if (!admitConnection(newDataSocket)) {
+                // The DataSocket closes the fd
+                refuseConnection(new_fd);
+                delete newDataSocket;
+                continue;
+            }
+            newDataSocket->setCgiPipeWatcher(this);
+            dataHandler_.addClientSocket(newDataSocket);
+            watchDataSocket(newDataSocket);
+        }
+    }
+}
+
+// max_connections_per_ip : counts the new connection for its client address, false if it has too many already
+bool WebServer::admitConnection(DataSocket* dataSocket) {
+    size_t maxConnectionsPerIp = config_->getMaxConnectionsPerIp();
+    if (maxConnectionsPerIp == 0) {
+        return true;
+    }
+    size_t& connections = connectionsPerIp_[dataSocket->getRemoteAddress()];
+    if (connections >= maxConnectionsPerIp) {
+        return false;
+    }
+    ++connections;
+    return true;
+}
+
+// Response of the connections refused right after accept
+static const char SERVICE_UNAVAILABLE_RESPONSE[] =
+    "HTTP/1.1 503 Service Unavailable\r\nContent-Type: text/plain\r\nContent-Length: 20\r\n"
+    "Retry-After: 1\r\nConnection: close\r\n\r\nService Unavailable\n";
+
+/**
+ * Answers 503 to a connection that is not served, without reading its request. Best effort : the socket is
+ * non-blocking and the response is only sent if it fits in its buffer (it always does for a new connection).
+ * The fd is not closed (it may belong to a DataSocket).
+ */
+void WebServer::refuseConnection(int fd) {
+    send(fd, SERVICE_UNAVAILABLE_RESPONSE, sizeof(SERVICE_UNAVAILABLE_RESPONSE) - 1, MSG_NOSIGNAL);
+}
+
+/**
+ * No fd left (EMFILE / ENFILE) : the pending connections would keep the listening socket readable and the loop
+ * would spin on it. The spare fd is released to accept each of them and refuse it, then the listening sockets are
+ * unwatched for ACCEPT_PAUSE_MS (or until a connection is closed).
+ */
+void WebServer::shedConnections(ListeningSocket* listeningSocket) {
+    std::cerr << "Error : no file descriptor left, new connections are refused" << std::endl;
+    for (int i = 0; i < ACCEPT_BATCH_MAX && spareFd_ != -1; ++i) {
+        close(spareFd_);
+        struct sockaddr_in peerAddress;
+        int fd = listeningSocket->acceptConnection(peerAddress);
+        if (fd >= 0) {
+            refuseConnection(fd);
+            close(fd);
+        }
+        spareFd_ = open("/dev/null", O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            break;
+        }
+    }
+    pauseListeners(ACCEPT_PAUSE_MS);
+}
+
+/**
+ * Unwatches the listening sockets : the new connections wait in their backlog.
+ *
+ * @param resumeAfterMs Delay before they are watched again, 0 to wait for a connection to be closed.
+ */
+void WebServer::pauseListeners(int resumeAfterMs) {
+    if (!listenersPaused_) {
         const std::vector<ListeningSocket*>& listeningSockets = listeningHandler_.getListeningSockets();
-        size_t i;
-        for (i = 0; i < listeningSockets.size(); ++i) {
-            struct pollfd pfd;
-            pfd.fd = listeningSockets[i]->getSocket();
-            pfd.events = POLLIN;
-            pfd.revents = 0;//reset revent
-            pollfds.push_back(pfd);
-            pollListeningSockets.push_back(listeningSockets[i]);
-            pollDataSockets.push_back(NULL); // Pas de DataSocket pour les ListeningSocket
-            pollFdTypes.push_back(0); // ListeningSocket
+        for (size_t i = 0; i < listeningSockets.size(); ++i) {
+            unwatchFd(listeningSockets[i]->getSocket());
         }
+        listenersPaused_ = true;
+    }
+    if (resumeAfterMs > 0) {
+        timerWheel_.schedule(&acceptResumeTimer_, TimerWheel::currentTimeMs() + resumeAfterMs);
+    }
+}
+
+// Hits and misses of the caches of the worker since its start, not logged again if nothing was looked up since
+void WebServer::logCacheStats() {
+    if (openFileCache_ == NULL || staticResponseCache_ == NULL) {
+        return;
+    }
+    size_t lookups = openFileCache_->getHits() + openFileCache_->getMisses()
+                     + staticResponseCache_->getHits() + staticResponseCache_->getMisses();
+    if (lookups == reportedCacheLookups_) {
+        return;
+    }
+    reportedCacheLookups_ = lookups;
+    std::cout << "Info : Worker " << getpid() << " caches: open files " << openFileCache_->getHits() << " hits, "
+              << openFileCache_->getMisses() << " misses | static responses " << staticResponseCache_->getHits()
+              << " hits, " << staticResponseCache_->getMisses() << " misses, " << staticResponseCache_->getUsedBytes()
+              << " bytes used" << std::endl;
+}
 
-        // Add dataSockets to pollfds for every client :
-        //      a Datasocket is created when a new client connects to a ListeningSocket 
-        //      multiples clients can be handled by 1 server
-        //      Datasockets are used to exchange with clients in HTTP
-        const std::vector<DataSocket*>& dataSockets = dataHandler_.getClientSockets();
-        for (i = 0; i < dataSockets.size(); ++i) {
-            DataSocket* dataSocket = dataSockets[i];
-            struct pollfd pfd;
-            pfd.fd = dataSocket->getSocket();
-            pfd.events = POLLIN;
-            if(dataSocket->hasDataToSend())
-                pfd.events |= POLLOUT;
-            pfd.revents = 0; //reset revent
-            pollfds.push_back(pfd);
-            pollListeningSockets.push_back(NULL); // No ListeningSocket in Datasockets
-            pollDataSockets.push_back(dataSocket);
-            pollFdTypes.push_back(1); // ClientSocket
-
-            // Add Pipe CGI to pollfds when a client request a file that needs to be exec by a CGI (Python here)
-            if (dataSocket->hasCgiProcess() && !dataSocket->isCgiComplete()) {
-                struct pollfd cgiPfd;
-                cgiPfd.fd = dataSocket->getCgiPipeFd();
-                cgiPfd.events = POLLIN;
-                cgiPfd.revents = 0; //reset revent
-                pollfds.push_back(cgiPfd);
-                pollListeningSockets.push_back(NULL);
-                pollDataSockets.push_back(dataSocket);
-                pollFdTypes.push_back(2); // CgiPipe
+// Watches the listening sockets again, unless max_connections is still reached
+void WebServer::resumeListeners() {
+    if (!listenersPaused_) {
+        return;
+    }
+    timerWheel_.cancel(&acceptResumeTimer_);
+    size_t maxConnections = config_->getMaxConnections();
+    if (maxConnections > 0 && dataSocketWatches_.size() >= maxConnections) {
+        return;
+    }
+    const std::vector<ListeningSocket*>& listeningSockets = listeningHandler_.getListeningSockets();
+    for (size_t i = 0; i < listeningSockets.size(); ++i) {
+        watchFd(listeningSockets[i]->getSocket(), EVENT_READ, FD_LISTENING_SOCKET, listeningSockets[i], NULL);
+    }
+    listenersPaused_ = false;
+}
+
+void WebServer::handleDataSocketEvent(DataSocket* dataSocket, unsigned int events) {
+    if (events & EVENT_READ) {
+        // std::cout << GREEN <<"DATASOCKET EVENT_READ fd :" << dataSocket->getSocket() << RESET << std::endl;
+        if (!dataSocket->receiveData()) {
+            closeDataSocket(dataSocket);
+            return;
+        }
+        processReadyRequest(dataSocket);
+    }
+    if (events & EVENT_WRITE) {
+        // std::cout << GREEN <<"DATASOCKET EVENT_WRITE" << RESET << std::endl;
+        if (dataSocket->hasDataToSend()) {
+            if (!dataSocket->sendData()) {
+                closeDataSocket(dataSocket);
+                return;
             }
+            // Keep-alive : a pipelined request may be complete once the response is sent
+            processReadyRequest(dataSocket);
         }
+    }
+    if (events & (EVENT_HANGUP | EVENT_ERROR)) {
+        // std::cout << GREEN <<"DATASOCKET HANGUP / ERROR" << RESET << std::endl;
+        closeDataSocket(dataSocket);
+        return;
+    }
+    syncDataSocketWatch(dataSocket);
 }
 
-void WebServer::checkCgiTimeouts() {
-    std::vector<DataSocket*>::iterator it = activeCgiSockets_.begin();
-    usleep(500);
-    while (it != activeCgiSockets_.end()) {
-        DataSocket* dataSocket = *it;
+void WebServer::processReadyRequest(DataSocket* dataSocket) {
+    if (dataSocket->isReadyToProcess()) {
+        dataSocket->processRequest();
         if (dataSocket->hasCgiProcess()) {
-            if (!dataSocket->cgiProcessIsRunning()) {
-                // CGI process is not running anymore in Datasocket
-                it = activeCgiSockets_.erase(it);
-            } else if (dataSocket->cgiProcessHasTimedOut()) {
-                // CGI process timed out
-                dataSocket->terminateCgiProcess(504);
-                it = activeCgiSockets_.erase(it);
-            } else {
-                // CGI process still running properly
-                ++it;
+            cgiProcesses_[dataSocket->getCgiPid()] = dataSocket;
+        } else if (dataSocket->hasFastCgiRequest()) {
+            submitFastCgiRequest(dataSocket);
+        }
+    }
+}
+
+void WebServer::handleCgiPipeEvent(DataSocket* dataSocket, unsigned int events) {
+    //Data or EOF sent by CGI : the pipe is closed by the DataSocket once its output is over
+    if (events & (EVENT_READ | EVENT_HANGUP)) {
+        // std::cout << GREEN<< "CGI EVENT_READ" << RESET <<std::endl;
+        dataSocket->readFromCgiPipe();
+    }
+    else if (events & EVENT_ERROR) {
+        // std::cout<< GREEN << "CGI EVENT_ERROR"<< RESET <<std::endl;//test
+        dataSocket->terminateCgiProcess(502);
+    }
+    // Streamed response cut by a CGI failure with nothing left to send
+    if (dataSocket->isFinished()) {
+        closeDataSocket(dataSocket);
+        return;
+    }
+    syncDataSocketWatch(dataSocket);
+    // Response over without a last write (HEAD) : a pipelined request may be complete
+    // (processed once the closed pipe is unwatched, its fd number can be reused by the next CGI)
+    if (dataSocket->isReadyToProcess()) {
+        processReadyRequest(dataSocket);
+        syncDataSocketWatch(dataSocket);
+    }
+}
+
+// The client socket is read again once the CGI has drained its stdin buffer (see syncDataSocketWatch())
+void WebServer::handleCgiInputEvent(DataSocket* dataSocket, unsigned int events) {
+    if (events & EVENT_WRITE) {
+        dataSocket->writeToCgiInput();
+    }
+    // The CGI closed its stdin without reading the whole body
+    else if (events & (EVENT_HANGUP | EVENT_ERROR)) {
+        dataSocket->closeCgiInput();
+    }
+    syncDataSocketWatch(dataSocket);
+}
+
+/**
+ * Registers a fd in the multiplexer and remembers what it belongs to, so an event can be dispatched
+ * to the right ListeningSocket / DataSocket without any scan.
+ */
+void WebServer::watchFd(int fd, unsigned int events, WatchedFdType type, ListeningSocket* listeningSocket, DataSocket* dataSocket) {
+    WatchedFd watched;
+    watched.type = type;
+    watched.listeningSocket = listeningSocket;
+    watched.dataSocket = dataSocket;
+    watched.fastCgiConnection = NULL;
+    if (!multiplexer_->addFd(fd, events)) {
+        std::cerr << "Error : unable to watch fd " << fd << " in the event loop" << std::endl;
+    }
+    watchedFds_[fd] = watched;
+}
+
+void WebServer::unwatchFd(int fd) {
+    multiplexer_->removeFd(fd);
+    watchedFds_.erase(fd);
+    staleFds_.insert(fd);
+}
+
+void WebServer::watchDataSocket(DataSocket* dataSocket) {
+    // The timers are linked in the wheel from their place in the map
+    DataSocketWatch& watch = dataSocketWatches_[dataSocket];
+    watch.clientFd = dataSocket->getSocket();
+    watch.clientEvents = EVENT_READ;
+    watch.cgiPipeFd = -1;
+    watch.cgiInputFd = -1;
+    watch.inactivityTimer.type = TIMER_INACTIVITY;
+    watch.inactivityTimer.dataSocket = dataSocket;
+    watch.cgiTimer.type = TIMER_CGI_EXECUTION;
+    watch.cgiTimer.dataSocket = dataSocket;
+    timerWheel_.schedule(&watch.inactivityTimer, dataSocket->getTimeoutDeadline() * 1000LL);
+    watchFd(watch.clientFd, watch.clientEvents, FD_DATA_SOCKET, NULL, dataSocket);
+}
+
+/**
+ * Compares what a DataSocket needs to be watched for with what is registered, and only talks to the
+ * multiplexer if something changed (hasDataToSend() flipped, a CGI pipe was opened or closed).
+ * Must be called right after any operation that can change the state of the DataSocket.
+ * Its timers are brought forward if its deadlines got nearer (keepalive_timeout between two requests, new CGI),
+ * a later deadline (new activity) is only taken into account when the timer expires.
+ */
+void WebServer::syncDataSocketWatch(DataSocket* dataSocket) {
+    std::map<DataSocket*, DataSocketWatch>::iterator it = dataSocketWatches_.find(dataSocket);
+    if (it == dataSocketWatches_.end()) {
+        return;
+    }
+    DataSocketWatch& watch = it->second;
+
+    // Client socket : EVENT_READ while a request can be parsed, EVENT_WRITE only when a response is waiting
+    unsigned int clientEvents = 0;
+    if (dataSocket->wantsToReceive()) {
+        clientEvents |= EVENT_READ;
+    }
+    if (dataSocket->hasDataToSend()) {
+        clientEvents |= EVENT_WRITE;
+    }
+    if (clientEvents != watch.clientEvents) {
+        multiplexer_->modifyFd(watch.clientFd, clientEvents);
+        watch.clientEvents = clientEvents;
+    }
+
+    // CGI pipe : watched while the CGI has output to give and the client keeps up with it
+    int cgiPipeFd = -1;
+    if (dataSocket->hasCgiProcess() && !dataSocket->isCgiComplete() && dataSocket->wantsCgiOutput()) {
+        cgiPipeFd = dataSocket->getCgiPipeFd();
+    }
+    syncPipeWatch(watch.cgiPipeFd, cgiPipeFd, EVENT_READ, FD_CGI_PIPE, dataSocket);
+
+    // CGI stdin : watched while part of the request body waits to be written (the rest may not be received yet)
+    int cgiInputFd = dataSocket->wantsCgiInput() ? dataSocket->getCgiInputFd() : -1;
+    syncPipeWatch(watch.cgiInputFd, cgiInputFd, EVENT_WRITE, FD_CGI_INPUT, dataSocket);
+
+    long long deadline = dataSocket->getTimeoutDeadline() * 1000LL;
+    if (!watch.inactivityTimer.isScheduled() || deadline < watch.inactivityTimer.getDeadline()) {
+        timerWheel_.schedule(&watch.inactivityTimer, deadline);
+    }
+    if (dataSocket->hasCgiProcess()) {
+        deadline = dataSocket->getCgiDeadline() * 1000LL;
+        if (!watch.cgiTimer.isScheduled() || deadline < watch.cgiTimer.getDeadline()) {
+            timerWheel_.schedule(&watch.cgiTimer, deadline);
+        }
+    } else {
+        timerWheel_.cancel(&watch.cgiTimer);
+    }
+
+    // FastCGI connection : its output is read again once the client caught up
+    if (dataSocket->hasFastCgiRequest()) {
+        std::map<std::string, FastCgiPool*>::iterator poolIt = fastCgiPools_.find(dataSocket->getFastCgiPass());
+        FastCgiConnection* connection = NULL;
+        if (poolIt != fastCgiPools_.end()) {
+            connection = poolIt->second->findConnection(dataSocket);
+        }
+        if (connection) {
+            syncFastCgiWatch(poolIt->second, connection);
+        }
+    }
+}
+
+// Replaces the pipe fd registered for a DataSocket (-1 : none)
+void WebServer::syncPipeWatch(int& watchedFd, int fd, unsigned int events, WatchedFdType type, DataSocket* dataSocket) {
+    if (fd == watchedFd) {
+        return;
+    }
+    if (watchedFd != -1) {
+        unwatchFd(watchedFd);
+    }
+    if (fd != -1) {
+        watchFd(fd, events, type, NULL, dataSocket);
+    }
+    watchedFd = fd;
+}
+
+// Called by a DataSocket right before it closes a CGI pipe : the fd is unregistered while it is still open
+void WebServer::unwatchCgiPipe(DataSocket* dataSocket, int fd) {
+    std::map<DataSocket*, DataSocketWatch>::iterator it = dataSocketWatches_.find(dataSocket);
+    if (it == dataSocketWatches_.end()) {
+        return;
+    }
+    if (it->second.cgiPipeFd == fd) {
+        syncPipeWatch(it->second.cgiPipeFd, -1, EVENT_READ, FD_CGI_PIPE, dataSocket);
+    }
+    if (it->second.cgiInputFd == fd) {
+        syncPipeWatch(it->second.cgiInputFd, -1, EVENT_WRITE, FD_CGI_INPUT, dataSocket);
+    }
+}
+
+/**
+ * Removes the FastCGI request of a DataSocket from the queue of its pool. A request being handled by a FastCGI
+ * connection can't be stopped : the connection is closed. The DataSocket is not told (it gives the request up).
+ */
+void WebServer::cancelFastCgiRequest(DataSocket* dataSocket) {
+    std::map<std::string, FastCgiPool*>::iterator poolIt = fastCgiPools_.find(dataSocket->getFastCgiPass());
+    if (poolIt == fastCgiPools_.end()) {
+        return;
+    }
+    FastCgiConnection* connection = poolIt->second->cancel(dataSocket);
+    if (connection) {
+        closeFastCgiConnection(poolIt->second, connection, 0);
+        dispatchFastCgiRequests(poolIt->second);
+    }
+}
+
+/**
+ * Unregisters every fd and timer of a DataSocket and closes it. The DataSocket itself is deleted at the end of
+ * the loop iteration by DataSocketHandler::removeClosedSockets().
+ */
+void WebServer::closeDataSocket(DataSocket* dataSocket) {
+    std::map<DataSocket*, DataSocketWatch>::iterator it = dataSocketWatches_.find(dataSocket);
+    if (it != dataSocketWatches_.end()) {
+        if (it->second.cgiPipeFd != -1) {
+            unwatchFd(it->second.cgiPipeFd);
+        }
+        if (it->second.cgiInputFd != -1) {
+            unwatchFd(it->second.cgiInputFd);
+        }
+        unwatchFd(it->second.clientFd);
+        // Cancels its timers
+        dataSocketWatches_.erase(it);
+        if (config_->getMaxConnectionsPerIp() > 0) {
+            std::map<std::string, size_t>::iterator ipIt = connectionsPerIp_.find(dataSocket->getRemoteAddress());
+            if (ipIt != connectionsPerIp_.end() && --ipIt->second == 0) {
+                connectionsPerIp_.erase(ipIt);
             }
-        } else {
-            // Datasocket have no more CGI process
-            it = activeCgiSockets_.erase(it);
         }
+        // A fd and a connection slot are free again
+        resumeListeners();
+    }
+    if (dataSocket->hasFastCgiRequest()) {
+        cancelFastCgiRequest(dataSocket);
     }
+    dataHandler_.closeClientSocket(dataSocket);
 }
 
-void WebServer::checkDataSocketTimeouts() {
-    const std::vector<DataSocket*>& dataSockets = dataHandler_.getClientSockets();
-    time_t currentTime = time(NULL);
+/**
+ * Reaps the children that ended (SIGCHLD self-pipe readable) and ends the response of their DataSocket if its
+ * output has been read until EOF (else it is ended at EOF).
+ */
+void WebServer::handleChildExitEvent() {
+    childReaper_.drain();
+    pid_t pid;
+    int status;
+    struct rusage usage;
+    while (childReaper_.reap(pid, status, usage)) {
+        std::map<pid_t, DataSocket*>::iterator it = cgiProcesses_.find(pid);
+        if (it == cgiProcesses_.end()) {
+            continue;
+        }
+        DataSocket* dataSocket = it->second;
+        cgiProcesses_.erase(it);
+        // The DataSocket may have been closed, or have killed this CGI, in the meantime
+        if (dataSocketWatches_.find(dataSocket) == dataSocketWatches_.end() || !dataSocket->handleCgiExit(pid, status, usage)) {
+            continue;
+        }
+        if (dataSocket->isFinished()) {
+            closeDataSocket(dataSocket);
+            continue;
+        }
+        syncDataSocketWatch(dataSocket);
+        // Response over without a last write (HEAD) : a pipelined request may be complete
+        if (dataSocket->isReadyToProcess()) {
+            processReadyRequest(dataSocket);
+            syncDataSocketWatch(dataSocket);
+        }
+    }
+}
 
-    for (size_t i = 0; i < dataSockets.size(); ++i) {
-        DataSocket* dataSocket = dataSockets[i];
-        if (difftime(currentTime, dataSocket->getLastActivityTime()) > SOCKET_INACTIVITY_TIMEOUT) {
-            dataSocket->closeSocket();
+/**
+ * Handles the timers whose deadline is reached : only the DataSockets concerned are looked at, not every
+ * connection.
+ */
+void WebServer::checkTimers() {
+    long long currentTimeMs = TimerWheel::currentTimeMs();
+    time_t currentTime = static_cast<time_t>(currentTimeMs / 1000);
+    // One at a time : closing a DataSocket cancels its other timer
+    Timer* timer;
+    while ((timer = timerWheel_.popExpired(currentTimeMs)) != NULL) {
+        if (timer->type == TIMER_INACTIVITY) {
+            handleInactivityTimer(timer, currentTime);
+        } else if (timer->type == TIMER_ACCEPT_RESUME) {
+            resumeListeners();
+        } else if (timer->type == TIMER_CACHE_STATS) {
+            logCacheStats();
+            timerWheel_.schedule(timer, currentTimeMs + CACHE_STATS_INTERVAL_MS);
+        } else if (timer->type == TIMER_FASTCGI) {
+            handleFastCgiTimer(timer, currentTime);
+        } else if (timer->type == TIMER_FASTCGI_RETRY) {
+            for (std::map<std::string, FastCgiPool*>::iterator it = fastCgiPools_.begin(); it != fastCgiPools_.end(); ++it) {
+                dispatchFastCgiRequests(it->second);
+            }
+        } else if (timer->type == TIMER_OPEN_FILE_CACHE) {
+            handleOpenFileCacheTimer(timer, currentTime);
+        } else {
+            handleCgiTimer(timer, currentTime);
         }
     }
 }
 
+// Closes the DataSocket inactive for too long, else waits for its new deadline (activity since the timer was set)
+void WebServer::handleInactivityTimer(Timer* timer, time_t currentTime) {
+    DataSocket* dataSocket = timer->dataSocket;
+    if (dataSocket->getSocket() == -1) {
+        return;
+    }
+    if (dataSocket->hasTimedOut(currentTime)) {
+        closeDataSocket(dataSocket);
+    } else {
+        timerWheel_.schedule(timer, dataSocket->getTimeoutDeadline() * 1000LL);
+    }
+}
+
+// Kills the CGI process that runs for too long (504), a CGI over in the meantime needs nothing
+void WebServer::handleCgiTimer(Timer* timer, time_t currentTime) {
+    DataSocket* dataSocket = timer->dataSocket;
+    if (dataSocket->getSocket() == -1 || !dataSocket->hasCgiProcess() || !dataSocket->cgiProcessIsRunning()) {
+        return;
+    }
+    if (currentTime < dataSocket->getCgiDeadline()) {
+        // Another CGI of the connection, started after the timer was set
+        timerWheel_.schedule(timer, dataSocket->getCgiDeadline() * 1000LL);
+        return;
+    }
+    dataSocket->terminateCgiProcess(504);
+    if (dataSocket->isFinished()) {
+        closeDataSocket(dataSocket);
+    } else {
+        syncDataSocketWatch(dataSocket);
+    }
+}
+
+/**
+ * Closes the FastCGI connection idle for more than fastcgi_idle_timeout, or busy without anything from the
+ * responder for FASTCGI_READ_TIMEOUT (504), else waits for its new deadline. A queued request can take its place.
+ */
+void WebServer::handleFastCgiTimer(Timer* timer, time_t currentTime) {
+    FastCgiConnection* connection = timer->fastCgiConnection;
+    FastCgiPool* pool = getFastCgiPool(connection->getSocketPath());
+    time_t deadline = pool->getDeadline(connection);
+    if (currentTime < deadline) {
+        timerWheel_.schedule(timer, deadline * 1000LL);
+        return;
+    }
+    closeFastCgiConnection(pool, connection, 504);
+    dispatchFastCgiRequests(pool);
+}
+
+// Closes the fds of the open file cache unused for OPEN_FILE_CACHE_INACTIVE, then waits for the next one to expire
+void WebServer::handleOpenFileCacheTimer(Timer* timer, time_t currentTime) {
+    openFileCache_->expireInactive(currentTime);
+    timerWheel_.schedule(timer, openFileCache_->getNextExpiry(currentTime) * 1000LL);
+}
+
+// Wait for events until the nearest deadline of the timer wheel
+int WebServer::getEventTimeout() const {
+    return timerWheel_.getTimeout(TimerWheel::currentTimeMs(), EVENT_LOOP_MAX_TIMEOUT_MS);
+}
+
+const Config* WebServer::getConfig() const {
+    return config_;
+}
+
 void WebServer::cleanUp() {
+    for (std::map<int, WatchedFd>::iterator it = watchedFds_.begin(); it != watchedFds_.end(); ++it) {
+        if (multiplexer_ != NULL) {
+            multiplexer_->removeFd(it->first);
+        }
+    }
+    watchedFds_.clear();
+    for (std::map<std::string, FastCgiPool*>::iterator it = fastCgiPools_.begin(); it != fastCgiPools_.end(); ++it) {
+        delete it->second;
+    }
+    fastCgiPools_.clear();
+    fastCgiWatches_.clear();
+    timerWheel_.cancel(&fastCgiRetryTimer_);
+    dataSocketWatches_.clear();
+    cgiProcesses_.clear();
+    childReaper_.close();
+    timerWheel_.cancel(&acceptResumeTimer_);
+    listenersPaused_ = false;
+    connectionsPerIp_.clear();
+    if (spareFd_ != -1) {
+        close(spareFd_);
+        spareFd_ = -1;
+    }
     listeningHandler_.cleanUp();
     dataHandler_.cleanUp();
+    timerWheel_.cancel(&cacheStatsTimer_);
+    timerWheel_.cancel(&openFileCacheTimer_);
+    logCacheStats();
+    // After the DataSockets : they give their cached fds and buffers back while being deleted
+    if (staticResponseCache_ != NULL) {
+        delete staticResponseCache_;
+        staticResponseCache_ = NULL;
+    }
+    if (openFileCache_ != NULL) {
+        delete openFileCache_;
+        openFileCache_ = NULL;
+    }
+}
+
+
+// FastCGI pools
+
+// Pool of the fastcgi_pass socket, created with the first request that goes to it
+FastCgiPool* WebServer::getFastCgiPool(const std::string& socketPath) {
+    std::map<std::string, FastCgiPool*>::iterator it = fastCgiPools_.find(socketPath);
+    if (it != fastCgiPools_.end()) {
+        return it->second;
+    }
+    FastCgiPool* pool = new FastCgiPool(socketPath, config_->getFastCgiPoolSize(), config_->getFastCgiQueueSize(),
+                                        config_->getFastCgiIdleTimeout());
+    fastCgiPools_[socketPath] = pool;
+    return pool;
+}
+
+// Queues the request of a DataSocket in the pool of its location (503 if the queue is full)
+void WebServer::submitFastCgiRequest(DataSocket* dataSocket) {
+    FastCgiPool* pool = getFastCgiPool(dataSocket->getFastCgiPass());
+    if (!pool->enqueue(dataSocket)) {
+        std::cerr << "Error : FastCGI queue of " << pool->getSocketPath() << " is full" << std::endl;
+        dataSocket->failFastCgiRequest(503);
+        return;
+    }
+    dispatchFastCgiRequests(pool);
+}
+
+/**
+ * Sends the queued requests of a pool to its idle connections (or to new ones while the pool is not full).
+ * A request whose connection can't be opened gets a 502. Requests left queued because the backlog of the
+ * responder was full are dispatched again by the retry timer.
+ */
+void WebServer::dispatchFastCgiRequests(FastCgiPool* pool) {
+    FastCgiConnection* connection;
+    DataSocket* dataSocket;
+    while ((dataSocket = pool->dispatchNext(connection)) != NULL) {
+        if (connection) {
+            syncFastCgiWatch(pool, connection);
+        } else {
+            dataSocket->failFastCgiRequest(502);
+        }
+        syncDataSocketWatch(dataSocket);
+    }
+    if (pool->isWaitingForConnection() && !fastCgiRetryTimer_.isScheduled()) {
+        timerWheel_.schedule(&fastCgiRetryTimer_, TimerWheel::currentTimeMs() + FASTCGI_RETRY_INTERVAL_MS);
+    }
+}
+
+void WebServer::handleFastCgiEvent(FastCgiConnection* connection, unsigned int events) {
+    FastCgiPool* pool = getFastCgiPool(connection->getSocketPath());
+    // The client is kept : END_REQUEST detaches it from the connection
+    DataSocket* dataSocket = connection->getClient();
+
+    bool ok = true;
+    if (events & EVENT_WRITE) {
+        ok = connection->handleWritable();
+    }
+    if (ok && (events & (EVENT_READ | EVENT_HANGUP))) {
+        ok = connection->handleReadable();
+    }
+    if (ok && (events & EVENT_ERROR)) {
+        ok = false;
+    }
+    if (!ok) {
+        closeFastCgiConnection(pool, connection, 502);
+    } else {
+        syncFastCgiWatch(pool, connection);
+        if (dataSocket) {
+            if (dataSocket->isFinished()) {
+                closeDataSocket(dataSocket);
+            } else {
+                syncDataSocketWatch(dataSocket);
+                if (dataSocket->isReadyToProcess()) {
+                    processReadyRequest(dataSocket);
+                    syncDataSocketWatch(dataSocket);
+                }
+            }
+        }
+    }
+    dispatchFastCgiRequests(pool);
+}
+
+/**
+ * Compares what a FastCGI connection needs to be watched for with what is registered. Its timer is brought
+ * forward if its deadline got nearer (a request on an idle connection : read timeout), a later one is only
+ * seen when the timer expires.
+ */
+void WebServer::syncFastCgiWatch(FastCgiPool* pool, FastCgiConnection* connection) {
+    Timer& timer = connection->getTimer();
+    long long deadline = pool->getDeadline(connection) * 1000LL;
+    if (!timer.isScheduled() || deadline < timer.getDeadline()) {
+        timerWheel_.schedule(&timer, deadline);
+    }
+
+    unsigned int events = connection->getWantedEvents();
+    std::map<FastCgiConnection*, unsigned int>::iterator it = fastCgiWatches_.find(connection);
+    if (it == fastCgiWatches_.end()) {
+        WatchedFd watched;
+        watched.type = FD_FASTCGI;
+        watched.listeningSocket = NULL;
+        watched.dataSocket = NULL;
+        watched.fastCgiConnection = connection;
+        if (!multiplexer_->addFd(connection->getFd(), events)) {
+            std::cerr << "Error : unable to watch fd " << connection->getFd() << " in the event loop" << std::endl;
+        }
+        watchedFds_[connection->getFd()] = watched;
+        fastCgiWatches_[connection] = events;
+    } else if (it->second != events) {
+        multiplexer_->modifyFd(connection->getFd(), events);
+        it->second = events;
+    }
+}
+
+/**
+ * Unregisters and closes a FastCGI connection. The request it was handling (if any) gets `errorCode`,
+ * or a cut response if its body has started.
+ */
+void WebServer::closeFastCgiConnection(FastCgiPool* pool, FastCgiConnection* connection, int errorCode) {
+    DataSocket* dataSocket = connection->detachClient();
+    if (fastCgiWatches_.find(connection) != fastCgiWatches_.end()) {
+        unwatchFd(connection->getFd());
+        fastCgiWatches_.erase(connection);
+    }
+    pool->removeConnection(connection);
+    if (dataSocket) {
+        dataSocket->failFastCgiRequest(errorCode);
+        if (dataSocket->isFinished()) {
+            closeDataSocket(dataSocket);
+        } else {
+            syncDataSocketWatch(dataSocket);
+        }
+    }
 }
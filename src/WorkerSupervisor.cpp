@@ -0,0 +1,175 @@
+// WorkerSupervisor.cpp
+#include "WorkerSupervisor.hpp"
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// Extern, defined in main.cpp, monitored by signals
+extern volatile bool g_running;
+extern volatile sig_atomic_t g_receivedSignal;
+
+WorkerSupervisor::WorkerSupervisor(WebServer& webServer, size_t workersCount)
+    : webServer_(webServer), workers_(workersCount, -1), workersStartTime_(workersCount, 0)
+{
+    sigemptyset(&waitMask_);
+}
+
+// Only there to interrupt sigsuspend() when a worker ends (the default action of SIGCHLD is to be discarded)
+static void childExitHandler(int) {}
+
+WorkerSupervisor::~WorkerSupervisor() {}
+
+/**
+ * Forks every worker then supervises them until a SIGINT / SIGTERM is received.
+ *
+ * @return The exit status of the supervisor (0 on a normal shutdown).
+ */
+int WorkerSupervisor::run() {
+    blockSignals();
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        if (!spawnWorker(i)) {
+            stopWorkers(SIGTERM);
+            restoreSignals();
+            return 1;
+        }
+    }
+    std::cout << "Info : Supervisor " << getpid() << " is running " << workers_.size() << " workers" << std::endl;
+
+    int fastFailures = 0;
+    int exitStatus = 0;
+    while (g_running) {
+        int status;
+        pid_t pid = waitpid(-1, &status, WNOHANG);
+        if (pid == 0) {
+            // No worker ended : waits for SIGCHLD or SIGINT / SIGTERM, unblocked only during the wait
+            sigsuspend(&waitMask_);
+            continue;
+        }
+        if (pid == -1) {
+            if (errno == ECHILD) {
+                break;
+            }
+            continue;
+        }
+
+        int index = findWorker(pid);
+        if (index < 0) {
+            continue;
+        }
+        workers_[index] = -1;
+        if (!g_running) {
+            break;
+        }
+
+        if (WIFSIGNALED(status)) {
+            std::cerr << "Error : Worker " << pid << " was killed by signal " << WTERMSIG(status) << std::endl;
+        } else {
+            std::cerr << "Error : Worker " << pid << " exited with status " << WEXITSTATUS(status) << std::endl;
+        }
+
+        // A worker that can't even start (bind error ...) will not do better if it is restarted in a loop
+        if (time(NULL) - workersStartTime_[index] < WORKER_MIN_LIFETIME) {
+            if (++fastFailures >= WORKER_MAX_FAST_FAILURES) {
+                std::cerr << "Error : Workers keep failing at startup, Webserver is shutting down" << std::endl;
+                exitStatus = 1;
+                break;
+            }
+            sleep(1);
+        } else {
+            fastFailures = 0;
+        }
+        if (!g_running || !spawnWorker(index)) {
+            exitStatus = g_running ? 1 : 0;
+            break;
+        }
+    }
+
+    stopWorkers(g_receivedSignal ? static_cast<int>(g_receivedSignal) : SIGTERM);
+    restoreSignals();
+    std::cout << "Info : Every worker had been stopped" << std::endl;
+    return exitStatus;
+}
+
+// SIGINT / SIGTERM / SIGCHLD stay pending until sigsuspend(), so none arrives between a check and the wait
+void WorkerSupervisor::blockSignals() {
+    struct sigaction sa;
+    std::memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = childExitHandler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_NOCLDSTOP;
+    sigaction(SIGCHLD, &sa, NULL);
+
+    sigset_t blocked;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGINT);
+    sigaddset(&blocked, SIGTERM);
+    sigaddset(&blocked, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &blocked, &waitMask_);
+}
+
+// Mask and SIGCHLD action of before blockSignals() (the workers start with them)
+void WorkerSupervisor::restoreSignals() {
+    signal(SIGCHLD, SIG_DFL);
+    sigprocmask(SIG_SETMASK, &waitMask_, NULL);
+}
+
+/**
+ * Forks a worker process at the index given. The child never comes back : it runs its event loop
+ * and exits when it is over.
+ */
+bool WorkerSupervisor::spawnWorker(size_t index) {
+    pid_t pid = fork();
+    if (pid == -1) {
+        std::cerr << "Error : Worker fork failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+    if (pid == 0) {
+        restoreSignals();
+        std::exit(runWorker());
+    }
+    workers_[index] = pid;
+    workersStartTime_[index] = time(NULL);
+    return true;
+}
+
+int WorkerSupervisor::runWorker() {
+    try {
+        webServer_.start();
+        webServer_.runEventLoop();
+    } catch (const std::exception& e) {
+        std::cerr << "Error : Worker " << getpid() << ": " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Forwards the signal received by the supervisor to every worker still alive and waits for them.
+ */
+void WorkerSupervisor::stopWorkers(int signum) {
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        if (workers_[i] > 0) {
+            kill(workers_[i], signum);
+        }
+    }
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        if (workers_[i] > 0) {
+            while (waitpid(workers_[i], NULL, 0) == -1 && errno == EINTR)
+                ;
+            workers_[i] = -1;
+        }
+    }
+}
+
+int WorkerSupervisor::findWorker(pid_t pid) const {
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        if (workers_[i] == pid) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
@@ -1,21 +1,34 @@
 #include <iostream>
 #include "../includes/WebServer.hpp"
+#include "../includes/WorkerSupervisor.hpp"
 #include "../includes/Exceptions.hpp"
 #include <csignal>  // Pour signal()
-// #include <cstring> 
+#include <cstring>
 
 
 volatile bool g_running = true;
+volatile sig_atomic_t g_receivedSignal = 0;
 void signalHandler(int signum) {
     std::cout << "\nInfo : Signal (" << signum << ") Webserver Gonna close..." << std::endl;
+    g_receivedSignal = signum;
     g_running = false;
 }
 
+// No SA_RESTART : a blocking call (waitpid of the supervisor) must be interrupted by the signal
+static void setupSignal(int signum) {
+    struct sigaction sa;
+    std::memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = signalHandler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    sigaction(signum, &sa, NULL);
+}
+
 int main(int argc, char *argv[])
 {
     // Signals used to stop Webserver properly (functionnality not recquired by the subject)
-    signal(SIGINT, signalHandler);
-    signal(SIGTERM, signalHandler);
+    setupSignal(SIGINT);
+    setupSignal(SIGTERM);
 
     std::string configFile;
     if (argc == 1) {
@@ -32,6 +45,14 @@ int main(int argc, char *argv[])
     try {
         WebServer webServer;
         webServer.loadConfiguration(configFile);
+
+        // Several workers : the supervisor forks them, each one runs its own event loop
+        size_t workers = webServer.getConfig()->getWorkers();
+        if (workers > 1) {
+            WorkerSupervisor supervisor(webServer, workers);
+            return supervisor.run();
+        }
+
         webServer.start();
         webServer.runEventLoop();
 
@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+
+# Offline precompression for gzip_static / brotli_static.
+#
+# Walks a root and writes the precompressed siblings of the text files it contains (file.css -> file.css.gz and
+# file.css.br). webserv serves a sibling only if it is at least as new as the file, so the siblings are given the
+# mtime of their file, and are generated again once the file has been modified.
+# Brotli needs the python 'brotli' module or the 'brotli' command, it is skipped without them.
+#
+# usage : python3 tools/precompress.py [--min-size 256] [--no-brotli] root [root ...]
+
+import argparse
+import gzip
+import os
+import shutil
+import subprocess
+import sys
+
+try:
+    import brotli
+except ImportError:
+    brotli = None
+
+# Extensions worth compressing (images, archives ... are already compressed)
+TEXT_EXTENSIONS = {".html", ".htm", ".css", ".js", ".json", ".svg", ".txt", ".xml", ".csv", ".md"}
+
+
+def compress_gzip(data):
+    return gzip.compress(data, compresslevel=9, mtime=0)
+
+
+def compress_brotli(data):
+    if brotli is not None:
+        return brotli.compress(data, quality=11)
+    result = subprocess.run(["brotli", "--best", "--stdout", "-"], input=data, stdout=subprocess.PIPE, check=True)
+    return result.stdout
+
+
+def write_sibling(path, suffix, compress, stats):
+    """Writes path + suffix if it is missing or older than path. Returns False if it was up to date."""
+    sibling = path + suffix
+    source_stat = os.stat(path)
+    if os.path.exists(sibling) and os.stat(sibling).st_mtime >= source_stat.st_mtime:
+        return False
+    with open(path, "rb") as source:
+        data = source.read()
+    compressed = compress(data)
+    if len(compressed) >= len(data):
+        # Not worth it : an outdated sibling would never be served again, it is removed
+        if os.path.exists(sibling):
+            os.unlink(sibling)
+        return False
+    temporary = sibling + ".tmp"
+    with open(temporary, "wb") as output:
+        output.write(compressed)
+    os.utime(temporary, ns=(source_stat.st_atime_ns, source_stat.st_mtime_ns))
+    os.replace(temporary, sibling)
+    stats["written"] += 1
+    stats["original"] += len(data)
+    stats["compressed"] += len(compressed)
+    return True
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generates the .gz / .br siblings served by gzip_static / brotli_static")
+    parser.add_argument("roots", nargs="+")
+    parser.add_argument("--min-size", type=int, default=256, help="smaller files are not compressed")
+    parser.add_argument("--no-brotli", action="store_true")
+    args = parser.parse_args()
+
+    encodings = [(".gz", compress_gzip)]
+    if not args.no_brotli:
+        if brotli is not None or shutil.which("brotli"):
+            encodings.append((".br", compress_brotli))
+        else:
+            print("Info : brotli not available (python module or command), only .gz files are generated")
+
+    stats = {"written": 0, "original": 0, "compressed": 0}
+    for root in args.roots:
+        if not os.path.isdir(root):
+            print("Error : not a directory: %s" % root, file=sys.stderr)
+            return 1
+        for directory, _, files in os.walk(root):
+            for name in sorted(files):
+                path = os.path.join(directory, name)
+                if os.path.splitext(name)[1].lower() not in TEXT_EXTENSIONS or not os.path.isfile(path):
+                    continue
+                if os.path.getsize(path) < args.min_size:
+                    continue
+                for suffix, compress in encodings:
+                    if write_sibling(path, suffix, compress, stats):
+                        print("%s%s" % (path, suffix))
+
+    if stats["written"]:
+        print("Info : %d files written, %d bytes -> %d bytes"
+              % (stats["written"], stats["original"], stats["compressed"]))
+    else:
+        print("Info : every sibling is up to date")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())